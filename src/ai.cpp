@@ -16,6 +16,7 @@
 #include "game/entities.h"
 #include "game/drone.h"
 #include "game/minion.h"
+#include "game/benchmark.h"
 
 #define DEBUG_AUDIO 0
 
@@ -54,6 +55,31 @@ Worker::DroneNavContext ctx =
 	0,
 };
 
+#if !RELEASE_BUILD
+// round trip times from pathfind() to its callback firing in update()
+#define LATENCY_SLOTS 256
+struct LatencyStats
+{
+	u32 request_id[LATENCY_SLOTS];
+	r64 request_time[LATENCY_SLOTS];
+	r64 total;
+	r64 max;
+	s32 count;
+};
+LatencyStats latency_stats;
+
+void benchmark_latency()
+{
+	if (latency_stats.count == 0)
+		vi_debug("%s", "No pathfind requests completed since last check.");
+	else
+		vi_debug("%d pathfind round trips: %.3fms average, %.3fms max", latency_stats.count, (latency_stats.total / r64(latency_stats.count)) * 1000.0, latency_stats.max * 1000.0);
+	latency_stats.total = 0.0;
+	latency_stats.max = 0.0;
+	latency_stats.count = 0;
+}
+#endif
+
 void init()
 {
 	drone_render_mesh = Loader::dynamic_mesh_permanent(1);
@@ -67,38 +93,15 @@ void loop()
 
 void quit()
 {
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::Quit);
-	sync_in.unlock();
+	sync_in.end_write();
 }
 
-#define RECTIFIER_UPDATE_INTERVAL 0.5f
-r32 rectifier_timer = RECTIFIER_UPDATE_INTERVAL;
-
-void update(const Update& u)
+// fire callbacks for everything the worker has sent back so far
+// sync_out must already be open for reading
+void callbacks_read()
 {
-	rectifier_timer -= u.time.delta;
-	if (rectifier_timer < 0.0f)
-	{
-		rectifier_timer += RECTIFIER_UPDATE_INTERVAL;
-
-		NavGameState state;
-		for (auto i = Rectifier::list.iterator(); !i.is_last(); i.next())
-			state.rectifiers.add({ i.item()->get<Transform>()->absolute_pos(), i.item()->team });
-
-		for (auto i = ForceField::list.iterator(); !i.is_last(); i.next())
-			state.force_fields.add({ i.item()->get<Transform>()->absolute_pos(), i.item()->team });
-
-		sync_in.lock();
-		sync_in.write(Op::UpdateState);
-		sync_in.write(state.rectifiers.length);
-		sync_in.write(state.rectifiers.data, state.rectifiers.length);
-		sync_in.write(state.force_fields.length);
-		sync_in.write(state.force_fields.data, state.force_fields.length);
-		sync_in.unlock();
-	}
-
-	sync_out.lock();
 	while (sync_out.can_read())
 	{
 		Callback cb;
@@ -113,6 +116,18 @@ void update(const Update& u)
 				sync_out.read(&result.path);
 				result.id = callback_out_id;
 				callback_out_id++;
+#if !RELEASE_BUILD
+				{
+					s32 slot = result.id % LATENCY_SLOTS;
+					if (latency_stats.request_id[slot] == result.id)
+					{
+						r64 latency = platform::time() - latency_stats.request_time[slot];
+						latency_stats.total += latency;
+						latency_stats.max = vi_max(latency_stats.max, latency);
+						latency_stats.count++;
+					}
+				}
+#endif
 				if (level_revision == level_revision_worker) // prevent entity ID/revision collisions
 					(&link)->fire(result);
 				break;
@@ -181,7 +196,50 @@ void update(const Update& u)
 			}
 		}
 	}
-	sync_out.unlock();
+}
+
+#define RECTIFIER_UPDATE_INTERVAL 0.5f
+r32 rectifier_timer = RECTIFIER_UPDATE_INTERVAL;
+
+void update(const Update& u)
+{
+	rectifier_timer -= u.time.delta;
+	if (rectifier_timer < 0.0f)
+	{
+		rectifier_timer += RECTIFIER_UPDATE_INTERVAL;
+
+		NavGameState state;
+		for (auto i = Rectifier::list.iterator(); !i.is_last(); i.next())
+			state.rectifiers.add({ i.item()->get<Transform>()->absolute_pos(), i.item()->team });
+
+		for (auto i = ForceField::list.iterator(); !i.is_last(); i.next())
+			state.force_fields.add({ i.item()->get<Transform>()->absolute_pos(), i.item()->team });
+
+		sync_in.begin_write();
+		sync_in.write(Op::UpdateState);
+		sync_in.write(state.rectifiers.length);
+		sync_in.write(state.rectifiers.data, state.rectifiers.length);
+		sync_in.write(state.force_fields.length);
+		sync_in.write(state.force_fields.data, state.force_fields.length);
+		sync_in.end_write();
+	}
+
+	sync_out.begin_read();
+	callbacks_read();
+	sync_out.end_read();
+
+	if (Benchmark::active)
+	{
+		// benchmark runs need every result to land on the same tick each time, so wait for all outstanding requests
+		// requests made by these callbacks get picked up next tick
+		u32 last_request_id = callback_in_id;
+		while (s32(last_request_id - callback_out_id) > 0)
+		{
+			sync_out.wait_read();
+			callbacks_read();
+			sync_out.end_read();
+		}
+	}
 }
 
 b8 match(Team t, TeamMask m)
@@ -213,13 +271,13 @@ u32 obstacle_add(const Vec3& pos, r32 radius, r32 height)
 		id = obstacles.end;
 	obstacles.set(id, true);
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::ObstacleAdd);
 	sync_in.write(id);
 	sync_in.write(pos);
 	sync_in.write(radius);
 	sync_in.write(height);
-	sync_in.unlock();
+	sync_in.end_write();
 
 	return id;
 }
@@ -229,16 +287,16 @@ void obstacle_remove(u32 id)
 	if (id < nav_max_obstacles)
 	{
 		obstacles.set(id, false);
-		sync_in.lock();
+		sync_in.begin_write();
 		sync_in.write(Op::ObstacleRemove);
 		sync_in.write(id);
-		sync_in.unlock();
+		sync_in.end_write();
 	}
 }
 
 void load(AssetID id, const char* filename)
 {
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::Load);
 	sync_in.write(id);
 	{
@@ -248,7 +306,7 @@ void load(AssetID id, const char* filename)
 		if (length > 0)
 			sync_in.write(filename, length);
 	}
-	sync_in.unlock();
+	sync_in.end_write();
 	level_revision++;
 
 	drone_nav_mesh.~DroneNavMesh();
@@ -323,14 +381,14 @@ u32 random_path(const Vec3& pos, const Vec3& patrol_point, AI::Team team, r32 ra
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::RandomPath);
 	sync_in.write(pos);
 	sync_in.write(patrol_point);
 	sync_in.write(team);
 	sync_in.write(range);
 	sync_in.write(callback);
-	sync_in.unlock();
+	sync_in.end_write();
 
 	return id;
 }
@@ -340,11 +398,11 @@ u32 closest_walk_point(const Vec3& pos, const LinkEntryArg<const Vec3&>& callbac
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::ClosestWalkPoint);
 	sync_in.write(pos);
 	sync_in.write(callback);
-	sync_in.unlock();
+	sync_in.end_write();
 
 	return id;
 }
@@ -359,13 +417,18 @@ u32 pathfind(AI::Team team, const Vec3& a, const Vec3& b, const LinkEntryArg<con
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+#if !RELEASE_BUILD
+	latency_stats.request_id[id % LATENCY_SLOTS] = id;
+	latency_stats.request_time[id % LATENCY_SLOTS] = platform::time();
+#endif
+
+	sync_in.begin_write();
 	sync_in.write(Op::Pathfind);
 	sync_in.write(team);
 	sync_in.write(a);
 	sync_in.write(b);
 	sync_in.write(callback);
-	sync_in.unlock();
+	sync_in.end_write();
 
 	return id;
 }
@@ -375,7 +438,7 @@ u32 drone_pathfind(DronePathfind type, DroneAllow rule, Team team, const Vec3& a
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::DronePathfind);
 	sync_in.write(type);
 	sync_in.write(rule);
@@ -390,7 +453,7 @@ u32 drone_pathfind(DronePathfind type, DroneAllow rule, Team team, const Vec3& a
 		if (type != DronePathfind::Target)
 			sync_in.write(b_normal);
 	}
-	sync_in.unlock();
+	sync_in.end_write();
 	
 	return id;
 }
@@ -405,7 +468,7 @@ u32 audio_pathfind(const Vec3& a, const Vec3& b, AudioEntry* entry, s8 listener,
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::AudioPathfind);
 	Ref<AudioEntry> ref = entry;
 	sync_in.write(ref);
@@ -413,7 +476,7 @@ u32 audio_pathfind(const Vec3& a, const Vec3& b, AudioEntry* entry, s8 listener,
 	sync_in.write(a);
 	sync_in.write(b);
 	sync_in.write(straight_distance);
-	sync_in.unlock();
+	sync_in.end_write();
 	
 	return id;
 }
@@ -428,23 +491,23 @@ u32 drone_closest_point(const Vec3& pos, AI::Team team, const LinkEntryArg<const
 	u32 id = callback_in_id;
 	callback_in_id++;
 
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::DroneClosestPoint);
 	sync_in.write(callback);
 	sync_in.write(team);
 	sync_in.write(pos);
-	sync_in.unlock();
+	sync_in.end_write();
 	
 	return id;
 }
 
 void drone_mark_adjacency_bad(DroneNavMeshNode a, DroneNavMeshNode b)
 {
-	sync_in.lock();
+	sync_in.begin_write();
 	sync_in.write(Op::DroneMarkAdjacencyBad);
 	sync_in.write(a);
 	sync_in.write(b);
-	sync_in.unlock();
+	sync_in.end_write();
 }
 
 void NavGameState::clear()
@@ -482,7 +545,6 @@ void refresh_nav_render_meshes(const RenderParams& params)
 		return;
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(30));
-	sync_in.lock();
 
 	if (render_mesh == AssetNull)
 	{
@@ -541,8 +603,6 @@ void refresh_nav_render_meshes(const RenderParams& params)
 		params.sync->write<s32>(indices.data, indices.length);
 	}
 
-	sync_in.unlock();
-
 	render_meshes_dirty = false;
 }
 
@@ -169,6 +169,10 @@ void audio_reverb_calc(const Vec3&, ReverbCell*);
 
 b8 vision_check(const Vec3&, const Vec3&, const Entity* = nullptr, const Entity* = nullptr);
 
+#if !RELEASE_BUILD
+void benchmark_latency();
+#endif
+
 namespace Worker
 {
 	struct NavMeshProcess : public dtTileCacheMeshProcess
@@ -187,6 +191,8 @@ namespace Worker
 
 		r32 travel_score;
 		r32 estimate_score;
+		s32 heap_index; // position in the A* queue; only valid while FlagInQueue is set
+		u32 generation; // search this data belongs to; anything older is treated as untouched
 		DroneNavMeshNode parent;
 		s8 flags;
 
@@ -207,13 +213,15 @@ namespace Worker
 	struct DroneNavMeshKey
 	{
 		Chunks<Array<DroneNavMeshNodeData>> data;
+		u32 generation = 0;
 		r32 priority(const DroneNavMeshNode&);
 		void resize(const DroneNavMesh&);
 		void reset();
 		DroneNavMeshNodeData& get(const DroneNavMeshNode&);
+		s32& heap_index(const DroneNavMeshNode&);
 	};
 
-	typedef PriorityQueue<DroneNavMeshNode, DroneNavMeshKey> AstarQueue;
+	typedef PriorityQueue<DroneNavMeshNode, DroneNavMeshKey, true> AstarQueue;
 
 	struct DroneNavContext
 	{
@@ -232,7 +240,7 @@ namespace Worker
 	const extern r32 default_search_extents[];
 
 	extern dtNavMesh* nav_mesh;
-	extern dtNavMeshQuery* nav_mesh_query;
+	extern thread_local dtNavMeshQuery* nav_mesh_query;
 	extern dtTileCache* nav_tile_cache;
 	extern dtQueryFilter default_query_filter;
 	extern dtTileCache* nav_tile_cache;
@@ -241,9 +249,14 @@ namespace Worker
 	extern NavMeshProcess nav_tile_mesh_process;
 
 	void loop();
+	s32 pool_thread_count();
 
 	r32 audio_pathfind(const DroneNavContext&, const Vec3&, const Vec3&);
 	void audio_reverb_calc(const DroneNavContext&, const Vec3&, ReverbCell*);
+
+#if !RELEASE_BUILD
+	void benchmark_astar(s32 = 128);
+#endif
 }
 
 extern ComponentMask entity_mask;
@@ -5,12 +5,13 @@
 #include "recast/Detour/Include/DetourCommon.h"
 #include "mersenne/mersenne-twister.h"
 #include "game/audio.h"
+#include "profile.h"
 
 #define DEBUG_WALK 0
 #define DEBUG_DRONE 0
 #define DEBUG_AUDIO 0
 
-#if DEBUG_WALK || DEBUG_DRONE
+#if DEBUG_WALK || DEBUG_DRONE || DEBUG_AUDIO || !RELEASE_BUILD
 #include "platform/util.h"
 #endif
 
@@ -34,7 +35,7 @@ dtTileCache* nav_tile_cache = nullptr;
 dtTileCacheAlloc nav_tile_allocator;
 FastLZCompressor nav_tile_compressor;
 NavMeshProcess nav_tile_mesh_process;
-dtNavMeshQuery* nav_mesh_query = nullptr;
+thread_local dtNavMeshQuery* nav_mesh_query = nullptr; // each pool thread has its own
 dtQueryFilter default_query_filter = dtQueryFilter();
 const r32 default_search_extents[] = { 15, 10, 15 };
 
@@ -314,6 +315,10 @@ inline b8 drone_flags_match(b8 flags, DroneAllow mask)
 	return s32(mask) & s32(flags ? DroneAllow::Crawl : DroneAllow::Shoot);
 }
 
+#if !RELEASE_BUILD
+b8 astar_linear_decrease_key; // benchmark only; find queued nodes with a linear heap search like we used to
+#endif
+
 // A*
 void drone_astar(const DroneNavContext& ctx, DroneAllow rule, Team team, const DroneNavMeshNode& start_vertex, AstarScorer* scorer, DronePath* path)
 {
@@ -330,9 +335,9 @@ void drone_astar(const DroneNavContext& ctx, DroneAllow rule, Team team, const D
 
 	ctx.key->reset();
 	ctx.astar_queue->clear();
-	ctx.astar_queue->push(start_vertex);
 
 	{
+		// initialize the node for this search before the queue writes its heap index into it
 		DroneNavMeshNodeData* start_data = &ctx.key->get(start_vertex);
 		start_data->travel_score = 0;
 		start_data->estimate_score = scorer->score(start_pos);
@@ -345,6 +350,8 @@ void drone_astar(const DroneNavContext& ctx, DroneAllow rule, Team team, const D
 #endif
 	}
 
+	ctx.astar_queue->push(start_vertex);
+
 	while (ctx.astar_queue->size() > 0)
 	{
 		DroneNavMeshNode vertex_node = ctx.astar_queue->pop();
@@ -419,14 +426,21 @@ void drone_astar(const DroneNavContext& ctx, DroneAllow rule, Team team, const D
 							adjacent_data->travel_score = candidate_travel_score;
 
 							// update its position in the queue due to the score change
-							for (s32 j = 0; j < ctx.astar_queue->size(); j++)
+#if !RELEASE_BUILD
+							if (astar_linear_decrease_key)
 							{
-								if (ctx.astar_queue->heap[j].equals(adjacent_node))
+								for (s32 j = 0; j < ctx.astar_queue->size(); j++)
 								{
-									ctx.astar_queue->update(j);
-									break;
+									if (ctx.astar_queue->heap[j].equals(adjacent_node))
+									{
+										ctx.astar_queue->update(j);
+										break;
+									}
 								}
 							}
+							else
+#endif
+							ctx.astar_queue->update_entry(adjacent_node);
 						}
 					}
 					else
@@ -436,7 +450,7 @@ void drone_astar(const DroneNavContext& ctx, DroneAllow rule, Team team, const D
 						adjacent_data->parent = vertex_node;
 						adjacent_data->travel_score = candidate_travel_score;
 						adjacent_data->estimate_score = scorer->score(adjacent_pos);
-						adjacent_data->flag(DroneNavMeshNodeData::FlagVisited, true);
+						adjacent_data->flag(DroneNavMeshNodeData::FlagInQueue, true);
 						ctx.astar_queue->push(adjacent_node);
 					}
 				}
@@ -738,34 +752,470 @@ void pathfind(const NavGameState& nav_game_state, AI::Team team, const Vec3& a,
 	}
 }
 
+// read-only queries are answered in parallel by a pool of threads, each with its own detour query and A* state.
+// anything that changes the nav mesh or the game state is a barrier: every outstanding query finishes first.
+// results go out through sync_out in the order the queries came in, regardless of which thread finished first.
+
+#define AI_POOL_JOBS 64
+#define AI_POOL_THREADS_MAX 4
+
+// everything a read-only query needs from sync_in
+struct Query
+{
+	LinkEntryArg<Path> callback; // all LinkEntryArgs are the same size
+	Ref<AudioEntry> audio_entry;
+	Vec3 a;
+	Vec3 a_normal;
+	Vec3 b;
+	Vec3 b_normal;
+	r32 value;
+	u32 seed;
+	Op op;
+	DronePathfind drone_type;
+	DroneAllow rule;
+	AI::Team team;
+	s8 listener;
+};
+
+struct Job
+{
+	Query query;
+	SyncBuffer out; // exactly what we'll write to sync_out
+	b8 done;
+};
+
+struct PoolThread
+{
+	std::thread runner;
+	dtNavMeshQuery* nav_mesh_query;
+	DroneNavMeshKey drone_nav_mesh_key;
+	AstarQueue astar_queue;
+	const DroneNavContext ctx;
+	const DroneNavContext ctx_audio;
+
+	PoolThread(const DroneNavMesh& mesh, const NavGameState& game_state, const NavGameState& game_state_empty)
+		: runner(),
+		nav_mesh_query(dtAllocNavMeshQuery()),
+		drone_nav_mesh_key(),
+		astar_queue(&drone_nav_mesh_key),
+		ctx{ mesh, &drone_nav_mesh_key, game_state, &astar_queue, DroneNavFlagBias },
+		ctx_audio{ mesh, &drone_nav_mesh_key, game_state_empty, &astar_queue, 0 }
+	{
+	}
+
+	~PoolThread()
+	{
+		dtFreeNavMeshQuery(nav_mesh_query);
+	}
+};
+
+struct Pool
+{
+	Job jobs[AI_POOL_JOBS];
+	std::mutex mutex;
+	std::condition_variable condition_work; // wakes up pool threads
+	std::condition_variable condition_done; // wakes up the dispatcher
+	// running totals; job i lives in jobs[i % AI_POOL_JOBS]
+	u32 submitted;
+	u32 claimed;
+	u32 flushed;
+	u32 seed; // dispatcher only; reset on every level load so runs are repeatable
+	b8 quit;
+
+	Pool()
+		: jobs(), mutex(), condition_work(), condition_done(), submitted(), claimed(), flushed(), seed(1), quit()
+	{
+	}
+};
+
+Pool pool;
+
+// detour wants a plain function pointer for random numbers, and mersenne is not thread safe,
+// so each query gets its own seed from the dispatcher
+thread_local u32 pool_random_state;
+
+r32 pool_randf_co()
+{
+	// xorshift32
+	pool_random_state ^= pool_random_state << 13;
+	pool_random_state ^= pool_random_state >> 17;
+	pool_random_state ^= pool_random_state << 5;
+	return r32(pool_random_state >> 8) * (1.0f / r32(1 << 24));
+}
+
+void job_execute(PoolThread* thread, Job* job)
+{
+	const DroneNavContext& ctx = thread->ctx;
+	const DroneNavMesh& drone_nav_mesh = ctx.mesh;
+	const NavGameState& nav_game_state = ctx.game_state;
+	const Query& q = job->query;
+	pool_random_state = q.seed | 1;
+	job->out.queue.length = 0;
+	job->out.read_pos = 0;
+
+	switch (q.op)
+	{
+		case Op::Pathfind:
+		{
+#if DEBUG_WALK
+			r64 start_time = platform::time();
+			vi_debug("%s", "Walk pathfind...");
+#endif
+			dtPolyRef start_poly = get_poly(q.a, default_search_extents);
+			dtPolyRef end_poly = get_poly(q.b, default_search_extents);
+
+			Path path;
+
+			if (start_poly && end_poly)
+				pathfind(nav_game_state, q.team, q.a, q.b, start_poly, end_poly, &path);
+
+			job->out.write(Callback::Path);
+			job->out.write(q.callback);
+			job->out.write(path);
+
+#if DEBUG_WALK
+			vi_debug("%d nodes in %fs", path.length, r32(platform::time() - start_time));
+#endif
+			break;
+		}
+		case Op::RandomPath:
+		{
+#if DEBUG_WALK
+			r64 start_time = platform::time();
+			vi_debug("%s", "Walk random path...");
+#endif
+			const Vec3& start = q.a;
+			Vec3 patrol_point = q.b;
+			r32 range = q.value;
+
+			dtPolyRef start_poly = get_poly(start, default_search_extents);
+			dtPolyRef patrol_point_poly = get_poly(patrol_point, default_search_extents);
+
+			u32 hash_start = force_field_hash(nav_game_state, q.team, start);
+
+			Vec3 end;
+			dtPolyRef end_poly;
+			b8 valid = false;
+			{
+				s32 tries = 0;
+				do
+				{
+					nav_mesh_query->findRandomPointAroundCircle(patrol_point_poly, (r32*)(&patrol_point), range * (0.75f + pool_randf_co() * 0.5f), &default_query_filter, pool_randf_co, &end_poly, (r32*)(&end));
+					valid = force_field_hash(nav_game_state, q.team, end) == hash_start;
+					tries++;
+				} while (!valid && tries < 20);
+			}
+
+			Path path;
+
+			if (start_poly && end_poly && valid)
+				pathfind(nav_game_state, q.team, start, end, start_poly, end_poly, &path);
+
+			job->out.write(Callback::Path);
+			job->out.write(q.callback);
+			job->out.write(path);
+
+#if DEBUG_WALK
+			vi_debug("%d nodes in %fs", path.length, r32(platform::time() - start_time));
+#endif
+			break;
+		}
+		case Op::ClosestWalkPoint:
+		{
+#if DEBUG_WALK
+			r64 start_time = platform::time();
+			vi_debug("%s", "Walkable point query...");
+#endif
+			dtPolyRef poly = get_poly(q.a, default_search_extents);
+			Vec3 closest;
+			nav_mesh_query->closestPointOnPoly(poly, (r32*)(&q.a), (r32*)(&closest), 0);
+
+			job->out.write(Callback::Point);
+			job->out.write(q.callback);
+			job->out.write(closest);
+
+#if DEBUG_WALK
+			vi_debug("Done in %fs", r32(platform::time() - start_time));
+#endif
+			break;
+		}
+		case Op::DronePathfind:
+		{
+			DroneAllow rule = q.rule;
+			Team team = q.team;
+			const Vec3& start = q.a;
+			const Vec3& start_normal = q.a_normal;
+
+			DronePath path;
+
+			switch (q.drone_type)
+			{
+				case DronePathfind::LongRange:
+				{
+					drone_pathfind
+					(
+						ctx,
+						rule,
+						team,
+						drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal),
+						drone_closest_point(drone_nav_mesh, nav_game_state, team, q.b, q.b_normal),
+						&path
+					);
+					break;
+				}
+				case DronePathfind::Target:
+				{
+					drone_pathfind_hit(ctx, rule, team, start, start_normal, q.b, &path);
+					break;
+				}
+				case DronePathfind::Spawn:
+				{
+					SpawnScorer scorer;
+					scorer.mesh = &drone_nav_mesh;
+					scorer.dir = q.b;
+					scorer.start_pos = start;
+					scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
+
+					drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
+					break;
+				}
+				case DronePathfind::Random:
+				{
+					RandomScorer scorer;
+					scorer.mesh = &drone_nav_mesh;
+					scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
+					scorer.start_pos = start;
+					scorer.minimum_distance = rule == DroneAllow::Crawl ? DRONE_MAX_DISTANCE * 0.5f : DRONE_MAX_DISTANCE * 3.0f;
+					scorer.minimum_distance = vi_min(scorer.minimum_distance,
+						vi_min(drone_nav_mesh.size.x, drone_nav_mesh.size.z) * drone_nav_mesh.chunk_size * 0.5f);
+					scorer.goal = drone_nav_mesh.vmin +
+					Vec3
+					(
+						pool_randf_co() * (drone_nav_mesh.size.x * drone_nav_mesh.chunk_size),
+						pool_randf_co() * (drone_nav_mesh.size.y * drone_nav_mesh.chunk_size),
+						pool_randf_co() * (drone_nav_mesh.size.z * drone_nav_mesh.chunk_size)
+					);
+
+					drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
+					break;
+				}
+				case DronePathfind::Away:
+				{
+					AwayScorer scorer;
+					scorer.mesh = &drone_nav_mesh;
+					scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
+					scorer.away_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, q.b, q.b_normal);
+					if (!scorer.away_vertex.equals(DRONE_NAV_MESH_NODE_NONE))
+					{
+						scorer.away_pos = q.b;
+						scorer.minimum_distance = rule == DroneAllow::Crawl ? DRONE_MAX_DISTANCE * 0.5f : DRONE_MAX_DISTANCE * 3.0f;
+						scorer.minimum_distance = vi_min(scorer.minimum_distance,
+							vi_min(drone_nav_mesh.size.x, drone_nav_mesh.size.z) * drone_nav_mesh.chunk_size * 0.5f);
+
+						drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
+					}
+					break;
+				}
+				default:
+				{
+					vi_assert(false);
+					break;
+				}
+			}
+
+			job->out.write(Callback::DronePath);
+			job->out.write(q.callback);
+			job->out.write(path);
+			break;
+		}
+		case Op::DroneClosestPoint:
+		{
+			DronePathNode result;
+			result.ref = drone_closest_point(drone_nav_mesh, nav_game_state, q.team, q.a);
+			if (result.ref.equals(DRONE_NAV_MESH_NODE_NONE))
+			{
+				result.pos = q.a;
+				result.normal = Vec3(0, 1, 0);
+			}
+			else
+			{
+				result.pos = drone_nav_mesh.chunks[result.ref.chunk].vertices[result.ref.vertex];
+				result.normal = drone_nav_mesh.chunks[result.ref.chunk].normals[result.ref.vertex];
+			}
+
+			job->out.write(Callback::DronePoint);
+			job->out.write(q.callback);
+			job->out.write(result);
+			break;
+		}
+		case Op::AudioPathfind:
+		{
+			r32 path_length = audio_pathfind(thread->ctx_audio, q.a, q.b);
+
+			job->out.write(Callback::AudioPath);
+			job->out.write(q.audio_entry);
+			job->out.write(q.listener);
+			job->out.write(path_length);
+			job->out.write(q.value);
+			break;
+		}
+		default:
+			vi_assert(false);
+			break;
+	}
+}
+
+void pool_thread_loop(PoolThread* thread)
+{
+	vi_profile_thread("ai pool");
+	nav_mesh_query = thread->nav_mesh_query;
+	while (true)
+	{
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			while (!pool.quit && pool.claimed == pool.submitted)
+				pool.condition_work.wait(lock);
+			if (pool.quit)
+				break;
+			job = &pool.jobs[pool.claimed % AI_POOL_JOBS];
+			pool.claimed++;
+		}
+
+		{
+			vi_profile("AI::job");
+			job_execute(thread, job);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			job->done = true;
+		}
+		pool.condition_done.notify_one();
+	}
+}
+
+// write every finished job at the front of the line to sync_out
+// if wait is true, block until at least the oldest outstanding job is finished
+void pool_flush(b8 wait)
+{
+	u32 first;
+	u32 ready = 0;
+	{
+		std::unique_lock<std::mutex> lock(pool.mutex);
+		first = pool.flushed;
+		if (wait)
+		{
+			while (first != pool.submitted && !pool.jobs[first % AI_POOL_JOBS].done)
+				pool.condition_done.wait(lock);
+		}
+		while (first + ready != pool.submitted && pool.jobs[(first + ready) % AI_POOL_JOBS].done)
+			ready++;
+	}
+
+	if (ready > 0)
+	{
+		// finished jobs aren't touched by pool threads until we hand their slots back
+		sync_out.begin_write();
+		for (u32 i = 0; i < ready; i++)
+		{
+			Job* job = &pool.jobs[(first + i) % AI_POOL_JOBS];
+			sync_out.write(job->out.queue.data, job->out.queue.length);
+			job->done = false;
+		}
+		sync_out.end_write();
+
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.flushed += ready;
+	}
+}
+
+inline b8 pool_busy()
+{
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	return pool.flushed != pool.submitted;
+}
+
+// wait for every outstanding query to finish and go out, before we change anything they might be reading
+void pool_barrier()
+{
+	while (pool_busy())
+		pool_flush(true);
+}
+
+// hand a query to the pool. blocks if every slot is taken
+void pool_submit(const Query& query)
+{
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if (pool.submitted - pool.flushed < AI_POOL_JOBS)
+				break;
+		}
+		pool_flush(true);
+	}
+
+	Job* job = &pool.jobs[pool.submitted % AI_POOL_JOBS];
+	job->query = query;
+	// xorshift32; mersenne belongs to the main thread
+	pool.seed ^= pool.seed << 13;
+	pool.seed ^= pool.seed >> 17;
+	pool.seed ^= pool.seed << 5;
+	job->query.seed = pool.seed;
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.submitted++;
+	}
+	pool.condition_work.notify_one();
+}
+
+#if VI_PROFILE
+const char* op_names[s32(Op::count)] =
+{
+	"AI::Load",
+	"AI::ObstacleAdd",
+	"AI::ObstacleRemove",
+	"AI::Pathfind",
+	"AI::DronePathfind",
+	"AI::DroneMarkAdjacencyBad",
+	"AI::DroneClosestPoint",
+	"AI::RandomPath",
+	"AI::ClosestWalkPoint",
+	"AI::UpdateState",
+	"AI::Quit",
+	"AI::AudioPathfind",
+};
+#endif
+
+// the job system sizes itself around this
+s32 pool_thread_count()
+{
+	return vi_max(1, vi_min(AI_POOL_THREADS_MAX, s32(std::thread::hardware_concurrency()) - 3));
+}
+
 void loop()
 {
-	nav_mesh_query = dtAllocNavMeshQuery();
+	vi_profile_thread("ai");
 	default_query_filter.setIncludeFlags(u16(-1));
 	default_query_filter.setExcludeFlags(0);
 
 	DroneNavMesh drone_nav_mesh;
-	DroneNavMeshKey drone_nav_mesh_key;
 	NavGameState nav_game_state;
+	NavGameState nav_game_state_next;
 	NavGameState nav_game_state_empty;
-	AstarQueue astar_queue(&drone_nav_mesh_key);
 	Revision level_revision = 0;
-	const DroneNavContext ctx =
-	{
-		drone_nav_mesh,
-		&drone_nav_mesh_key,
-		nav_game_state,
-		&astar_queue,
-		DroneNavFlagBias,
-	};
-	const DroneNavContext ctx_audio =
+
+	StaticArray<PoolThread*, AI_POOL_THREADS_MAX> pool_threads;
 	{
-		drone_nav_mesh,
-		&drone_nav_mesh_key,
-		nav_game_state_empty,
-		&astar_queue,
-		0,
-	};
+		s32 thread_count = pool_thread_count();
+		for (s32 i = 0; i < thread_count; i++)
+		{
+			PoolThread* thread = new PoolThread(drone_nav_mesh, nav_game_state, nav_game_state_empty);
+			pool_threads.add(thread);
+			thread->runner = std::thread(pool_thread_loop, thread);
+		}
+	}
 
 	Array<u32> obstacle_recast_ids;
 
@@ -773,8 +1223,20 @@ void loop()
 	Op op;
 	while (run)
 	{
-		sync_in.lock_wait_read();
+		pool_flush(false);
+		if (pool_busy())
+		{
+			// don't sleep on sync_in while there are results to deliver
+			if (!sync_in.begin_read())
+			{
+				pool_flush(true);
+				continue;
+			}
+		}
+		else
+			sync_in.wait_read();
 		sync_in.read(&op);
+		vi_profile_begin(op_names[s32(op)]);
 		switch (op)
 		{
 			case Op::Load:
@@ -783,6 +1245,20 @@ void loop()
 				vi_debug("%s", "Loading nav mesh...");
 				r32 start_time = platform::time();
 #endif
+				AssetID level_id;
+				sync_in.read(&level_id);
+
+				// nav mesh path
+				char path[MAX_PATH_LENGTH + 1];
+				s32 path_length;
+				sync_in.read(&path_length);
+				vi_assert(path_length <= MAX_PATH_LENGTH);
+				sync_in.read(path, path_length);
+				sync_in.end_read();
+				path[path_length] = '\0';
+
+				pool_barrier();
+
 				// free old data if necessary
 				{
 					if (nav_mesh)
@@ -797,36 +1273,29 @@ void loop()
 					}
 					drone_nav_mesh.~DroneNavMesh();
 					new (&drone_nav_mesh) DroneNavMesh();
-					drone_nav_mesh_key.~DroneNavMeshKey();
-					new (&drone_nav_mesh_key) DroneNavMeshKey();
+					for (s32 i = 0; i < pool_threads.length; i++)
+					{
+						PoolThread* thread = pool_threads[i];
+						thread->drone_nav_mesh_key.~DroneNavMeshKey();
+						new (&thread->drone_nav_mesh_key) DroneNavMeshKey();
+					}
 
 					nav_game_state.clear();
 				}
 
-				AssetID level_id;
-				sync_in.read(&level_id);
-
 				// get nav mesh filename and load it
 				FILE* f = nullptr;
 				s32 data_length = 0;
 				{
-					// nav mesh path
-					char path[MAX_PATH_LENGTH + 1];
-					s32 path_length;
-					sync_in.read(&path_length);
-					vi_assert(path_length <= MAX_PATH_LENGTH);
-					sync_in.read(path, path_length);
-					sync_in.unlock();
-					path[path_length] = '\0';
-
 					// unlock sync
 					{
 						level_revision++;
+						pool.seed = 0x9e3779b9 ^ u32(level_revision);
 
-						sync_out.lock();
+						sync_out.begin_write();
 						sync_out.write(Callback::Load);
 						sync_out.write(level_revision);
-						sync_out.unlock();
+						sync_out.end_write();
 					}
 
 					// open nav mesh file
@@ -946,13 +1415,17 @@ void loop()
 							}
 						}
 
-						dtStatus status = nav_mesh_query->init(nav_mesh, 2048);
-						vi_assert(dtStatusSucceed(status));
+						for (s32 i = 0; i < pool_threads.length; i++)
+						{
+							dtStatus status = pool_threads[i]->nav_mesh_query->init(nav_mesh, 2048);
+							vi_assert(dtStatusSucceed(status));
+						}
 					}
 
 					// drone nav mesh
 					drone_nav_mesh.read(f);
-					drone_nav_mesh_key.resize(drone_nav_mesh);
+					for (s32 i = 0; i < pool_threads.length; i++)
+						pool_threads[i]->drone_nav_mesh_key.resize(drone_nav_mesh);
 				}
 
 				if (f)
@@ -963,7 +1436,8 @@ void loop()
 					s32 vertex_count = 0;
 					for (s32 i = 0; i < drone_nav_mesh.chunks.length; i++)
 						vertex_count += drone_nav_mesh.chunks[i].adjacency.length;
-					astar_queue.reserve(vertex_count);
+					for (s32 i = 0; i < pool_threads.length; i++)
+						pool_threads[i]->astar_queue.reserve(vertex_count);
 				}
 
 #if DEBUG_WALK || DEBUG_DRONE || DEBUG_AUDIO
@@ -982,7 +1456,7 @@ void loop()
 				sync_in.read(&radius);
 				r32 height;
 				sync_in.read(&height);
-				sync_in.unlock();
+				sync_in.end_read();
 
 				if (s32(id) > obstacle_recast_ids.length - 1)
 				{
@@ -992,6 +1466,7 @@ void loop()
 
 				if (nav_tile_cache)
 				{
+					pool_barrier();
 					nav_tile_cache->addObstacle((r32*)(&pos), radius, height, &obstacle_recast_ids[id]);
 					nav_tile_cache->update(0.0f, nav_mesh); // todo: batch obstacle API calls together
 				}
@@ -1001,13 +1476,14 @@ void loop()
 			{
 				u32 id;
 				sync_in.read(&id);
-				sync_in.unlock();
+				sync_in.end_read();
 
 				if (nav_tile_cache)
 				{
 					u32 recast_id = obstacle_recast_ids[id];
 					if (recast_id != -1)
 					{
+						pool_barrier();
 						nav_tile_cache->removeObstacle(recast_id);
 						nav_tile_cache->update(0.0f, nav_mesh); // todo: batch obstacle API calls together
 					}
@@ -1016,272 +1492,86 @@ void loop()
 			}
 			case Op::Pathfind:
 			{
-#if DEBUG_WALK
-				r64 start_time = platform::time();
-				vi_debug("%s", "Walk pathfind...");
-#endif
-
-				AI::Team team;
-				Vec3 a;
-				Vec3 b;
-				LinkEntryArg<Path> callback;
-				sync_in.read(&team);
-				sync_in.read(&a);
-				sync_in.read(&b);
-				sync_in.read(&callback);
-				sync_in.unlock();
-
-				dtPolyRef start_poly = get_poly(a, default_search_extents);
-
-				dtPolyRef end_poly = get_poly(b, default_search_extents);
-
-				Path path;
-
-				if (start_poly && end_poly)
-					pathfind(nav_game_state, team, a, b, start_poly, end_poly, &path);
-				
-				sync_out.lock();
-				sync_out.write(Callback::Path);
-				sync_out.write(callback);
-				sync_out.write(path);
-				sync_out.unlock();
-
-#if DEBUG_WALK
-				vi_debug("%d nodes in %fs", path.length, r32(platform::time() - start_time));
-#endif
-
+				Query query;
+				query.op = op;
+				sync_in.read(&query.team);
+				sync_in.read(&query.a);
+				sync_in.read(&query.b);
+				sync_in.read(&query.callback);
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::RandomPath:
 			{
-#if DEBUG_WALK
-				r64 start_time = platform::time();
-				vi_debug("%s", "Walk random path...");
-#endif
-				Vec3 start;
-				sync_in.read(&start);
-				Vec3 patrol_point;
-				sync_in.read(&patrol_point);
-				AI::Team team;
-				sync_in.read(&team);
-				r32 range;
-				sync_in.read(&range);
-				LinkEntryArg<Path> callback;
-				sync_in.read(&callback);
-				sync_in.unlock();
-
-				dtPolyRef start_poly = get_poly(start, default_search_extents);
-				dtPolyRef patrol_point_poly = get_poly(patrol_point, default_search_extents);
-
-				u32 hash_start = force_field_hash(nav_game_state, team, start);
-
-				Vec3 end;
-				dtPolyRef end_poly;
-				b8 valid = false;
-				{
-					s32 tries = 0;
-					do
-					{
-						nav_mesh_query->findRandomPointAroundCircle(patrol_point_poly, (r32*)(&patrol_point), range * (0.75f + mersenne::randf_co() * 0.5f), &default_query_filter, mersenne::randf_co, &end_poly, (r32*)(&end));
-						valid = force_field_hash(nav_game_state, team, end) == hash_start;
-						tries++;
-					} while (!valid && tries < 20);
-				}
-
-				Path path;
-
-				if (start_poly && end_poly && valid)
-					pathfind(nav_game_state, team, start, end, start_poly, end_poly, &path);
-
-				sync_out.lock();
-				sync_out.write(Callback::Path);
-				sync_out.write(callback);
-				sync_out.write(path);
-				sync_out.unlock();
-
-#if DEBUG_WALK
-				vi_debug("%d nodes in %fs", path.length, r32(platform::time() - start_time));
-#endif
-
+				Query query;
+				query.op = op;
+				sync_in.read(&query.a); // start
+				sync_in.read(&query.b); // patrol point
+				sync_in.read(&query.team);
+				sync_in.read(&query.value); // range
+				sync_in.read(&query.callback);
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::ClosestWalkPoint:
 			{
-#if DEBUG_WALK
-				r64 start_time = platform::time();
-				vi_debug("%s", "Walkable point query...");
-#endif
-				LinkEntryArg<Path> callback;
-				Vec3 pos;
-				sync_in.read(&pos);
-				sync_in.read(&callback);
-				sync_in.unlock();
-
-				dtPolyRef poly = get_poly(pos, default_search_extents);
-				Vec3 closest;
-				nav_mesh_query->closestPointOnPoly(poly, (r32*)(&pos), (r32*)(&closest), 0);
-
-				sync_out.lock();
-				sync_out.write(Callback::Point);
-				sync_out.write(callback);
-				sync_out.write(closest);
-				sync_out.unlock();
-
-#if DEBUG_WALK
-				vi_debug("Done in %fs", r32(platform::time() - start_time));
-#endif
+				Query query;
+				query.op = op;
+				sync_in.read(&query.a);
+				sync_in.read(&query.callback);
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::DronePathfind:
 			{
-				DronePathfind type;
-				DroneAllow rule;
-				Team team;
-				Vec3 start;
-				Vec3 start_normal;
-				sync_in.read(&type);
-				sync_in.read(&rule);
-				sync_in.read(&team);
-				LinkEntryArg<DronePath> callback;
-				sync_in.read(&callback);
-				sync_in.read(&start);
-				sync_in.read(&start_normal);
-
-				DronePath path;
-
-				switch (type)
+				Query query;
+				query.op = op;
+				sync_in.read(&query.drone_type);
+				sync_in.read(&query.rule);
+				sync_in.read(&query.team);
+				sync_in.read(&query.callback);
+				sync_in.read(&query.a);
+				sync_in.read(&query.a_normal);
+
+				switch (query.drone_type)
 				{
 					case DronePathfind::LongRange:
+					case DronePathfind::Away:
 					{
-						Vec3 end;
-						sync_in.read(&end);
-						Vec3 end_normal;
-						sync_in.read(&end_normal);
-						sync_in.unlock();
-						drone_pathfind
-						(
-							ctx,
-							rule,
-							team,
-							drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal),
-							drone_closest_point(drone_nav_mesh, nav_game_state, team, end, end_normal),
-							&path
-						);
+						sync_in.read(&query.b);
+						sync_in.read(&query.b_normal);
 						break;
 					}
-					case DronePathfind::Target:
+					case DronePathfind::Target: // target position
+					case DronePathfind::Spawn: // direction
 					{
-						Vec3 end;
-						sync_in.read(&end);
-						sync_in.unlock();
-						drone_pathfind_hit(ctx, rule, team, start, start_normal, end, &path);
-						break;
-					}
-					case DronePathfind::Spawn:
-					{
-						Vec3 dir;
-						sync_in.read(&dir);
-						sync_in.unlock();
-
-						SpawnScorer scorer;
-						scorer.mesh = &drone_nav_mesh;
-						scorer.dir = dir;
-						scorer.start_pos = start;
-						scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
-
-						drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
-						
+						sync_in.read(&query.b);
 						break;
 					}
 					case DronePathfind::Random:
-					{
-						sync_in.unlock();
-
-						RandomScorer scorer;
-						scorer.mesh = &drone_nav_mesh;
-						scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
-						scorer.start_pos = start;
-						scorer.minimum_distance = rule == DroneAllow::Crawl ? DRONE_MAX_DISTANCE * 0.5f : DRONE_MAX_DISTANCE * 3.0f;
-						scorer.minimum_distance = vi_min(scorer.minimum_distance,
-							vi_min(drone_nav_mesh.size.x, drone_nav_mesh.size.z) * drone_nav_mesh.chunk_size * 0.5f);
-						scorer.goal = drone_nav_mesh.vmin +
-						Vec3
-						(
-							mersenne::randf_co() * (drone_nav_mesh.size.x * drone_nav_mesh.chunk_size),
-							mersenne::randf_co() * (drone_nav_mesh.size.y * drone_nav_mesh.chunk_size),
-							mersenne::randf_co() * (drone_nav_mesh.size.z * drone_nav_mesh.chunk_size)
-						);
-
-						drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
-
-						break;
-					}
-					case DronePathfind::Away:
-					{
-						Vec3 away;
-						sync_in.read(&away);
-						Vec3 away_normal;
-						sync_in.read(&away_normal);
-						sync_in.unlock();
-
-						AwayScorer scorer;
-						scorer.mesh = &drone_nav_mesh;
-						scorer.start_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, start, start_normal);
-						scorer.away_vertex = drone_closest_point(drone_nav_mesh, nav_game_state, team, away, away_normal);
-						if (!scorer.away_vertex.equals(DRONE_NAV_MESH_NODE_NONE))
-						{
-							scorer.away_pos = away;
-							scorer.minimum_distance = rule == DroneAllow::Crawl ? DRONE_MAX_DISTANCE * 0.5f : DRONE_MAX_DISTANCE * 3.0f;
-							scorer.minimum_distance = vi_min(scorer.minimum_distance,
-								vi_min(drone_nav_mesh.size.x, drone_nav_mesh.size.z) * drone_nav_mesh.chunk_size * 0.5f);
-
-							drone_astar(ctx, rule, team, scorer.start_vertex, &scorer, &path);
-						}
-
 						break;
-					}
 					default:
 					{
 						vi_assert(false);
 						break;
 					}
 				}
-
-				sync_out.lock();
-				sync_out.write(Callback::DronePath);
-				sync_out.write(callback);
-				sync_out.write(path);
-				sync_out.unlock();
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::DroneClosestPoint:
 			{
-				LinkEntryArg<DronePathNode> callback;
-				sync_in.read(&callback);
-				AI::Team team;
-				sync_in.read(&team);
-				Vec3 search_pos;
-				sync_in.read(&search_pos);
-				sync_in.unlock();
-
-				DronePathNode result;
-				result.ref = drone_closest_point(drone_nav_mesh, nav_game_state, team, search_pos);
-				if (result.ref.equals(DRONE_NAV_MESH_NODE_NONE))
-				{
-					result.pos = search_pos;
-					result.normal = Vec3(0, 1, 0);
-				}
-				else
-				{
-					result.pos = drone_nav_mesh.chunks[result.ref.chunk].vertices[result.ref.vertex];
-					result.normal = drone_nav_mesh.chunks[result.ref.chunk].normals[result.ref.vertex];
-				}
-
-				sync_out.lock();
-				sync_out.write(Callback::DronePoint);
-				sync_out.write(callback);
-				sync_out.write(result);
-				sync_out.unlock();
+				Query query;
+				query.op = op;
+				sync_in.read(&query.callback);
+				sync_in.read(&query.team);
+				sync_in.read(&query.a);
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::DroneMarkAdjacencyBad:
@@ -1290,7 +1580,9 @@ void loop()
 				sync_in.read(&a);
 				DroneNavMeshNode b;
 				sync_in.read(&b);
-				sync_in.unlock();
+				sync_in.end_read();
+
+				pool_barrier();
 
 				// remove b from a's adjacency list
 				DroneNavMeshAdjacency* adjacency = &drone_nav_mesh.chunks[a.chunk].adjacency[a.vertex];
@@ -1307,44 +1599,41 @@ void loop()
 			}
 			case Op::UpdateState:
 			{
+				// read into a separate buffer so queries in flight can keep using the old state until the barrier
 				s32 count;
 				sync_in.read(&count);
-				nav_game_state.rectifiers.resize(count);
-				sync_in.read(nav_game_state.rectifiers.data, nav_game_state.rectifiers.length);
+				nav_game_state_next.rectifiers.resize(count);
+				sync_in.read(nav_game_state_next.rectifiers.data, nav_game_state_next.rectifiers.length);
 				sync_in.read(&count);
-				nav_game_state.force_fields.resize(count);
-				sync_in.read(nav_game_state.force_fields.data, nav_game_state.force_fields.length);
-				sync_in.unlock();
+				nav_game_state_next.force_fields.resize(count);
+				sync_in.read(nav_game_state_next.force_fields.data, nav_game_state_next.force_fields.length);
+				sync_in.end_read();
+
+				pool_barrier();
+
+				nav_game_state.rectifiers.resize(nav_game_state_next.rectifiers.length);
+				memcpy(nav_game_state.rectifiers.data, nav_game_state_next.rectifiers.data, sizeof(RectifierState) * nav_game_state.rectifiers.length);
+				nav_game_state.force_fields.resize(nav_game_state_next.force_fields.length);
+				memcpy(nav_game_state.force_fields.data, nav_game_state_next.force_fields.data, sizeof(ForceFieldState) * nav_game_state.force_fields.length);
 				break;
 			}
 			case Op::AudioPathfind:
 			{
-				Ref<AudioEntry> entry;
-				s8 listener;
-				Vec3 a;
-				Vec3 b;
-				r32 straight_distance;
-				sync_in.read(&entry);
-				sync_in.read(&listener);
-				sync_in.read(&a);
-				sync_in.read(&b);
-				sync_in.read(&straight_distance);
-				sync_in.unlock();
-
-				r32 path_length = audio_pathfind(ctx_audio, a, b);
-
-				sync_out.lock();
-				sync_out.write(Callback::AudioPath);
-				sync_out.write(entry);
-				sync_out.write(listener);
-				sync_out.write(path_length);
-				sync_out.write(straight_distance);
-				sync_out.unlock();
+				Query query;
+				query.op = op;
+				sync_in.read(&query.audio_entry);
+				sync_in.read(&query.listener);
+				sync_in.read(&query.a);
+				sync_in.read(&query.b);
+				sync_in.read(&query.value); // straight distance
+				sync_in.end_read();
+				pool_submit(query);
 				break;
 			}
 			case Op::Quit:
 			{
-				sync_in.unlock();
+				sync_in.end_read();
+				pool_barrier();
 				run = false;
 				break;
 			}
@@ -1352,10 +1641,22 @@ void loop()
 				vi_assert(false);
 				break;
 		}
+		vi_profile_end();
 #if DEBUG_DRONE || DEBUG_WALK || DEBUG_AUDIO
 		vi_debug("AI work queue usage: %.0f%%", 100.0f * (r32(sync_in.length()) / r32(sync_in.capacity())));
 #endif
 	}
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.quit = true;
+	}
+	pool.condition_work.notify_all();
+	for (s32 i = 0; i < pool_threads.length; i++)
+	{
+		pool_threads[i]->runner.join();
+		delete pool_threads[i];
+	}
 }
 
 // Drone nav mesh stuff
@@ -1372,10 +1673,17 @@ void DroneNavMeshKey::resize(const DroneNavMesh& nav)
 		data.chunks[i].resize(nav.chunks[i].vertices.length);
 }
 
+// starts a new search. node data is lazily cleared in get() the first time each node is touched,
+// so we only have to clear everything when the generation counter wraps around
 void DroneNavMeshKey::reset()
 {
-	for (s32 i = 0; i < data.chunks.length; i++)
-		memset(data.chunks[i].data, 0, sizeof(DroneNavMeshNodeData) * data.chunks[i].length);
+	generation++;
+	if (generation == 0)
+	{
+		for (s32 i = 0; i < data.chunks.length; i++)
+			memset(data.chunks[i].data, 0, sizeof(DroneNavMeshNodeData) * data.chunks[i].length);
+		generation = 1;
+	}
 }
 
 r32 DroneNavMeshKey::priority(const DroneNavMeshNode& a)
@@ -1386,8 +1694,113 @@ r32 DroneNavMeshKey::priority(const DroneNavMeshNode& a)
 
 DroneNavMeshNodeData& DroneNavMeshKey::get(const DroneNavMeshNode& node)
 {
-	return data.chunks[node.chunk][node.vertex];
+	DroneNavMeshNodeData& result = data.chunks[node.chunk][node.vertex];
+	if (result.generation != generation)
+	{
+		result = {};
+		result.generation = generation;
+	}
+	return result;
+}
+
+// goes through get() so a node left over from the previous search can't clobber the index afterward
+s32& DroneNavMeshKey::heap_index(const DroneNavMeshNode& node)
+{
+	return get(node).heap_index;
+}
+
+#if !RELEASE_BUILD
+// counts how many nodes A* pops off the queue
+struct BenchmarkScorer : PathfindScorer
+{
+	s32 expanded;
+
+	virtual b8 done(DroneNavMeshNode v, const DroneNavMeshNodeData& data)
+	{
+		expanded++;
+		return PathfindScorer::done(v, data);
+	}
+};
+
+// corner-to-corner searches across a synthetic single-chunk grid mesh with bumpy terrain and 8-way adjacency
+void benchmark_astar(s32 grid_size)
+{
+	grid_size = vi_max(2, vi_min(grid_size, 181)); // vertex indices are s16
+
+	DroneNavMesh* mesh = new DroneNavMesh();
+	mesh->vmin = Vec3::zero;
+	mesh->chunk_size = r32(grid_size);
+	mesh->size = { 1, 1, 1 };
+	mesh->resize();
+	DroneNavMeshChunk* chunk = &mesh->chunks[0];
+	s32 vertex_count = grid_size * grid_size;
+	chunk->vertices.resize(vertex_count);
+	chunk->normals.resize(vertex_count);
+	chunk->adjacency.resize(vertex_count);
+	for (s32 z = 0; z < grid_size; z++)
+	{
+		for (s32 x = 0; x < grid_size; x++)
+		{
+			s32 i = x + z * grid_size;
+			chunk->vertices[i] = Vec3(r32(x), mersenne::randf_co() * 2.0f, r32(z));
+			chunk->normals[i] = Vec3(0, 1, 0);
+			DroneNavMeshAdjacency* adjacency = &chunk->adjacency[i];
+			adjacency->flags = 0;
+			adjacency->neighbors.length = 0;
+			for (s32 dz = -1; dz <= 1; dz++)
+			{
+				for (s32 dx = -1; dx <= 1; dx++)
+				{
+					s32 nx = x + dx;
+					s32 nz = z + dz;
+					if ((dx != 0 || dz != 0) && nx >= 0 && nz >= 0 && nx < grid_size && nz < grid_size)
+					{
+						adjacency->flag(adjacency->neighbors.length, true);
+						adjacency->neighbors.add({ 0, s16(nx + nz * grid_size) });
+					}
+				}
+			}
+		}
+	}
+
+	DroneNavMeshKey* key = new DroneNavMeshKey();
+	key->resize(*mesh);
+	AstarQueue* queue = new AstarQueue(key);
+	queue->reserve(vertex_count);
+	NavGameState game_state = {};
+	DroneNavContext ctx =
+	{
+		*mesh,
+		key,
+		game_state,
+		queue,
+		0,
+	};
+
+	DroneNavMeshNode start = { 0, 0 };
+	BenchmarkScorer scorer;
+	scorer.end_vertex = { 0, s16(vertex_count - 1) };
+	scorer.end_pos = chunk->vertices[vertex_count - 1];
+
+	DronePath path;
+	const s32 iterations = 20;
+	for (s32 linear = 1; linear >= 0; linear--)
+	{
+		astar_linear_decrease_key = b8(linear);
+		scorer.expanded = 0;
+		r64 start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+			drone_astar(ctx, DroneAllow::All, 0, start, &scorer, &path);
+		r64 elapsed = platform::time() - start_time;
+		vi_debug("%s decrease-key: %d vertices, %d nodes expanded, %.2fms per search, %.1f nodes/ms", linear ? "linear" : "indexed", vertex_count, scorer.expanded / iterations, (elapsed * 1000.0) / r64(iterations), r64(scorer.expanded) / (elapsed * 1000.0));
+	}
+	astar_linear_decrease_key = false;
+
+	delete queue;
+	delete key;
+	delete mesh;
 }
+#endif
 
 
 }
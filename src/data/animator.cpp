@@ -4,6 +4,7 @@
 #include "ease.h"
 #include "mersenne/mersenne-twister.h"
 #include "render/skinned_model.h"
+#include "jobs.h"
 
 namespace VI
 {
@@ -320,22 +321,38 @@ void Animator::Layer::changed_animation()
 
 void Animator::update_server(const Update& u)
 {
-	for (s32 i = 0; i < MAX_ANIMATIONS; i++)
-		layers[i].update(u.time.delta, u.time.delta, *this);
+	layers_update(u.time.delta, u.time.delta);
 	update_world_transforms();
 }
 
 void Animator::update_client_only(const Update& u)
 {
-	for (s32 i = 0; i < MAX_ANIMATIONS; i++)
-		layers[i].update(0.0f, u.time.delta, *this);
+	layers_update(0.0f, u.time.delta);
 	update_world_transforms();
 }
 
+void Animator::layers_update(r32 dt, r32 dt_real)
+{
+	for (s32 i = 0; i < MAX_ANIMATIONS; i++)
+		layers[i].update(dt, dt_real, *this);
+}
+
 void Animator::update_world_transforms()
+{
+	const Armature* arm = pose_prepare();
+	if (arm)
+	{
+		pose_update(arm);
+		bindings_update();
+	}
+}
+
+// loads the armature and sizes the bone arrays. touches the asset system, so call it from the update thread
+// returns null if there's nothing to pose
+const Armature* Animator::pose_prepare()
 {
 	if (armature == AssetNull)
-		return;
+		return nullptr;
 
 	const Armature* arm = Loader::armature(armature);
 	if (armature != armature_last)
@@ -352,6 +369,14 @@ void Animator::update_world_transforms()
 		armature_last = armature;
 	}
 
+	return arm;
+}
+
+// only reads the layers and the armature and only writes bones, so different Animators can do this in parallel
+void Animator::pose_update(const Armature* arm)
+{
+	vi_assert(Jobs::writable(component_mask));
+
 	if (override_mode == OverrideMode::Override)
 	{
 		for (s32 i = 0; i < bones.length; i++)
@@ -429,7 +454,11 @@ void Animator::update_world_transforms()
 				bones[i] = bones[i] * bones[parent];
 		}
 	}
+}
 
+// moves bound Transforms to their bones
+void Animator::bindings_update()
+{
 	Mat4 transform;
 	get<Transform>()->mat(&transform);
 	for (s32 i = 0; i < bindings.length; i++)
@@ -93,9 +93,13 @@ struct Animator : public ComponentType<Animator>
 
 	void update_server(const Update&);
 	void update_client_only(const Update&);
+	void layers_update(r32, r32);
 	void bind(const s32, Transform*);
 	void unbind(const Transform*);
 	void update_world_transforms();
+	const Armature* pose_prepare();
+	void pose_update(const Armature*);
+	void bindings_update();
 	void bone_transform(const s32, Vec3*, Quat* = nullptr);
 	void to_local(const s32, Vec3*, Quat* = nullptr);
 	void to_world(const s32, Vec3*, Quat* = nullptr);
@@ -6,8 +6,24 @@
 namespace VI
 {
 
+thread_local s32 Transform::cache_scope_depth;
+u32 Transform::cache_generation;
+
+Transform::CacheScope::CacheScope()
+{
+	if (cache_scope_depth == 0)
+		cache_update();
+	cache_scope_depth++;
+}
+
+Transform::CacheScope::~CacheScope()
+{
+	cache_scope_depth--;
+	vi_assert(cache_scope_depth >= 0);
+}
+
 Transform::Transform()
-	: parent(), pos(Vec3::zero), rot(Quat::identity)
+	: parent(), pos(Vec3::zero), rot(Quat::identity), cache_pos(Vec3::zero), cache_rot(Quat::identity), cache_stamp()
 {
 
 }
@@ -46,8 +62,52 @@ void Transform::set(const Vec3& p, const Quat& r)
 	rot = r;
 }
 
+// parent first, so every Transform is one step on top of a finished parent
+void Transform::cache_compute()
+{
+	Transform* p = parent.ref();
+	if (p)
+	{
+		if (p->cache_stamp != cache_generation)
+			p->cache_compute();
+		cache_rot = p->cache_rot * rot;
+		cache_pos = (p->cache_rot * pos) + p->cache_pos;
+	}
+	else
+	{
+		cache_rot = rot;
+		cache_pos = pos;
+	}
+	cache_stamp = cache_generation;
+}
+
+void Transform::cache_update()
+{
+	cache_generation++;
+	if (cache_generation == 0)
+	{
+		// wrapped around; make sure nothing looks current by accident
+		for (auto i = list.iterator(); !i.is_last(); i.next())
+			i.item()->cache_stamp = 0;
+		cache_generation = 1;
+	}
+
+	for (auto i = list.iterator(); !i.is_last(); i.next())
+	{
+		if (i.item()->cache_stamp != cache_generation)
+			i.item()->cache_compute();
+	}
+}
+
 void Transform::absolute(Vec3* abs_pos, Quat* abs_rot) const
 {
+	if (cached())
+	{
+		*abs_pos = cache_pos;
+		*abs_rot = cache_rot;
+		return;
+	}
+
 	*abs_rot = Quat::identity;
 	*abs_pos = Vec3::zero;
 	const Transform* t = this;
@@ -79,6 +139,9 @@ void Transform::absolute(const Vec3& abs_pos, const Quat& abs_rot)
 
 Quat Transform::absolute_rot() const
 {
+	if (cached())
+		return cache_rot;
+
 	Quat q = Quat::identity;
 	const Transform* t = this;
 	while (t)
@@ -99,6 +162,9 @@ void Transform::absolute_rot(const Quat& q)
 
 Vec3 Transform::absolute_pos() const
 {
+	if (cached())
+		return cache_pos;
+
 	Vec3 abs_pos = Vec3::zero;
 	const Transform* t = this;
 	while (t)
@@ -119,6 +185,9 @@ void Transform::absolute_pos(const Vec3& p)
 
 Vec3 Transform::to_world(const Vec3& p) const
 {
+	if (cached())
+		return (cache_rot * p) + cache_pos;
+
 	Vec3 abs_pos = p;
 	const Transform* t = this;
 	while (t)
@@ -150,6 +219,13 @@ Vec3 Transform::to_local_normal(const Vec3& p) const
 
 void Transform::to_world(Vec3* p, Quat* q) const
 {
+	if (cached())
+	{
+		*q = cache_rot * *q;
+		*p = (cache_rot * *p) + cache_pos;
+		return;
+	}
+
 	const Transform* t = this;
 	while (t)
 	{ 
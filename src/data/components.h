@@ -9,9 +9,27 @@ namespace VI
 
 struct Transform : public ComponentType<Transform>
 {
+	// for passes where nothing moves, like drawing or building a state frame.
+	// opening the outermost scope computes every absolute transform once, parents before children;
+	// until it closes, the accessors below just read the result.
+	// nothing may write a Transform while a scope is open. scopes only affect the thread that opens them,
+	// and only one thread at a time may have one open
+	struct CacheScope
+	{
+		CacheScope();
+		~CacheScope();
+	};
+
+	static thread_local s32 cache_scope_depth;
+	static u32 cache_generation;
+	static void cache_update();
+
 	Ref<Transform> parent;
 	Vec3 pos;
 	Quat rot;
+	Vec3 cache_pos; // absolute, as of cache_stamp
+	Quat cache_rot;
+	u32 cache_stamp; // cache_generation when cache_pos and cache_rot were computed
 
 	Transform();
 
@@ -33,6 +51,11 @@ struct Transform : public ComponentType<Transform>
 
 	void absolute(Vec3*, Quat*) const;
 	void absolute(const Vec3&, const Quat&);
+	void cache_compute();
+	inline b8 cached() const
+	{
+		return cache_scope_depth > 0 && cache_stamp == cache_generation; // created since the scope opened, otherwise
+	}
 	Vec3 absolute_pos() const;
 	void absolute_pos(const Vec3&);
 	Quat absolute_rot() const;
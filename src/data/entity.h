@@ -430,4 +430,70 @@ template<typename T> PinArray<T, MAX_ENTITIES> ComponentType<T>::list;
 template<typename T> ComponentPool<T> ComponentType<T>::pool;
 #endif
 
+template<typename... Ts> struct ComponentMaskOf;
+
+template<> struct ComponentMaskOf<>
+{
+	static inline ComponentMask get()
+	{
+		return 0;
+	}
+};
+
+template<typename T, typename... Ts> struct ComponentMaskOf<T, Ts...>
+{
+	static inline ComponentMask get()
+	{
+		return T::component_mask | ComponentMaskOf<Ts...>::get();
+	}
+};
+
+// iterates every T whose entity also has all of the Others
+// only T's slots are scanned, so put the rarest component first
+// for (auto i = Join<Shield, Target, Transform>::iterator(); !i.is_last(); i.next())
+template<typename T, typename... Others> struct Join
+{
+	ComponentMask mask;
+	ID index;
+
+	static Join iterator()
+	{
+		Join i;
+		i.mask = ComponentMaskOf<Others...>::get();
+		i.index = T::list.mask.start;
+		if (!i.is_last() && !i.match())
+			i.next();
+		return i;
+	}
+
+	inline b8 match() const
+	{
+		return (Entity::list[T::list[index].entity_id].component_mask & mask) == mask;
+	}
+
+	inline b8 is_last() const
+	{
+		return index >= T::list.mask.end;
+	}
+
+	inline void next()
+	{
+		do
+		{
+			index = ID(T::list.mask.next(index));
+		} while (!is_last() && !match());
+	}
+
+	inline T* item() const
+	{
+		vi_assert(!is_last() && T::list.active(index));
+		return &T::list[index];
+	}
+
+	template<typename T2> inline T2* get() const
+	{
+		return item()->template get<T2>();
+	}
+};
+
 }
@@ -1,7 +1,19 @@
 #include "json.h"
 #include "cjson/cJSON.h"
 #include "vi_assert.h"
+#include "array.h"
+#include "assimp/contrib/zlib/zlib.h"
 #include <stdio.h>
+#include <string.h>
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace VI
 {
@@ -51,10 +63,306 @@ void save(cJSON* json, const char* path)
 	free(data);
 }
 
+const void* map_file(const char* path, size_t* size)
+{
+#if _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+		return nullptr;
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping); // the view keeps it alive
+	*size = size_t(file_size.QuadPart);
+	return data;
+#else
+	s32 fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return nullptr;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size == 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps it alive
+	if (data == MAP_FAILED)
+		return nullptr;
+	*size = size_t(st.st_size);
+	return data;
+#endif
+}
+
+void unmap_file(const void* data, size_t size)
+{
+#if _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+}
+
+// size and CRC32 of the source file, for checking blobs against it
+b8 file_stamp(const char* path, u32* size, u32* crc)
+{
+	size_t length;
+	const void* data = map_file(path, &length);
+	if (!data)
+		return false;
+	*size = u32(length);
+	*crc = u32(crc32(0, (const Bytef*)data, uInt(length)));
+	unmap_file(data, length);
+	return true;
+}
+
+#define JSON_BLOB_OPEN_MAX 8
+
+struct Blob
+{
+	cJSON* root; // all the nodes live in one allocation starting here
+	const void* data;
+	size_t size;
+};
+
+StaticArray<Blob, JSON_BLOB_OPEN_MAX> blobs_open;
+
 void json_free(cJSON* json)
 {
-	if (json)
-		cJSON_Delete(json);
+	if (!json)
+		return;
+
+	for (s32 i = 0; i < blobs_open.length; i++)
+	{
+		const Blob& blob = blobs_open[i];
+		if (blob.root == json)
+		{
+			free(blob.root);
+			unmap_file(blob.data, blob.size);
+			blobs_open.remove(i);
+			return;
+		}
+	}
+
+	cJSON_Delete(json);
+}
+
+// string interning for blob_save
+struct BlobWriter
+{
+	Array<BlobNode> nodes;
+	Array<char> strings;
+	Array<u32> table; // open addressing; string offset + 1, or 0 if empty
+	s32 table_count;
+
+	static u32 hash(const char* s)
+	{
+		// fnv-1a
+		u32 h = 2166136261u;
+		while (*s)
+		{
+			h ^= u8(*s);
+			h *= 16777619u;
+			s++;
+		}
+		return h;
+	}
+
+	void table_insert(u32 offset)
+	{
+		u32 mask = u32(table.length - 1);
+		u32 i = hash(&strings[offset]) & mask;
+		while (table[i])
+			i = (i + 1) & mask;
+		table[i] = offset + 1;
+	}
+
+	u32 intern(const char* s)
+	{
+		if (!s)
+			return JSON_BLOB_NULL;
+
+		if ((table_count + 1) * 2 > table.length)
+		{
+			// grow and rehash
+			s32 capacity = vi_max(1024, table.length * 2);
+			Array<u32> old;
+			old.resize(table.length);
+			if (table.length > 0)
+				memcpy(old.data, table.data, sizeof(u32) * table.length);
+			table.resize(capacity);
+			memset(table.data, 0, sizeof(u32) * capacity);
+			for (s32 i = 0; i < old.length; i++)
+			{
+				if (old[i])
+					table_insert(old[i] - 1);
+			}
+		}
+
+		u32 mask = u32(table.length - 1);
+		u32 i = hash(s) & mask;
+		while (table[i])
+		{
+			if (strcmp(&strings[table[i] - 1], s) == 0)
+				return table[i] - 1;
+			i = (i + 1) & mask;
+		}
+
+		u32 offset = u32(strings.length);
+		s32 length = s32(strlen(s)) + 1;
+		strings.resize(strings.length + length);
+		memcpy(&strings[offset], s, length);
+		table[i] = offset + 1;
+		table_count++;
+		return offset;
+	}
+
+	// nodes go in document order, so a node's children always come after it
+	s32 add(const cJSON* json)
+	{
+		s32 index = nodes.length;
+		{
+			BlobNode* node = nodes.add();
+			node->next = -1;
+			node->child = -1;
+			node->type = json->type & 0xff; // no reference flags; nothing in a blob is owned separately
+			node->value_int = json->valueint;
+			node->value_double = json->valuedouble;
+		}
+		nodes[index].name = intern(json->string);
+		nodes[index].value_string = intern(json->valuestring);
+
+		s32 last = -1;
+		for (const cJSON* child = json->child; child; child = child->next)
+		{
+			s32 child_index = add(child);
+			if (last == -1)
+				nodes[index].child = child_index;
+			else
+				nodes[last].next = child_index;
+			last = child_index;
+		}
+		return index;
+	}
+};
+
+b8 blob_save(const cJSON* json, const char* path, const char* source_path)
+{
+	BlobHeader header;
+	if (!file_stamp(source_path, &header.source_size, &header.source_crc32))
+	{
+		fprintf(stderr, "Can't read file '%s'\n", source_path);
+		return false;
+	}
+
+	BlobWriter writer;
+	writer.table_count = 0;
+	writer.add(json);
+
+	FILE* f = fopen(path, "wb");
+	if (!f)
+	{
+		fprintf(stderr, "Can't open file '%s'\n", path);
+		return false;
+	}
+
+	header.magic = JSON_BLOB_MAGIC;
+	header.version = JSON_BLOB_VERSION;
+	header.node_count = u32(writer.nodes.length);
+	header.string_bytes = u32(writer.strings.length);
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(writer.nodes.data, sizeof(BlobNode), writer.nodes.length, f);
+	fwrite(writer.strings.data, sizeof(char), writer.strings.length, f);
+	fclose(f);
+	return true;
+}
+
+// returns null if the file is missing, stale, or doesn't look right, so the caller can fall back to the json at source_path
+cJSON* blob_load(const char* path, const char* source_path)
+{
+	if (blobs_open.length == blobs_open.capacity())
+	{
+		fprintf(stderr, "Can't load json blob '%s': %d blobs already open\n", path, JSON_BLOB_OPEN_MAX);
+		return nullptr;
+	}
+
+	size_t size;
+	const void* data = map_file(path, &size);
+	if (!data)
+		return nullptr;
+
+	const BlobHeader* header = (const BlobHeader*)data;
+	if (size < sizeof(BlobHeader)
+		|| header->magic != JSON_BLOB_MAGIC
+		|| header->version != JSON_BLOB_VERSION
+		|| header->node_count == 0
+		|| size != sizeof(BlobHeader) + size_t(header->node_count) * sizeof(BlobNode) + size_t(header->string_bytes)
+		|| (header->string_bytes > 0 && ((const char*)data)[size - 1] != '\0'))
+	{
+		fprintf(stderr, "Invalid json blob '%s'\n", path);
+		unmap_file(data, size);
+		return nullptr;
+	}
+
+	{
+		u32 source_size;
+		u32 source_crc32;
+		if (file_stamp(source_path, &source_size, &source_crc32)
+			&& (source_size != header->source_size || source_crc32 != header->source_crc32))
+		{
+			fprintf(stderr, "Json blob '%s' is out of date with '%s'\n", path, source_path);
+			unmap_file(data, size);
+			return nullptr;
+		}
+	}
+
+	const BlobNode* in = (const BlobNode*)(header + 1);
+	char* strings = (char*)(in + header->node_count); // cJSON isn't const-correct; nobody writes to these
+	s32 count = s32(header->node_count);
+
+	cJSON* nodes = (cJSON*)calloc(count, sizeof(cJSON));
+	for (s32 i = 0; i < count; i++)
+	{
+		const BlobNode& node = in[i];
+		if ((node.next != -1 && (node.next <= i || node.next >= count))
+			|| (node.child != -1 && (node.child <= i || node.child >= count))
+			|| (node.name != JSON_BLOB_NULL && node.name >= header->string_bytes)
+			|| (node.value_string != JSON_BLOB_NULL && node.value_string >= header->string_bytes))
+		{
+			fprintf(stderr, "Invalid json blob '%s'\n", path);
+			free(nodes);
+			unmap_file(data, size);
+			return nullptr;
+		}
+
+		cJSON* out = &nodes[i];
+		out->type = node.type;
+		out->valueint = node.value_int;
+		out->valuedouble = node.value_double;
+		out->string = node.name == JSON_BLOB_NULL ? nullptr : &strings[node.name];
+		out->valuestring = node.value_string == JSON_BLOB_NULL ? nullptr : &strings[node.value_string];
+		if (node.child != -1)
+			out->child = &nodes[node.child];
+		if (node.next != -1)
+		{
+			out->next = &nodes[node.next];
+			nodes[node.next].prev = out;
+		}
+	}
+
+	Blob* blob = blobs_open.add();
+	blob->root = nodes;
+	blob->data = data;
+	blob->size = size;
+	return nodes;
 }
 
 Vec3 get_vec3(cJSON* parent, const char* key, const Vec3& default_value)
@@ -21,6 +21,39 @@ namespace Json
 	s64 get_s64(cJSON*, const char*, const s64 = 0);
 	const char* get_string(cJSON*, const char*, const char* = 0);
 	s32 get_enum(cJSON*, const char*, const char**, const s32 = 0);
+
+	// precompiled version of a json file: a flat table of nodes in document order plus interned strings.
+	// loading one is an mmap and a single allocation; no parsing, and strings point straight into the mapping.
+	// native byte order, so build it on the platform that reads it. free it with json_free like any other tree.
+	// the header records the size and CRC32 of the json it came from; if those don't match, the blob is stale.
+	// keyed on content rather than timestamps, since installers and copies don't reliably keep mtimes
+	#define JSON_BLOB_MAGIC 0x424c564c // "LVLB"
+	#define JSON_BLOB_VERSION 3
+	#define JSON_BLOB_NULL u32(-1)
+
+	struct BlobHeader
+	{
+		u32 magic;
+		u32 version;
+		u32 node_count;
+		u32 string_bytes;
+		u32 source_size;
+		u32 source_crc32;
+	};
+
+	struct BlobNode
+	{
+		s32 next; // node index, or -1
+		s32 child;
+		u32 name; // offset into the string table, or JSON_BLOB_NULL
+		u32 value_string;
+		s32 type;
+		s32 value_int;
+		r64 value_double;
+	};
+
+	b8 blob_save(const cJSON*, const char*, const char*);
+	cJSON* blob_load(const char*, const char*);
 };
 
 
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "array.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace VI
 {
@@ -19,13 +22,61 @@ namespace BitUtility
 		const u32 e = d + (d >> 16);
 		const u32 result = e & 0x0000003f;
 		return result;
+#endif // #ifdef __GNUC__
+	}
+
+	static inline u32 popcount64(u64 x)
+	{
+#ifdef __GNUC__
+		return __builtin_popcountll(x);
+#else // #ifdef __GNUC__
+		return popcount(u32(x)) + popcount(u32(x >> 32));
+#endif // #ifdef __GNUC__
+	}
+
+	// index of the lowest set bit. x must be non-zero
+	static inline s32 ctz(u64 x)
+	{
+#ifdef __GNUC__
+		return __builtin_ctzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+		unsigned long result;
+		_BitScanForward64(&result, x);
+		return s32(result);
+#else // #ifdef __GNUC__
+		s32 result = 0;
+		while (!(x & 1))
+		{
+			x >>= 1;
+			result++;
+		}
+		return result;
+#endif // #ifdef __GNUC__
+	}
+
+	// index of the highest set bit. x must be non-zero
+	static inline s32 msb(u64 x)
+	{
+#ifdef __GNUC__
+		return 63 - __builtin_clzll(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+		unsigned long result;
+		_BitScanReverse64(&result, x);
+		return s32(result);
+#else // #ifdef __GNUC__
+		s32 result = 0;
+		while (x >>= 1)
+			result++;
+		return result;
 #endif // #ifdef __GNUC__
 	}
 }
 
+#define BITMASK_WORD_BITS s32(sizeof(u64) * 8)
+
 template<s16 size> struct Bitmask
 {
-	u32 data[(size / (sizeof(u32) * 8)) + (size % (sizeof(u32) * 8) == 0 ? 0 : 1)];
+	u64 data[(size / BITMASK_WORD_BITS) + (size % BITMASK_WORD_BITS == 0 ? 0 : 1)];
 	s16 start;
 	s16 end;
 
@@ -37,8 +88,7 @@ template<s16 size> struct Bitmask
 	inline b8 get(s32 i) const
 	{
 		vi_assert(i >= 0 && i < size);
-		s32 index = i / (sizeof(u32) * 8);
-		return data[index] & (1 << (i - (index * sizeof(u32) * 8)));
+		return (data[i / BITMASK_WORD_BITS] >> (i % BITMASK_WORD_BITS)) & 1;
 	}
 
 	inline b8 any() const
@@ -51,38 +101,52 @@ template<s16 size> struct Bitmask
 		if (start < end)
 		{
 			s32 total = 0;
-			s32 start_index = start / (sizeof(u32) * 8);
-			s32 end_index = ((end - 1) / (sizeof(u32) * 8)) + 1;
+			s32 start_index = start / BITMASK_WORD_BITS;
+			s32 end_index = ((end - 1) / BITMASK_WORD_BITS) + 1;
 			for (s32 i = start_index; i < end_index; i++)
-				total += BitUtility::popcount(data[i]);
+				total += BitUtility::popcount64(data[i]);
 			return total;
 		}
 		else
 			return 0;
 	}
 
+	// first set bit after i, or end if there isn't one
 	inline s32 next(s32 i) const
 	{
 		i++;
-		while (i < end)
+		if (i >= end)
+			return i;
+		s32 index = i / BITMASK_WORD_BITS;
+		u64 word = data[index] & (~u64(0) << (i % BITMASK_WORD_BITS));
+		s32 end_index = (end - 1) / BITMASK_WORD_BITS;
+		while (!word)
 		{
-			if (get(i))
-				break;
-			i++;
+			index++;
+			if (index > end_index)
+				return end;
+			word = data[index];
 		}
-		return i;
+		return index * BITMASK_WORD_BITS + BitUtility::ctz(word);
 	}
 
+	// last set bit before i, or start - 1 if there isn't one
 	inline s32 prev(s32 i) const
 	{
 		i--;
-		while (i >= start)
+		if (i < start)
+			return i;
+		s32 index = i / BITMASK_WORD_BITS;
+		u64 word = data[index] & (~u64(0) >> ((BITMASK_WORD_BITS - 1) - (i % BITMASK_WORD_BITS)));
+		s32 start_index = start / BITMASK_WORD_BITS;
+		while (!word)
 		{
-			if (get(i))
-				break;
-			i--;
+			index--;
+			if (index < start_index)
+				return start - 1;
+			word = data[index];
 		}
-		return i;
+		return index * BITMASK_WORD_BITS + BitUtility::msb(word);
 	}
 
 	void clear()
@@ -95,8 +159,8 @@ template<s16 size> struct Bitmask
 	void set(s32 i, b8 value)
 	{
 		vi_assert(i >= 0 && i < size);
-		s32 index = i / (sizeof(u32) * 8);
-		u32 mask = 1 << (i - (index * sizeof(u32) * 8));
+		s32 index = i / BITMASK_WORD_BITS;
+		u64 mask = u64(1) << (i % BITMASK_WORD_BITS);
 		if (value)
 		{
 			data[index] |= mask;
@@ -106,51 +170,45 @@ template<s16 size> struct Bitmask
 		else
 		{
 			data[index] &= ~mask;
-
-			if (i + 1 == end)
-			{
-				s32 j;
-				for (j = i - 1; j > start; j--)
-				{
-					if (get(j))
-						break;
-				}
-				end = s16(j + 1);
-			}
-			if (i == start)
-			{
-				s32 j;
-				for (j = i + 1; j < end; j++)
-				{
-					if (get(j))
-						break;
-				}
-				start = s16(j);
-			}
-			if (start >= end)
-			{
-				start = size;
-				end = 0;
-			}
+			if (i + 1 == end || i == start)
+				bounds_shrink();
 		}
 	}
 
 	void add(const Bitmask<size>& other)
 	{
+		if (!other.any())
+			return;
 		start = vi_min(start, other.start);
 		end = vi_max(end, other.end);
-		s32 start_index = start / (sizeof(u32) * 8);
-		s32 end_index = ((end - 1) / (sizeof(u32) * 8)) + 1;
+		s32 start_index = start / BITMASK_WORD_BITS;
+		s32 end_index = ((end - 1) / BITMASK_WORD_BITS) + 1;
 		for (s32 i = start_index; i < end_index; i++)
 			data[i] |= other.data[i];
 	}
 
 	void subtract(const Bitmask<size>& other)
 	{
-		for (s32 i = other.start; i < other.end; i++)
+		if (!any() || !other.any())
+			return;
+		s32 start_index = vi_max(start, other.start) / BITMASK_WORD_BITS;
+		s32 end_index = ((vi_min(end, other.end) - 1) / BITMASK_WORD_BITS) + 1;
+		for (s32 i = start_index; i < end_index; i++)
+			data[i] &= ~other.data[i];
+		bounds_shrink();
+	}
+
+	// pull start and end in after bits have been cleared
+	void bounds_shrink()
+	{
+		if (start < end && !get(start))
+			start = s16(next(start));
+		if (start < end && !get(end - 1))
+			end = s16(prev(end - 1) + 1);
+		if (start >= end)
 		{
-			if (other.get(i))
-				set(i, false);
+			start = size;
+			end = 0;
 		}
 	}
 };
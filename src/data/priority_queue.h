@@ -7,9 +7,26 @@ namespace VI
 {
 
 
+// in indexed mode, the key tracks where each entry lives in the heap via s32& Key::heap_index(const T&)
+// this makes update_entry() O(log n) rather than requiring a linear search for the entry
+template<typename T, typename Key, b8 Indexed> struct PriorityQueueIndex
+{
+	static inline void set(Key*, const T&, s32) { }
+};
+
+template<typename T, typename Key> struct PriorityQueueIndex<T, Key, true>
+{
+	static inline void set(Key* key, const T& entry, s32 index)
+	{
+		key->heap_index(entry) = index;
+	}
+};
+
 // adapted from https://github.com/pcioni/PriorityQueue
-template<typename T, typename Key> struct PriorityQueue
+template<typename T, typename Key, b8 Indexed = false> struct PriorityQueue
 {
+	typedef PriorityQueueIndex<T, Key, Indexed> Index;
+
 	Array<T> heap;
 	Key* key;
 
@@ -25,6 +42,8 @@ private:
 		T temp = heap[pos_a];
 		heap[pos_a] = heap[pos_b];
 		heap[pos_b] = temp;
+		Index::set(key, heap[pos_a], pos_a);
+		Index::set(key, heap[pos_b], pos_b);
 	}
 	
 	void percolate_up(s32 position)
@@ -80,6 +99,7 @@ public:
 	void push(const T& entry)
 	{
 		heap.add(entry);
+		Index::set(key, entry, heap.length - 1);
 		percolate_up(heap.length - 1);
 	}
 
@@ -89,12 +109,23 @@ public:
 		percolate_down(index);
 	}
 
+	// indexed mode only
+	void update_entry(const T& entry)
+	{
+		vi_assert(Indexed);
+		s32 index = key->heap_index(entry);
+		vi_assert(index >= 0 && index < heap.length);
+		update(index);
+	}
+
 	void remove(s32 index)
 	{
 		vi_assert(index < heap.length);
+		Index::set(key, heap[index], -1);
 		if (index < heap.length - 1)
 		{
 			heap[index] = heap[heap.length - 1];
+			Index::set(key, heap[index], index);
 			heap.length--;
 			percolate_up(index);
 			percolate_down(index);
@@ -117,12 +148,16 @@ public:
 	{
 		vi_assert(heap.length > 0);
 		T result = heap[0];
+		Index::set(key, result, -1);
 		if (heap.length > 1)
 		{
 			heap[0] = heap[heap.length - 1];
+			heap.length--;
+			Index::set(key, heap[0], 0);
 			percolate_down(0);
 		}
-		heap.length--;
+		else
+			heap.length--;
 		return result;
 	}
 };
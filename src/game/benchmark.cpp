@@ -0,0 +1,235 @@
+#include "benchmark.h"
+#include "game.h"
+#include "team.h"
+#include "data/components.h"
+#include "entities.h"
+#include "minion.h"
+#include "ai_player.h"
+#include "player.h"
+#include "load.h"
+#include "common.h"
+#include "net.h"
+#include "mersenne/mersenne-twister.h"
+#include "platform/util.h"
+#include "cjson/cJSON.h"
+#include "data/json.h"
+#include <cstdlib>
+
+namespace VI
+{
+
+namespace Benchmark
+{
+
+b8 active;
+Config config;
+
+// log2 buckets of microseconds; the last one catches everything over ~0.5 seconds
+#define HISTOGRAM_BUCKETS 20
+
+struct Samples
+{
+	Array<r32> values; // microseconds, one per tick
+	r64 current; // accumulated over the current tick
+};
+
+Samples samples[s32(Subsystem::count)];
+r64 start_time;
+s32 minion_count;
+
+const char* subsystem_names[s32(Subsystem::count)] =
+{
+	"tick",
+	"net",
+	"ai",
+	"team",
+	"simulation",
+	"world",
+	"physics",
+};
+
+Timer::Timer(Subsystem s)
+	: start(active ? platform::time() : 0.0), subsystem(s)
+{
+}
+
+Timer::~Timer()
+{
+	if (active)
+		record(subsystem, platform::time() - start);
+}
+
+void record(Subsystem s, r64 time)
+{
+	samples[s32(s)].current += time;
+}
+
+// load the level, fill it with bots and minions, and start the match immediately
+b8 start()
+{
+	AssetID level = Loader::find_level(config.level);
+	if (level == AssetNull)
+	{
+		fprintf(stderr, "Unknown level '%s'\n", config.level);
+		return false;
+	}
+
+	Game::session.reset(SessionType::Multiplayer);
+	Game::session.config.id = 1; // anything but story mode
+	Game::session.config.time_limit_parkour_ready = 0;
+	Game::load_level(level, Game::Mode::Pvp);
+
+	for (s32 i = 0; i < config.bots; i++)
+	{
+		Entity* e = World::create<ContainerEntity>();
+		char username[MAX_USERNAME + 1] = {};
+		snprintf(username, MAX_USERNAME, "Bot %03d", i);
+		Team* team = Team::with_least_players();
+		vi_assert(team);
+		AI::Config ai_config = PlayerAI::generate_config(team->team(), 0.0f);
+		PlayerManager* manager = e->add<PlayerManager>(team, username);
+		PlayerAI* player = PlayerAI::list.add();
+		new (player) PlayerAI(manager, ai_config);
+		Net::finalize(e);
+	}
+
+	// spread minions around each team's spawn points
+	minion_count = 0;
+	if (SpawnPoint::list.count() > 0)
+	{
+		while (minion_count < MAX_MINIONS)
+		{
+			s32 spawned = 0;
+			for (auto i = SpawnPoint::list.iterator(); !i.is_last() && minion_count < MAX_MINIONS; i.next())
+			{
+				if (i.item()->team == AI::TeamNone)
+					continue;
+				Vec3 pos;
+				Quat rot;
+				i.item()->get<Transform>()->absolute(&pos, &rot);
+				r32 angle = mersenne::randf_co() * PI * 2.0f;
+				r32 distance = 2.0f + mersenne::randf_co() * 4.0f;
+				pos += Vec3(cosf(angle) * distance, -1.0f, sinf(angle) * distance);
+				Net::finalize(World::create<MinionEntity>(pos, rot, i.item()->team, nullptr));
+				minion_count++;
+				spawned++;
+			}
+			if (spawned == 0) // no team spawn points
+				break;
+		}
+	}
+
+	Team::match_start();
+
+	for (s32 i = 0; i < s32(Subsystem::count); i++)
+	{
+		samples[i].values.length = 0;
+		samples[i].values.reserve(config.ticks);
+		samples[i].current = 0.0;
+	}
+	start_time = platform::time();
+
+	return true;
+}
+
+s32 compare_r32(const void* a, const void* b)
+{
+	r32 x = *(const r32*)a;
+	r32 y = *(const r32*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+cJSON* subsystem_json(Samples* s)
+{
+	cJSON* json = cJSON_CreateObject();
+
+	s32 histogram[HISTOGRAM_BUCKETS] = {};
+	r64 total = 0.0;
+	for (s32 i = 0; i < s->values.length; i++)
+	{
+		r32 us = s->values[i];
+		total += us;
+		s32 bucket = 0;
+		while (bucket < HISTOGRAM_BUCKETS - 1 && us >= r32(1 << bucket))
+			bucket++;
+		histogram[bucket]++;
+	}
+
+	qsort(s->values.data, s->values.length, sizeof(r32), compare_r32);
+
+	s32 count = s->values.length;
+	cJSON_AddNumberToObject(json, "total_ms", total / 1000.0);
+	cJSON_AddNumberToObject(json, "mean_us", count > 0 ? total / r64(count) : 0.0);
+	cJSON_AddNumberToObject(json, "min_us", count > 0 ? s->values[0] : 0.0f);
+	cJSON_AddNumberToObject(json, "p50_us", count > 0 ? s->values[(count * 50) / 100] : 0.0f);
+	cJSON_AddNumberToObject(json, "p90_us", count > 0 ? s->values[(count * 90) / 100] : 0.0f);
+	cJSON_AddNumberToObject(json, "p99_us", count > 0 ? s->values[(count * 99) / 100] : 0.0f);
+	cJSON_AddNumberToObject(json, "max_us", count > 0 ? s->values[count - 1] : 0.0f);
+
+	// each bucket counts ticks under "lt_us" microseconds, and at least the previous bucket's limit
+	cJSON* buckets = cJSON_CreateArray();
+	for (s32 i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		if (histogram[i] > 0)
+		{
+			cJSON* bucket = cJSON_CreateObject();
+			if (i < HISTOGRAM_BUCKETS - 1)
+				cJSON_AddNumberToObject(bucket, "lt_us", r64(1 << i));
+			cJSON_AddNumberToObject(bucket, "count", histogram[i]);
+			cJSON_AddItemToArray(buckets, bucket);
+		}
+	}
+	cJSON_AddItemToObject(json, "histogram", buckets);
+
+	return json;
+}
+
+void finish()
+{
+	r64 wall_time = platform::time() - start_time;
+
+	cJSON* json = cJSON_CreateObject();
+	cJSON_AddStringToObject(json, "level", config.level);
+	cJSON_AddNumberToObject(json, "bots", PlayerAI::list.count());
+	cJSON_AddNumberToObject(json, "minions", minion_count);
+	cJSON_AddNumberToObject(json, "ticks", config.ticks);
+	cJSON_AddNumberToObject(json, "seed", config.seed);
+	cJSON_AddNumberToObject(json, "wall_time_s", wall_time);
+
+	cJSON* subsystems = cJSON_CreateObject();
+	for (s32 i = 0; i < s32(Subsystem::count); i++)
+		cJSON_AddItemToObject(subsystems, subsystem_names[i], subsystem_json(&samples[i]));
+	cJSON_AddItemToObject(json, "subsystems", subsystems);
+
+	if (config.output)
+		Json::save(json, config.output);
+	else
+	{
+		char* data = cJSON_Print(json);
+		printf("%s\n", data);
+		free(data);
+	}
+	Json::json_free(json);
+}
+
+// call once at the end of every tick. returns true once the benchmark is over
+b8 tick_done()
+{
+	for (s32 i = 0; i < s32(Subsystem::count); i++)
+	{
+		Samples* s = &samples[i];
+		s->values.add(r32(s->current * 1000000.0));
+		s->current = 0.0;
+	}
+
+	if (samples[0].values.length >= config.ticks)
+	{
+		finish();
+		return true;
+	}
+	return false;
+}
+
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "types.h"
+
+namespace VI
+{
+
+// headless bot match for measuring server tick cost
+// runs a fixed number of ticks as fast as possible with a fixed seed and timestep, then dumps timing histograms as json
+namespace Benchmark
+{
+	enum class Subsystem : s8
+	{
+		Tick, // entire Game::update plus physics handoff
+		Net, // Net::update_start and Net::update_end, including Server::tick
+		AI, // AI::update, including waiting for pathfinding results
+		Team, // Team::update_all
+		Simulation, // everything that only runs when the game is unpaused
+		World, // World::flush
+		Physics, // waiting for the physics thread
+		count,
+	};
+
+	struct Config
+	{
+		const char* level;
+		const char* output; // null = stdout
+		s32 bots;
+		s32 ticks;
+		u32 seed;
+	};
+
+	extern b8 active;
+	extern Config config;
+
+	struct Timer
+	{
+		r64 start;
+		Subsystem subsystem;
+		Timer(Subsystem);
+		~Timer();
+	};
+
+	b8 start();
+	void record(Subsystem, r64);
+	b8 tick_done();
+}
+
+}
@@ -18,7 +18,7 @@
 // if you change this, make sure to allocate more physics categories for each team's force field
 #define MAX_TEAMS 4
 
-#define GAME_VERSION 39
+#define GAME_VERSION 40
 
 #define STEAM_APP_ID 728100
 #define DISCORD_APP_ID "367724608469860353"
@@ -55,9 +55,18 @@
 #define NET_MAX_MESSAGES_SIZE 1000
 #define NET_SEQUENCE_RESEND_BUFFER NET_ACK_PREVIOUS_SEQUENCES
 #define NET_HISTORY_SIZE 256
+#define NET_HISTORY_CACHE_SIZE 8
 #define NET_MASTER_STATUS_INTERVAL 1.0f
 #define NET_SERVER_IDLE_TIME 5.0f
 #define NET_MAX_RTT_COMPENSATION 0.2f
+#define NET_RELEVANCE_HISTORY 64
+#define NET_RELEVANCE_MAX_OVERRIDES 128
+#define NET_RELEVANCE_RANGE_SCALE 2.0f
+#define NET_RELEVANCE_LOW_INTERVAL 8
+#define NET_RELEVANCE_HIDDEN_DRONE_INTERVAL 2
+#define NET_TICK_BUSY_WAIT 0.0003 // spin for this long before each server tick instead of trusting the OS to wake us up on time. 0 = always sleep
+#define NET_TICK_MAX_CATCH_UP 4 // if the server falls more than this many ticks behind, it gives up on catching up
+#define NET_TICK_STATS_INTERVAL 60.0 // seconds between tick lateness reports
 
 #define LEVEL_ALLOWED(x) (true)
 
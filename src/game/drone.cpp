@@ -19,6 +19,7 @@
 #include "minion.h"
 #include "render/particles.h"
 #include "net.h"
+#include "spatial.h"
 #include "team.h"
 #include "load.h"
 #include "ease.h"
@@ -337,19 +338,19 @@ s32 impact_damage(const Drone* drone, const Entity* target_shield)
 			ray_dir = drone->velocity / speed;
 	}
 
-	Net::StateFrame state_frame;
+	Net::Rewind rewind;
 
 	Quat target_rot;
 	Vec3 target_pos;
 
 	if (Game::net_transform_filter(target_shield, Game::level.mode)
 		&& !PlayerHuman::players_on_same_client(drone->entity(), target_shield)
-		&& drone->net_state_frame(&state_frame))
+		&& drone->net_rewind(&rewind))
 	{
 		Vec3 pos;
 		Quat rot;
 		Vec3 local_offset;
-		Net::transform_absolute(state_frame, target_shield->get<Transform>()->id(), &pos, &rot, &local_offset);
+		Net::transform_absolute(rewind, target_shield->get<Transform>()->id(), &pos, &rot, &local_offset);
 		target_pos = pos + (rot * local_offset);
 		target_rot = rot;
 	}
@@ -470,13 +471,13 @@ void drone_bolt_spawn(Drone* drone, const Vec3& my_pos, const Vec3& dir_normaliz
 			const r32 SIMULATION_STEP = Net::tick_rate() * Game::session.effective_time_scale();
 
 			b8 rewound = false;
-			Net::StateFrame state_frame;
+			Net::Rewind rewind;
 			while (timestamp < Net::timestamp())
 			{
 				rewound = true;
-				Net::state_frame_by_timestamp(&state_frame, timestamp);
+				Net::rewind(&rewind, timestamp);
 
-				if (bolt->simulate(SIMULATION_STEP, &hit, &state_frame))
+				if (bolt->simulate(SIMULATION_STEP, &hit, &rewind))
 					break; // hit something
 
 				timestamp += SIMULATION_STEP;
@@ -485,7 +486,7 @@ void drone_bolt_spawn(Drone* drone, const Vec3& my_pos, const Vec3& dir_normaliz
 			Net::finalize(bolt_entity);
 
 			if (hit.entity) // we hit something, register it instantly
-				bolt->hit_entity(hit, rewound ? &state_frame : nullptr);
+				bolt->hit_entity(hit, rewound ? &rewind : nullptr);
 		}
 		else
 		{
@@ -751,22 +752,22 @@ b8 Drone::net_msg(Net::StreamRead* p, Net::MessageSource src)
 				if (Game::level.local && target.ref()->has<Shield>())
 				{
 					// check if we can damage them
-					Net::StateFrame state_frame_data;
-					const Net::StateFrame* state_frame = nullptr;
-					if (drone->net_state_frame(&state_frame_data))
-						state_frame = &state_frame_data;
+					Net::Rewind rewind_data;
+					const Net::Rewind* rewind = nullptr;
+					if (drone->net_rewind(&rewind_data))
+						rewind = &rewind_data;
 
-					if (target.ref()->get<Health>()->can_take_damage(drone->entity(), state_frame))
+					if (target.ref()->get<Health>()->can_take_damage(drone->entity(), rewind))
 					{
 						// we hurt them
-						target.ref()->get<Health>()->damage(drone->entity(), impact_damage(drone, target.ref()), state_frame);
+						target.ref()->get<Health>()->damage(drone->entity(), impact_damage(drone, target.ref()), rewind);
 					}
 					else
 					{
 						// we didn't hurt them
 						// check if they had active armor on and so should damage us
 						if (drone->state() != State::Crawl
-							&& target.ref()->get<Health>()->active_armor(state_frame)
+							&& target.ref()->get<Health>()->active_armor(rewind)
 							&& target.ref()->has<AIAgent>()
 							&& target.ref()->get<AIAgent>()->team != drone->get<AIAgent>()->team)
 							drone->get<Health>()->damage_force(target.ref(), DRONE_HEALTH + Game::session.config.ruleset.drone_shield);
@@ -868,11 +869,11 @@ b8 Drone::net_msg(Net::StreamRead* p, Net::MessageSource src)
 			Vec3 normal;
 			RigidBody* parent;
 			{
-				Net::StateFrame state_frame_data;
-				const Net::StateFrame* state_frame = nullptr;
-				if (drone->net_state_frame(&state_frame_data))
-					state_frame = &state_frame_data;
-				if (!drone->can_spawn(ability, dir_normalized, state_frame, &pos, &normal, &parent))
+				Net::Rewind rewind_data;
+				const Net::Rewind* rewind = nullptr;
+				if (drone->net_rewind(&rewind_data))
+					rewind = &rewind_data;
+				if (!drone->can_spawn(ability, dir_normalized, rewind, &pos, &normal, &parent))
 					return true;
 			}
 
@@ -992,13 +993,13 @@ b8 Drone::net_msg(Net::StreamRead* p, Net::MessageSource src)
 							const r32 SIMULATION_STEP = Net::tick_rate() * Game::session.effective_time_scale();
 
 							b8 rewound = false;
-							Net::StateFrame state_frame;
+							Net::Rewind rewind;
 							while (timestamp < Net::timestamp())
 							{
 								rewound = true;
-								Net::state_frame_by_timestamp(&state_frame, timestamp);
+								Net::rewind(&rewind, timestamp);
 
-								if (grenade->simulate(SIMULATION_STEP, &hit, &state_frame))
+								if (grenade->simulate(SIMULATION_STEP, &hit, &rewind))
 									break; // hit something
 
 								timestamp += SIMULATION_STEP;
@@ -1007,7 +1008,7 @@ b8 Drone::net_msg(Net::StreamRead* p, Net::MessageSource src)
 							Net::finalize(grenade_entity);
 
 							if (hit.entity) // we hit something, register it instantly
-								grenade->hit_entity(hit, rewound ? &state_frame : nullptr);
+								grenade->hit_entity(hit, rewound ? &rewind : nullptr);
 						}
 						else
 						{
@@ -1104,9 +1105,12 @@ Drone* Drone::closest(AI::TeamMask mask, const Vec3& pos, r32* distance)
 	Drone* closest = nullptr;
 	r32 closest_distance = FLT_MAX;
 
+	Spatial::Result candidates;
+	Spatial::closest_candidates(pos, component_mask, mask, &candidates);
+
 	for (auto i = list.iterator(); !i.is_last(); i.next())
 	{
-		if (AI::match(i.item()->get<AIAgent>()->team, mask))
+		if (Spatial::maybe(candidates, i.item()->entity()) && AI::match(i.item()->get<AIAgent>()->team, mask))
 		{
 			r32 d = (i.item()->get<Transform>()->absolute_pos() - pos).length_squared();
 			if (d < closest_distance)
@@ -1263,7 +1267,7 @@ b8 Drone::hit_target(Entity* target)
 	return true;
 }
 
-b8 Drone::predict_intersection(const Target* target, const Net::StateFrame* state_frame, Vec3* intersection, r32 speed) const
+b8 Drone::predict_intersection(const Target* target, const Net::Rewind* rewind, Vec3* intersection, r32 speed) const
 {
 	if (speed == 0.0f) // instant bullet travel time
 	{
@@ -1273,11 +1277,11 @@ b8 Drone::predict_intersection(const Target* target, const Net::StateFrame* stat
 	else
 	{
 		Vec3 me;
-		if (state_frame)
-			Net::transform_absolute(*state_frame, get<Transform>()->id(), &me);
+		if (rewind)
+			Net::transform_absolute(*rewind, get<Transform>()->id(), &me);
 		else
 			me = get<Transform>()->absolute_pos();
-		return target->predict_intersection(me, speed, state_frame, intersection);
+		return target->predict_intersection(me, speed, rewind, intersection);
 	}
 }
 
@@ -1325,10 +1329,10 @@ b8 Drone::can_dash(const Target* target, Vec3* out_intersection) const
 	return false;
 }
 
-b8 Drone::can_shoot(const Target* target, Vec3* out_intersection, r32 speed, const Net::StateFrame* state_frame) const
+b8 Drone::can_shoot(const Target* target, Vec3* out_intersection, r32 speed, const Net::Rewind* rewind) const
 {
 	Vec3 intersection;
-	if (predict_intersection(target, state_frame, &intersection, speed))
+	if (predict_intersection(target, rewind, &intersection, speed))
 	{
 		Vec3 me = get<Transform>()->absolute_pos();
 		Vec3 to_intersection = intersection - me;
@@ -1337,7 +1341,7 @@ b8 Drone::can_shoot(const Target* target, Vec3* out_intersection, r32 speed, con
 
 		Vec3 final_pos;
 		b8 hit_target;
-		if (can_shoot(to_intersection, &final_pos, &hit_target, state_frame))
+		if (can_shoot(to_intersection, &final_pos, &hit_target, rewind))
 		{
 			if (hit_target || (final_pos - me).length() > distance - DRONE_RADIUS * 2.0f)
 			{
@@ -1369,9 +1373,9 @@ b8 Drone::direction_is_toward_attached_wall(const Vec3& dir) const
 	return dir.dot(wall_normal) < 0.0f;
 }
 
-// get the state frame representing the world according to this player, if one exists
-// return false if no state frame is necessary
-b8 Drone::net_state_frame(Net::StateFrame* state_frame) const
+// get a rewound view of the world according to this player, if one exists
+// return false if no rewind is necessary
+b8 Drone::net_rewind(Net::Rewind* rewind) const
 {
 	if (Game::level.local && has<PlayerControlHuman>() && !get<PlayerControlHuman>()->local()) // this Drone is being controlled remotely; we need to rewind the world state to what it looks like from their side
 	{
@@ -1383,22 +1387,22 @@ b8 Drone::net_state_frame(Net::StateFrame* state_frame) const
 		timestamp = 0.0f;
 		vi_assert(false);
 #endif
-		return Net::state_frame_by_timestamp(state_frame, timestamp);
+		return Net::rewind(rewind, timestamp);
 	}
 	else
 		return false;
 }
 
-b8 Drone::can_shoot(const Vec3& dir, Vec3* final_pos, b8* hit_target, const Net::StateFrame* state_frame) const
+b8 Drone::can_shoot(const Vec3& dir, Vec3* final_pos, b8* hit_target, const Net::Rewind* rewind) const
 {
 	// if we're attached to a wall, make sure we're not shooting into the wall
 	if (state() == Drone::State::Crawl && direction_is_toward_attached_wall(dir))
 		return false;
 
-	return could_shoot(get<Transform>()->absolute_pos(), dir, final_pos, nullptr, hit_target, state_frame);
+	return could_shoot(get<Transform>()->absolute_pos(), dir, final_pos, nullptr, hit_target, rewind);
 }
 
-b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos, Vec3* final_normal, b8* hit_target, const Net::StateFrame* state_frame) const
+b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos, Vec3* final_normal, b8* hit_target, const Net::Rewind* rewind) const
 {
 	Vec3 trace_dir = Vec3::normalize(dir);
 
@@ -1412,12 +1416,12 @@ b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos,
 
 	Vec3 trace_end = trace_start + trace_dir * DRONE_SNIPE_DISTANCE;
 
-	Net::StateFrame state_frame_data;
-	if (!state_frame && net_state_frame(&state_frame_data))
-		state_frame = &state_frame_data;
+	Net::Rewind rewind_data;
+	if (!rewind && net_rewind(&rewind_data))
+		rewind = &rewind_data;
 
 	Hits hits;
-	raycast(RaycastMode::IgnoreForceFields, trace_start, trace_end, state_frame, &hits);
+	raycast(RaycastMode::IgnoreForceFields, trace_start, trace_end, rewind, &hits);
 
 	r32 r = range();
 	b8 allow_further_end = false; // allow drone to shoot if we're aiming at an enemy drone in range but the backing behind it is out of range
@@ -1438,7 +1442,7 @@ b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos,
 	}
 
 #if SERVER
-	if (state_frame)
+	if (rewind)
 		allow_further_end = true; // be more lenient on server to prevent glitching
 #endif
 
@@ -1453,7 +1457,7 @@ b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos,
 			if (i.item() != this && (i.item()->get<Target>()->absolute_pos() - trace_start).length_squared() > DRONE_SHIELD_RADIUS * 2.0f * DRONE_SHIELD_RADIUS * 2.0f)
 			{
 				Vec3 intersection;
-				if (predict_intersection(i.item()->get<Target>(), state_frame, &intersection, target_prediction_speed()))
+				if (predict_intersection(i.item()->get<Target>(), rewind, &intersection, target_prediction_speed()))
 				{
 					if ((intersection - trace_start).length_squared() <= end_distance_sq
 						&& LMath::ray_sphere_intersect(trace_start, trace_end, intersection, DRONE_SHIELD_RADIUS * 2.0f))
@@ -1497,24 +1501,24 @@ b8 Drone::could_shoot(const Vec3& trace_start, const Vec3& dir, Vec3* final_pos,
 	return false;
 }
 
-Vec3 target_position(Entity* me, const Net::StateFrame* state_frame, Target* target)
+Vec3 target_position(Entity* me, const Net::Rewind* rewind, Target* target)
 {
 	// do rewinding, unless we're checking collisions between two players on the same client
-	if (state_frame
+	if (rewind
 		&& Game::net_transform_filter(target->entity(), Game::level.mode)
 		&& !PlayerHuman::players_on_same_client(me, target->entity()))
 	{
 		Vec3 pos;
 		Quat rot;
 		Vec3 local_offset;
-		Net::transform_absolute(*state_frame, target->get<Transform>()->id(), &pos, &rot, &local_offset);
+		Net::transform_absolute(*rewind, target->get<Transform>()->id(), &pos, &rot, &local_offset);
 		return pos + (rot * local_offset);
 	}
 	else
 		return target->absolute_pos();
 }
 
-b8 Drone::can_spawn(Ability a, const Vec3& dir, const Net::StateFrame* state_frame, Vec3* final_pos, Vec3* final_normal, RigidBody** hit_parent, b8* hit_target) const
+b8 Drone::can_spawn(Ability a, const Vec3& dir, const Net::Rewind* rewind, Vec3* final_pos, Vec3* final_normal, RigidBody** hit_parent, b8* hit_target) const
 {
 	const AbilityInfo& info = AbilityInfo::list[s32(a)];
 
@@ -1575,12 +1579,12 @@ b8 Drone::can_spawn(Ability a, const Vec3& dir, const Net::StateFrame* state_fra
 	// check targets
 	for (auto i = Target::list.iterator(); !i.is_last(); i.next())
 	{
-		if (should_collide(i.item(), state_frame)
+		if (should_collide(i.item(), rewind)
 			|| i.item()->has<Minion>()) // raycast against friendly minions so we can easily spawn minions next to each other
 		{
 			{
 				// check actual position
-				Vec3 target_pos = target_position(entity(), state_frame, i.item());
+				Vec3 target_pos = target_position(entity(), rewind, i.item());
 				Vec3 intersection;
 				if (LMath::ray_sphere_intersect(trace_start, trace_end, target_pos, i.item()->radius(), &intersection)
 					&& (intersection - trace_start).length_squared() < (ray_callback.pos - trace_start).length_squared())
@@ -1890,11 +1894,11 @@ b8 Drone::dash_start(const Vec3& dir, const Vec3& target, r32 max_time)
 	{
 		// don't dash; just start flying
 		{
-			Net::StateFrame* state_frame = nullptr;
-			Net::StateFrame state_frame_data;
-			if (net_state_frame(&state_frame_data))
-				state_frame = &state_frame_data;
-			if (!could_shoot(pos, dir, nullptr, nullptr, nullptr, state_frame))
+			Net::Rewind* rewind = nullptr;
+			Net::Rewind rewind_data;
+			if (net_rewind(&rewind_data))
+				rewind = &rewind_data;
+			if (!could_shoot(pos, dir, nullptr, nullptr, nullptr, rewind))
 			{
 #if DEBUG_NET_SYNC && SERVER
 				if (has<PlayerControlHuman>())
@@ -1966,11 +1970,11 @@ b8 Drone::go(const Vec3& dir)
 	if (a == Ability::None)
 	{
 		{
-			Net::StateFrame* state_frame = nullptr;
-			Net::StateFrame state_frame_data;
-			if (net_state_frame(&state_frame_data))
-				state_frame = &state_frame_data;
-			if (!can_shoot(dir, nullptr, nullptr, state_frame))
+			Net::Rewind* rewind = nullptr;
+			Net::Rewind rewind_data;
+			if (net_rewind(&rewind_data))
+				rewind = &rewind_data;
+			if (!can_shoot(dir, nullptr, nullptr, rewind))
 			{
 #if SERVER && DEBUG_NET_SYNC
 				if (has<PlayerControlHuman>())
@@ -2165,7 +2169,7 @@ void drone_environment_raycast(const Drone* drone, RaycastCallbackExcept* ray_ca
 	Physics::raycast(ray_callback, mask);
 }
 
-void drone_dash_fly_simulate(Drone* d, r32 dt, Net::StateFrame* state_frame = nullptr)
+void drone_dash_fly_simulate(Drone* d, r32 dt, Net::Rewind* rewind = nullptr)
 {
 	Drone::State s = d->state();
 
@@ -2200,7 +2204,7 @@ void drone_dash_fly_simulate(Drone* d, r32 dt, Net::StateFrame* state_frame = nu
 			for (s32 i = 0; i < REFLECTION_TRIES; i++)
 			{
 				Vec3 candidate_dir = Quat::euler(0.0f, mersenne::randf_co() * PI * 2.0f, (mersenne::randf_co() - 0.5f) * PI) * Vec3(0, 0, 1);
-				if (d->can_shoot(candidate_dir, nullptr, nullptr, state_frame))
+				if (d->can_shoot(candidate_dir, nullptr, nullptr, rewind))
 				{
 					d->velocity = candidate_dir * DRONE_FLY_SPEED;
 					found = true;
@@ -2242,7 +2246,7 @@ void drone_dash_fly_simulate(Drone* d, r32 dt, Net::StateFrame* state_frame = nu
 		Vec3 dir = Vec3::normalize(d->velocity);
 		Vec3 ray_start = position + dir * -DRONE_RADIUS;
 		Vec3 ray_end = next_position + dir * DRONE_RADIUS;
-		d->movement_raycast(ray_start, ray_end, nullptr, state_frame);
+		d->movement_raycast(ray_start, ray_end, nullptr, rewind);
 	}
 }
 
@@ -2256,18 +2260,18 @@ void drone_fast_forward(Drone* d, r32 amount)
 	r32 timestamp = Net::timestamp() - amount * Game::session.effective_time_scale();
 	const r32 SIMULATION_STEP = Net::tick_rate() * Game::session.effective_time_scale();
 	s32 reflection_count = d->reflections.length;
+	Net::Rewind rewind;
 	while (timestamp < Net::timestamp()
 		&& d->reflections.length == reflection_count
 		&& d->state() != Drone::State::Crawl) // stop if we reflect off anything; movement_raycast will have handled fast-forwarding from that point
 	{
-		Net::StateFrame state_frame;
-		Net::state_frame_by_timestamp(&state_frame, timestamp);
-		drone_dash_fly_simulate(d, SIMULATION_STEP, &state_frame);
+		Net::rewind(&rewind, timestamp);
+		drone_dash_fly_simulate(d, SIMULATION_STEP, &rewind);
 		timestamp += SIMULATION_STEP;
 	}
 }
 
-void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const Net::StateFrame* state_frame)
+void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const Net::Rewind* rewind)
 {
 	vi_assert(velocity.length_squared() > 0.0f);
 
@@ -2305,7 +2309,7 @@ void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const N
 			if (allow_reflect_against_normal || candidate_dir.dot(normal) > 0.05f)
 			{
 				Vec3 next_hit;
-				if (can_shoot(candidate_dir, &next_hit, nullptr, state_frame))
+				if (can_shoot(candidate_dir, &next_hit, nullptr, rewind))
 				{
 					r32 distance = (next_hit - hit).length();
 					r32 score = fabsf(distance - goal_distance);
@@ -2328,7 +2332,7 @@ void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const N
 		}
 	}
 
-	if (!state_frame // this drone is locally controlled
+	if (!rewind // this drone is locally controlled
 		|| reflections.length == 0) // or we're a server and this drone is remote controlled, but the remote has not told us about this reflection yet
 	{
 		Reflection* reflection = reflections.add();
@@ -2339,7 +2343,7 @@ void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const N
 		reflection->additional_fast_forward_time = Game::time.delta - (hit - last_pos).length() / velocity.length();
 		reflection->dir = new_dir;
 
-		if (state_frame)
+		if (rewind)
 		{
 #if DEBUG_REFLECTIONS
 			vi_debug
@@ -2359,13 +2363,13 @@ void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const N
 		}
 	}
 
-	if (!state_frame // locally controlled; reflect instantly
+	if (!rewind // locally controlled; reflect instantly
 		|| reflections[0].src == Net::MessageSource::Remote) // remotely controlled, but the remote already told us about this reflection
 	{
 		const Reflection& reflection = reflections[0];
 
 		b8 valid;
-		if (state_frame)
+		if (rewind)
 		{
 			if ((reflection.pos - hit).length_squared() < DRONE_REFLECTION_POSITION_TOLERANCE * DRONE_REFLECTION_POSITION_TOLERANCE)
 			{
@@ -2383,17 +2387,17 @@ void Drone::reflect(Entity* entity, const Vec3& hit, const Vec3& normal, const N
 		else
 			valid = true;
 
-		// if we have a state frame, we're on the server and this is a remote drone
+		// if we have a rewind, we're on the server and this is a remote drone
 		// so reflections should only come from the remote
 		// if we're locally controlled, reflections should only come from us
-		vi_assert(b8(state_frame) == (reflection.src == Net::MessageSource::Remote));
+		vi_assert(b8(rewind) == (reflection.src == Net::MessageSource::Remote));
 
 		r32 fast_forward = vi_max(0.0f, DRONE_REFLECTION_TIME_TOLERANCE - reflection.timer);
 		if (valid)
 			drone_reflection_execute(this);
 		else
 			reflections.remove_ordered(0); // ignore it
-		if (state_frame) // only need to fast forward on server
+		if (rewind) // only need to fast forward on server
 			drone_fast_forward(this, fast_forward);
 	}
 }
@@ -3184,17 +3188,17 @@ s32 Drone::Hit::Comparator::compare(const Hit& a, const Hit& b)
 		return -1;
 }
 
-b8 Drone::should_collide(const Target* target, const Net::StateFrame* state_frame) const
+b8 Drone::should_collide(const Target* target, const Net::Rewind* rewind) const
 {
 	if (target == get<Target>())
 		return false; // don't collide with self
 	else if (target->has<Drone>())
 	{
 		DroneCollisionState target_collision_state;
-		if (state_frame
-			&& state_frame->drones[target->get<Drone>()->id()].active
+		if (rewind
+			&& Net::rewind_drone(*rewind, target->get<Drone>()->id()).active
 			&& !PlayerHuman::players_on_same_client(entity(), target->entity()))
-			target_collision_state = state_frame->drones[target->get<Drone>()->id()].collision_state;
+			target_collision_state = Net::rewind_drone(*rewind, target->get<Drone>()->id()).collision_state;
 		else
 			target_collision_state = target->get<Drone>()->collision_state();
 
@@ -3212,7 +3216,7 @@ b8 Drone::should_collide(const Target* target, const Net::StateFrame* state_fram
 	}
 }
 
-void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end, const Net::StateFrame* state_frame, Hits* result, s32 recursion_level, Entity* ignore) const
+void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end, const Net::Rewind* rewind, Hits* result, s32 recursion_level, Entity* ignore) const
 {
 	r32 distance_total = (ray_end - ray_start).length();
 
@@ -3254,10 +3258,10 @@ void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end
 		for (auto i = Target::list.iterator(); !i.is_last(); i.next())
 		{
 			if (i.item()->entity() == ignore // don't collide with ignored entity
-				|| !should_collide(i.item(), state_frame))
+				|| !should_collide(i.item(), rewind))
 				continue;
 
-			Vec3 p = target_position(entity(), state_frame, i.item());
+			Vec3 p = target_position(entity(), rewind, i.item());
 
 			r32 target_radius = i.item()->radius();
 			r32 raycast_radius = (current_ability == Ability::None && i.item()->has<Shield>()) ? DRONE_SHIELD_RADIUS : 0.0f;
@@ -3363,7 +3367,7 @@ void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end
 				if (e->has<Health>())
 				{
 					const Health* health = e->get<Health>();
-					if (!health->can_take_damage(entity(), state_frame)) // it's invincible; always bounce off
+					if (!health->can_take_damage(entity(), rewind)) // it's invincible; always bounce off
 						stop = true;
 					else if (s32(health->total()) > impact_damage(this, e))
 						stop = true; // it has health or shield to spare; we'll bounce off
@@ -3418,7 +3422,7 @@ void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end
 
 			{
 				Hits hits2;
-				raycast(mode, hit_end.pos + dir * DRONE_RADIUS, hit_end.pos + dir * DRONE_SNIPE_DISTANCE, state_frame, &hits2, recursion_level + 1, ignore);
+				raycast(mode, hit_end.pos + dir * DRONE_RADIUS, hit_end.pos + dir * DRONE_SNIPE_DISTANCE, rewind, &hits2, recursion_level + 1, ignore);
 
 				// append hits2 to result->hits
 
@@ -3437,19 +3441,19 @@ void Drone::raycast(RaycastMode mode, const Vec3& ray_start, const Vec3& ray_end
 	}
 }
 
-void Drone::movement_raycast(const Vec3& ray_start, const Vec3& ray_end, Hits* hits_out, const Net::StateFrame* state_frame)
+void Drone::movement_raycast(const Vec3& ray_start, const Vec3& ray_end, Hits* hits_out, const Net::Rewind* rewind)
 {
 	State s = state();
 
-	Net::StateFrame state_frame_data;
-	if (!state_frame)
+	Net::Rewind rewind_data;
+	if (!rewind)
 	{
-		if (net_state_frame(&state_frame_data))
-			state_frame = &state_frame_data;
+		if (net_rewind(&rewind_data))
+			rewind = &rewind_data;
 	}
 
 	Hits hits;
-	raycast(RaycastMode::Default, ray_start, ray_end, state_frame, &hits);
+	raycast(RaycastMode::Default, ray_start, ray_end, rewind, &hits);
 
 	// handle collisions
 	for (s32 i = 0; i < hits.index_end + 1; i++)
@@ -3465,18 +3469,18 @@ void Drone::movement_raycast(const Vec3& ray_start, const Vec3& ray_end, Hits* h
 			if (hit_target(hit.entity.ref())
 				&& i == hits.index_end // make sure this is the hit we thought we would stop on
 				&& s != State::Crawl) // make sure we're flying or dashing
-				reflect(hit.entity.ref(), hit.pos, hit.normal, state_frame);
+				reflect(hit.entity.ref(), hit.pos, hit.normal, rewind);
 		}
 		else if (hit.type == Hit::Type::Inaccessible)
 		{
 			if (s == State::Fly)
-				reflect(hit.entity.ref(), hit.pos, hit.normal, state_frame);
+				reflect(hit.entity.ref(), hit.pos, hit.normal, rewind);
 		}
 		else if (hit.type == Hit::Type::ForceField)
 		{
 			hit_target(hit.entity.ref());
 			if (s == State::Fly && i == hits.index_end)
-				reflect(hit.entity.ref(), hit.pos, hit.normal, state_frame);
+				reflect(hit.entity.ref(), hit.pos, hit.normal, rewind);
 		}
 		else if (hit.type == Hit::Type::Glass)
 			hit.entity.ref()->get<Glass>()->shatter(hit.pos, ray_end - ray_start);
@@ -23,7 +23,7 @@ struct Flag;
 namespace Net
 {
 	struct StreamRead;
-	struct StateFrame;
+	struct Rewind;
 }
 
 struct DroneReflectEvent
@@ -151,7 +151,7 @@ struct Drone : public ComponentType<Drone>
 	r32 target_prediction_speed() const;
 	r32 range() const;
 
-	b8 net_state_frame(Net::StateFrame*) const;
+	b8 net_rewind(Net::Rewind*) const;
 
 	Vec3 camera_center() const;
 	void ability(Ability);
@@ -166,9 +166,9 @@ struct Drone : public ComponentType<Drone>
 
 	s16 ally_force_field_mask() const;
 
-	b8 predict_intersection(const Target*, const Net::StateFrame*, Vec3*, r32) const;
+	b8 predict_intersection(const Target*, const Net::Rewind*, Vec3*, r32) const;
 
-	void reflect(Entity*, const Vec3&, const Vec3&, const Net::StateFrame*);
+	void reflect(Entity*, const Vec3&, const Vec3&, const Net::Rewind*);
 	enum class IncludeDroneRadius : s8
 	{
 		No,
@@ -202,16 +202,16 @@ struct Drone : public ComponentType<Drone>
 	b8 go(const Vec3&);
 
 	b8 direction_is_toward_attached_wall(const Vec3&) const;
-	b8 should_collide(const Target*, const Net::StateFrame* = nullptr) const;
-	b8 can_shoot(const Vec3&, Vec3* = nullptr, b8* = nullptr, const Net::StateFrame* = nullptr) const;
-	b8 can_shoot(const Target*, Vec3* = nullptr, r32 = DRONE_FLY_SPEED, const Net::StateFrame* = nullptr) const;
-	b8 could_shoot(const Vec3&, const Vec3&, Vec3* = nullptr, Vec3* = nullptr, b8* = nullptr, const Net::StateFrame* = nullptr) const;
-	b8 can_spawn(Ability, const Vec3&, const Net::StateFrame* = nullptr, Vec3* = nullptr, Vec3* = nullptr, RigidBody** = nullptr, b8* = nullptr) const;
+	b8 should_collide(const Target*, const Net::Rewind* = nullptr) const;
+	b8 can_shoot(const Vec3&, Vec3* = nullptr, b8* = nullptr, const Net::Rewind* = nullptr) const;
+	b8 can_shoot(const Target*, Vec3* = nullptr, r32 = DRONE_FLY_SPEED, const Net::Rewind* = nullptr) const;
+	b8 could_shoot(const Vec3&, const Vec3&, Vec3* = nullptr, Vec3* = nullptr, b8* = nullptr, const Net::Rewind* = nullptr) const;
+	b8 can_spawn(Ability, const Vec3&, const Net::Rewind* = nullptr, Vec3* = nullptr, Vec3* = nullptr, RigidBody** = nullptr, b8* = nullptr) const;
 	b8 can_dash(const Target*, Vec3* = nullptr) const;
 	b8 can_hit(const Target*, Vec3* = nullptr, r32 = DRONE_FLY_SPEED) const; // shoot or dash
 
-	void raycast(RaycastMode, const Vec3&, const Vec3&, const Net::StateFrame*, Hits*, s32 = 0, Entity* = nullptr) const;
-	void movement_raycast(const Vec3&, const Vec3&, Hits* = nullptr, const Net::StateFrame* = nullptr);
+	void raycast(RaycastMode, const Vec3&, const Vec3&, const Net::Rewind*, Hits*, s32 = 0, Entity* = nullptr) const;
+	void movement_raycast(const Vec3&, const Vec3&, Hits* = nullptr, const Net::Rewind* = nullptr);
 
 	void update_server(const Update&);
 	void update_client(const Update&);
@@ -24,6 +24,7 @@
 #include "render/particles.h"
 #include "data/priority_queue.h"
 #include "net.h"
+#include "spatial.h"
 #include "team.h"
 #include "parkour.h"
 #include "overworld.h"
@@ -256,10 +257,10 @@ b8 Health::damage_buffer_required(const Entity* src) const
 #endif
 }
 
-void Health::damage(Entity* src, s8 damage, const Net::StateFrame* state_frame)
+void Health::damage(Entity* src, s8 damage, const Net::Rewind* rewind)
 {
 	vi_assert(Game::level.local);
-	vi_assert(can_take_damage(src, state_frame));
+	vi_assert(can_take_damage(src, rewind));
 	if (hp > 0 && damage > 0)
 	{
 		if (damage_buffer_required(src))
@@ -320,14 +321,14 @@ s8 Health::total() const
 	return hp + shield;
 }
 
-b8 Health::active_armor(const Net::StateFrame* state_frame) const
+b8 Health::active_armor(const Net::Rewind* rewind) const
 {
 	if (has<ForceField>())
 		return active_armor_timer > 0.0f || (get<ForceField>()->flags & ForceField::FlagInvincible);
 	else if (has<Drone>())
 	{
-		if (state_frame && state_frame->drones[get<Drone>()->id()].active)
-			return state_frame->drones[get<Drone>()->id()].collision_state == DroneCollisionState::ActiveArmor;
+		if (rewind && Net::rewind_drone(*rewind, get<Drone>()->id()).active)
+			return Net::rewind_drone(*rewind, get<Drone>()->id()).collision_state == DroneCollisionState::ActiveArmor;
 		else
 			return active_armor_timer > 0.0f;
 	}
@@ -335,18 +336,18 @@ b8 Health::active_armor(const Net::StateFrame* state_frame) const
 		return active_armor_timer > 0.0f;
 }
 
-b8 Health::can_take_damage(Entity* damager, const Net::StateFrame* state_frame) const
+b8 Health::can_take_damage(Entity* damager, const Net::Rewind* rewind) const
 {
-	if (active_armor(state_frame))
+	if (active_armor(rewind))
 		return false;
 
 	if (has<Drone>())
 	{
 		DroneCollisionState collision_state;
-		if (state_frame
-			&& state_frame->drones[get<Drone>()->id()].active
+		if (rewind
+			&& Net::rewind_drone(*rewind, get<Drone>()->id()).active
 			&& !PlayerHuman::players_on_same_client(entity(), damager))
-			collision_state = state_frame->drones[get<Drone>()->id()].collision_state;
+			collision_state = Net::rewind_drone(*rewind, get<Drone>()->id()).collision_state;
 		else
 			collision_state = get<Drone>()->collision_state();
 		switch (collision_state)
@@ -2609,10 +2610,16 @@ void Turret::check_target()
 
 	Ref<Entity> target_new = nullptr;
 
+	// can_see() won't see anything farther than this
+	Spatial::Result in_range;
+	Spatial::radius(get<Transform>()->absolute_pos(), TURRET_RANGE + FORCE_FIELD_RADIUS, Health::component_mask, Spatial::TeamsAny, &in_range);
+
 	s32 target_priority = 0;
 	for (auto i = Health::list.iterator(); !i.is_last(); i.next())
 	{
 		Entity* e = i.item()->entity();
+		if (!Spatial::maybe(in_range, e))
+			continue;
 		AI::Team e_team = AI::entity_team(e);
 		if (e_team != AI::TeamNone
 			&& e_team != team
@@ -3230,7 +3237,7 @@ b8 Bolt::default_raycast_filter(Entity* e, AI::Team team)
 		&& (!e->has<Turret>() || e->get<Turret>()->team != team); // ignore friendly turrets
 }
 
-b8 Bolt::raycast(const Vec3& trace_start, const Vec3& trace_end, s16 mask, AI::Team team, Hit* out_hit, b8(*filter)(Entity*, AI::Team), const Net::StateFrame* state_frame, r32 extra_radius)
+b8 Bolt::raycast(const Vec3& trace_start, const Vec3& trace_end, s16 mask, AI::Team team, Hit* out_hit, b8(*filter)(Entity*, AI::Team), const Net::Rewind* rewind, r32 extra_radius)
 {
 	out_hit->entity = nullptr;
 	r32 closest_hit_distance_sq = FLT_MAX;
@@ -3254,12 +3261,12 @@ b8 Bolt::raycast(const Vec3& trace_start, const Vec3& trace_end, s16 mask, AI::T
 			continue;
 
 		Vec3 p;
-		if (state_frame)
+		if (rewind)
 		{
 			Vec3 pos;
 			Quat rot;
 			Vec3 local_offset;
-			Net::transform_absolute(*state_frame, i.item()->get<Transform>()->id(), &pos, &rot, &local_offset);
+			Net::transform_absolute(*rewind, i.item()->get<Transform>()->id(), &pos, &rot, &local_offset);
 			p = pos + (rot * local_offset);
 		}
 		else
@@ -3283,10 +3290,10 @@ b8 Bolt::raycast(const Vec3& trace_start, const Vec3& trace_end, s16 mask, AI::T
 }
 
 // returns true if the bolt hit something
-b8 Bolt::simulate(r32 dt, Hit* out_hit, const Net::StateFrame* state_frame)
+b8 Bolt::simulate(r32 dt, Hit* out_hit, const Net::Rewind* rewind)
 {
 	remaining_lifetime -= dt;
-	if (!state_frame && remaining_lifetime < 0.0f)
+	if (!rewind && remaining_lifetime < 0.0f)
 	{
 		if (visible())
 			ParticleEffect::spawn(ParticleEffect::Type::Fizzle, get<Transform>()->absolute_pos(), Quat::look(Vec3::normalize(velocity)));
@@ -3304,11 +3311,11 @@ b8 Bolt::simulate(r32 dt, Hit* out_hit, const Net::StateFrame* state_frame)
 	Glass::shatter_all(pos, trace_end);
 
 	Hit hit;
-	if (raycast(pos, trace_end, CollisionStatic | (CollisionAllTeamsForceField & Bolt::raycast_mask(team)), team, &hit, &default_raycast_filter, state_frame))
+	if (raycast(pos, trace_end, CollisionStatic | (CollisionAllTeamsForceField & Bolt::raycast_mask(team)), team, &hit, &default_raycast_filter, rewind))
 	{
 		if (out_hit)
 			*out_hit = hit;
-		if (!state_frame) // if the server is fast-forward simulating us, we can't register the hit ourselves
+		if (!rewind) // if the server is fast-forward simulating us, we can't register the hit ourselves
 			hit_entity(hit);
 		return true;
 	}
@@ -3381,7 +3388,7 @@ void Bolt::reflect(const Entity* hit_object, ReflectionType reflection_type, con
 		BoltNet::reflect(this);
 }
 
-void Bolt::hit_entity(const Hit& hit, const Net::StateFrame* state_frame)
+void Bolt::hit_entity(const Hit& hit, const Net::Rewind* rewind)
 {
 	Entity* hit_object = hit.entity;
 
@@ -3472,7 +3479,7 @@ void Bolt::hit_entity(const Hit& hit, const Net::StateFrame* state_frame)
 			}
 		}
 
-		if (!hit_object->has<Health>() || !hit_object->get<Health>()->can_take_damage(entity(), state_frame))
+		if (!hit_object->has<Health>() || !hit_object->get<Health>()->can_take_damage(entity(), rewind))
 			damage = 0;
 
 		if (hit_force_field_collision)
@@ -3483,7 +3490,7 @@ void Bolt::hit_entity(const Hit& hit, const Net::StateFrame* state_frame)
 				reflect(hit_object, ReflectionType::Simple, hit.normal);
 			}
 		}
-		else if (hit_object->get<Health>()->active_armor(state_frame))
+		else if (hit_object->get<Health>()->active_armor(rewind))
 		{
 			damage = 0;
 			if (hit_object->has<Shield>())
@@ -4119,7 +4126,7 @@ b8 grenade_hit_filter(Entity* e, AI::Team team)
 }
 
 // returns true if grenade hits something
-b8 Grenade::simulate(r32 dt, Bolt::Hit* out_hit, const Net::StateFrame* state_frame)
+b8 Grenade::simulate(r32 dt, Bolt::Hit* out_hit, const Net::Rewind* rewind)
 {
 	vi_assert(Game::level.local);
 	Transform* t = get<Transform>();
@@ -4145,12 +4152,12 @@ b8 Grenade::simulate(r32 dt, Bolt::Hit* out_hit, const Net::StateFrame* state_fr
 			Glass::shatter_all(pos, next_pos);
 
 			Bolt::Hit hit;
-			if (Bolt::raycast(pos, next_pos, CollisionStatic | (CollisionAllTeamsForceField & Bolt::raycast_mask(team)), team, &hit, &grenade_hit_filter, state_frame, DRONE_SHIELD_RADIUS * DRONE_SHIELD_VIEW_RATIO))
+			if (Bolt::raycast(pos, next_pos, CollisionStatic | (CollisionAllTeamsForceField & Bolt::raycast_mask(team)), team, &hit, &grenade_hit_filter, rewind, DRONE_SHIELD_RADIUS * DRONE_SHIELD_VIEW_RATIO))
 			{
 				if (out_hit)
 					*out_hit = hit;
 
-				if (!state_frame) // if server is fast-forward simulating us, we can't register the hit ourselves
+				if (!rewind) // if server is fast-forward simulating us, we can't register the hit ourselves
 					hit_entity(hit);
 
 				return true;
@@ -4163,7 +4170,7 @@ b8 Grenade::simulate(r32 dt, Bolt::Hit* out_hit, const Net::StateFrame* state_fr
 	return false;
 }
 
-void Grenade::hit_entity(const Bolt::Hit& hit, const Net::StateFrame* state_frame)
+void Grenade::hit_entity(const Bolt::Hit& hit, const Net::Rewind* rewind)
 {
 	if (grenade_hit_filter(hit.entity, team))
 	{
@@ -4498,23 +4505,23 @@ Vec3 Target::velocity() const
 		return net_velocity;
 }
 
-b8 Target::predict_intersection(const Vec3& from, r32 speed, const Net::StateFrame* state_frame, Vec3* intersection) const
+b8 Target::predict_intersection(const Vec3& from, r32 speed, const Net::Rewind* rewind, Vec3* intersection) const
 {
 	Vec3 pos;
 	Vec3 v;
-	if (state_frame)
+	if (rewind)
 	{
 		Quat rot;
 		Vec3 l; // local_offset
-		Net::transform_absolute(*state_frame, get<Transform>()->id(), &pos, &rot, &l);
+		Net::transform_absolute(*rewind, get<Transform>()->id(), &pos, &rot, &l);
 		pos += rot * l;
 
-		Net::StateFrame state_frame_last;
-		Net::state_frame_by_timestamp(&state_frame_last, state_frame->timestamp - Net::tick_rate());
+		Net::Rewind rewind_last;
+		Net::rewind(&rewind_last, rewind->timestamp - Net::tick_rate());
 		Vec3 pos_last;
 		Quat rot_last;
 		Vec3 l_last;
-		Net::transform_absolute(state_frame_last, get<Transform>()->id(), &pos_last, &rot_last, &l_last);
+		Net::transform_absolute(rewind_last, get<Transform>()->id(), &pos_last, &rot_last, &l_last);
 		pos_last += rot_last * l_last;
 
 		v = (pos - pos_last) / Net::tick_rate();
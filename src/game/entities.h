@@ -10,7 +10,7 @@ namespace VI
 namespace Net
 {
 	struct StreamRead;
-	struct StateFrame;
+	struct Rewind;
 }
 
 struct PlayerManager;
@@ -67,14 +67,14 @@ struct Health : public ComponentType<Health>
 	b8 damage_buffer_required(const Entity*) const;
 	void update(const Update&);
 	void awake() {}
-	void damage(Entity*, s8, const Net::StateFrame* = nullptr);
+	void damage(Entity*, s8, const Net::Rewind* = nullptr);
 	void damage_force(Entity*, s8);
 	void reset_hp();
 	void kill(Entity*);
 	void add(s8);
 	s8 total() const;
-	b8 active_armor(const Net::StateFrame* = nullptr) const;
-	b8 can_take_damage(Entity*, const Net::StateFrame* = nullptr) const;
+	b8 active_armor(const Net::Rewind* = nullptr) const;
+	b8 can_take_damage(Entity*, const Net::Rewind* = nullptr) const;
 };
 
 struct Shield : public ComponentType<Shield>
@@ -500,7 +500,7 @@ struct Bolt : public ComponentType<Bolt>
 	static b8 net_msg(Net::StreamRead*, Net::MessageSource);
 	static void update_client_all(const Update&);
 	static b8 default_raycast_filter(Entity*, AI::Team);
-	static b8 raycast(const Vec3&, const Vec3&, s16, AI::Team, Hit*, b8(*)(Entity*, AI::Team), const Net::StateFrame* = nullptr, r32 = 0.0f);
+	static b8 raycast(const Vec3&, const Vec3&, s16, AI::Team, Hit*, b8(*)(Entity*, AI::Team), const Net::Rewind* = nullptr, r32 = 0.0f);
 	
 	Vec3 velocity;
 	Vec3 last_pos;
@@ -515,8 +515,8 @@ struct Bolt : public ComponentType<Bolt>
 
 	b8 visible() const; // bolts are invisible and essentially inert while they are waiting for damage buffer
 	void reflect(const Entity*, ReflectionType = ReflectionType::Homing, const Vec3& = Vec3::zero);
-	b8 simulate(r32, Hit* = nullptr, const Net::StateFrame* = nullptr); // returns true if the bolt hit something
-	void hit_entity(const Hit&, const Net::StateFrame* = nullptr);
+	b8 simulate(r32, Hit* = nullptr, const Net::Rewind* = nullptr); // returns true if the bolt hit something
+	void hit_entity(const Hit&, const Net::Rewind* = nullptr);
 };
 
 struct BoltEntity : public Entity
@@ -595,12 +595,12 @@ struct Grenade : public ComponentType<Grenade>
 	void awake();
 
 	void hit_by(const TargetEvent&);
-	void hit_entity(const Bolt::Hit&, const Net::StateFrame* = nullptr);
+	void hit_entity(const Bolt::Hit&, const Net::Rewind* = nullptr);
 	void killed_by(Entity*);
 	void explode();
 	void set_owner(PlayerManager*);
 
-	b8 simulate(r32, Bolt::Hit* = nullptr, const Net::StateFrame* = nullptr); // returns true if grenade hits something
+	b8 simulate(r32, Bolt::Hit* = nullptr, const Net::Rewind* = nullptr); // returns true if grenade hits something
 };
 
 struct Target : public ComponentType<Target>
@@ -613,7 +613,7 @@ struct Target : public ComponentType<Target>
 	Vec3 velocity() const;
 	Vec3 absolute_pos() const;
 	void hit(Entity*);
-	b8 predict_intersection(const Vec3&, r32, const Net::StateFrame*, Vec3*) const;
+	b8 predict_intersection(const Vec3&, r32, const Net::Rewind*, Vec3*) const;
 	r32 radius() const;
 };
 
@@ -64,6 +64,10 @@
 #endif
 #include "data/unicode.h"
 #include "noise.h"
+#include "benchmark.h"
+#include "spatial.h"
+#include "profile.h"
+#include "jobs.h"
 
 #define DEBUG_WALK_NAV_MESH 0
 #define DEBUG_DRONE_AI_PATH 0
@@ -330,7 +334,8 @@ Game::PreinitResult Game::pre_init(const char** error)
 	}
 #endif
 
-	mersenne::srand(u32(platform::timestamp()));
+	// the only place we seed. benchmark runs use the seed from the command line so they're repeatable
+	mersenne::srand(Benchmark::active ? Benchmark::config.seed : u32(platform::timestamp()));
 	noise::reseed();
 	Net::Master::Ruleset::init();
 
@@ -363,6 +368,8 @@ const char* Game::init(LoopSync* sync)
 
 	Net::init();
 
+	Jobs::init(AI::Worker::pool_thread_count());
+
 #if !SERVER
 	// replay files
 	{
@@ -754,8 +761,29 @@ void Game::auth()
 	Auth::init();
 }
 
+#define ANIMATOR_POSE_GRAIN 8 // animators per job
+#define ANIMATOR_POSE_SERIAL 0 // 1 = the old order: layers, pose and bindings for one Animator before moving on to the next
+
+struct AnimatorPose
+{
+	Animator* animator;
+	const Armature* armature;
+};
+
+Array<Ref<Animator>> animator_updated;
+Array<AnimatorPose> animator_poses;
+
+void animator_pose_job(void* context, s32 begin, s32 end)
+{
+	const Array<AnimatorPose>& poses = *(const Array<AnimatorPose>*)context;
+	for (s32 i = begin; i < end; i++)
+		poses[i].animator->pose_update(poses[i].armature);
+}
+
 void Game::update(InputState* input, const InputState* last_input)
 {
+	vi_profile("Game::update");
+
 #if !SERVER && !defined(__ORBIS__)
 	Discord_UpdateConnection();
 	Discord_RunCallbacks();
@@ -780,6 +808,8 @@ void Game::update(InputState* input, const InputState* last_input)
 	{
 		r64 t = platform::time();
 		r64 dt = vi_min(t - platform_time, 0.2);
+		if (Benchmark::active)
+			dt = Net::tick_rate(); // fixed timestep, so runs are repeatable
 		platform_time = t;
 
 		real_time.total = r32(r64(real_time.total) + dt);
@@ -847,7 +877,11 @@ void Game::update(InputState* input, const InputState* last_input)
 			ParticleSystem::list[i]->update();
 	}
 
-	Net::update_start(u);
+	{
+		vi_profile("Net::update_start");
+		Benchmark::Timer timer(Benchmark::Subsystem::Net);
+		Net::update_start(u);
+	}
 
 #if !SERVER
 	// trigger attract mode
@@ -950,53 +984,140 @@ void Game::update(InputState* input, const InputState* last_input)
 	Menu::update(u);
 #endif
 
-	AI::update(u);
+	{
+		vi_profile("AI::update");
+		Benchmark::Timer timer(Benchmark::Subsystem::AI);
+		AI::update(u);
+	}
 
-	Team::update_all(u);
+	{
+		vi_profile("Team::update_all");
+		Benchmark::Timer timer(Benchmark::Subsystem::Team);
+		Team::update_all(u);
+	}
 
 	if (update_game)
 	{
+		Benchmark::Timer timer(Benchmark::Subsystem::Simulation);
+
 		Ascensions::update(u);
 		Asteroids::update(u);
 
-		Physics::sync_dynamic();
+		{
+			vi_profile("Physics::sync_dynamic");
+			Physics::sync_dynamic();
+		}
+
+		Spatial::build();
 
 		ShellCasing::update_all(u);
 
-		for (auto i = Ragdoll::list.iterator(); !i.is_last(); i.next())
 		{
-			if (level.local)
-				i.item()->update_server(u);
-			i.item()->update_client(u);
+			vi_profile("Ragdoll");
+			for (auto i = Ragdoll::list.iterator(); !i.is_last(); i.next())
+			{
+				if (level.local)
+					i.item()->update_server(u);
+				i.item()->update_client(u);
+			}
 		}
-		for (auto i = Animator::list.iterator(); !i.is_last(); i.next())
 		{
-			if (!level.local && i.item()->has<Walker>() && (!i.item()->has<PlayerControlHuman>() || !i.item()->get<PlayerControlHuman>()->local()))
-				i.item()->update_client_only(u); // walker animations are synced over the network
-			else if (!i.item()->has<Parkour>()) // Parkour component updates the Animator on its own terms
-				i.item()->update_server(u);
+			vi_profile("Animator");
+
+#if ANIMATOR_POSE_SERIAL
+			for (auto i = Animator::list.iterator(); !i.is_last(); i.next())
+			{
+				if (!level.local && i.item()->has<Walker>() && (!i.item()->has<PlayerControlHuman>() || !i.item()->get<PlayerControlHuman>()->local()))
+					i.item()->update_client_only(u); // walker animations are synced over the network
+				else if (!i.item()->has<Parkour>()) // Parkour component updates the Animator on its own terms
+					i.item()->update_server(u);
+			}
+#else
+			// layer updates fire trigger links and load assets, so they stay on this thread.
+			// posing only touches the Animator itself, so that part gets spread across cores.
+			// bindings move other Transforms, so they go back to this thread afterward.
+			// NOTE: this means every trigger fires before any Animator is posed. a trigger that looks at
+			// another Animator's bones or bound Transforms sees last frame's pose, where it used to depend
+			// on which of the two came first in the list. bindings still run in list order.
+			// flip ANIMATOR_POSE_SERIAL to compare against the old behavior
+			animator_updated.length = 0;
+			for (auto i = Animator::list.iterator(); !i.is_last(); i.next())
+			{
+				Animator* animator = i.item();
+				if (!level.local && animator->has<Walker>() && (!animator->has<PlayerControlHuman>() || !animator->get<PlayerControlHuman>()->local()))
+					animator->layers_update(0.0f, u.time.delta); // walker animations are synced over the network
+				else if (!animator->has<Parkour>()) // Parkour component updates the Animator on its own terms
+					animator->layers_update(u.time.delta, u.time.delta);
+				else
+					continue;
+				animator_updated.add(animator);
+			}
+
+			// trigger links can do anything, including remove other Animators, so wait until they've all fired
+			animator_poses.length = 0;
+			for (s32 j = 0; j < animator_updated.length; j++)
+			{
+				Animator* animator = animator_updated[j].ref();
+				if (animator)
+				{
+					const Armature* arm = animator->pose_prepare();
+					if (arm)
+						animator_poses.add({ animator, arm });
+				}
+			}
+
+			Jobs::Pass pass =
+			{
+				"Animator pose",
+				&animator_pose_job,
+				&animator_poses,
+				animator_poses.length,
+				ANIMATOR_POSE_GRAIN,
+				0,
+				Animator::component_mask,
+			};
+			Jobs::run(pass);
+
+			for (s32 j = 0; j < animator_poses.length; j++)
+				animator_poses[j].animator->bindings_update();
+#endif
 		}
 
 		for (auto i = TramRunner::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
 
-		Physics::sync_static();
+		{
+			vi_profile("Physics::sync_static");
+			Physics::sync_static();
+		}
 
 		ParticleEffect::update_all(u);
 
-		PlayerManager::update_all(u);
-		PlayerHuman::update_all(u);
+		{
+			vi_profile("PlayerManager");
+			PlayerManager::update_all(u);
+			PlayerHuman::update_all(u);
+		}
 
 		if (level.local)
 		{
-			for (auto i = Walker::list.iterator(); !i.is_last(); i.next())
-				i.item()->update_server(u);
-			for (auto i = PlayerAI::list.iterator(); !i.is_last(); i.next())
-				i.item()->update_server(u);
-			for (auto i = PlayerControlAI::list.iterator(); !i.is_last(); i.next())
-				i.item()->update_server(u);
-			for (auto i = Bolt::list.iterator(); !i.is_last(); i.next())
-				i.item()->simulate(u.time.delta);
+			{
+				vi_profile("Walker");
+				for (auto i = Walker::list.iterator(); !i.is_last(); i.next())
+					i.item()->update_server(u);
+			}
+			{
+				vi_profile("PlayerAI");
+				for (auto i = PlayerAI::list.iterator(); !i.is_last(); i.next())
+					i.item()->update_server(u);
+				for (auto i = PlayerControlAI::list.iterator(); !i.is_last(); i.next())
+					i.item()->update_server(u);
+			}
+			{
+				vi_profile("Bolt");
+				for (auto i = Bolt::list.iterator(); !i.is_last(); i.next())
+					i.item()->simulate(u.time.delta);
+			}
 			for (auto i = Flag::list.iterator(); !i.is_last(); i.next())
 				i.item()->update_server(u);
 		}
@@ -1013,11 +1134,17 @@ void Game::update(InputState* input, const InputState* last_input)
 #endif
 
 		MinionSpawner::update_all(u);
-		Turret::update_all(u);
+		{
+			vi_profile("Turret");
+			Turret::update_all(u);
+		}
 
 		for (auto i = Health::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
-		Minion::update_all(u);
+		{
+			vi_profile("Minion");
+			Minion::update_all(u);
+		}
 		Grenade::update_all(u);
 		for (auto i = Tile::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
@@ -1025,7 +1152,10 @@ void Game::update(InputState* input, const InputState* last_input)
 			i.item()->update(u);
 		for (auto i = UpgradeStation::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
-		Drone::update_all(u);
+		{
+			vi_profile("Drone");
+			Drone::update_all(u);
+		}
 		for (auto i = PlayerTrigger::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
 		Battery::update_all(u);
@@ -1035,23 +1165,32 @@ void Game::update(InputState* input, const InputState* last_input)
 			i.item()->update(u);
 		for (auto i = PlayerCommon::list.iterator(); !i.is_last(); i.next())
 			i.item()->update(u);
-		for (auto i = PlayerControlHuman::list.iterator(); !i.is_last(); i.next())
 		{
-			if (!level.local && i.item()->local() && i.item()->has<Walker>())
-				i.item()->get<Walker>()->update_server(u); // walkers are normally only updated on the server
-			i.item()->update(u);
+			vi_profile("PlayerControlHuman");
+			for (auto i = PlayerControlHuman::list.iterator(); !i.is_last(); i.next())
+			{
+				if (!level.local && i.item()->local() && i.item()->has<Walker>())
+					i.item()->get<Walker>()->update_server(u); // walkers are normally only updated on the server
+				i.item()->update(u);
+			}
 		}
-		for (auto i = Parkour::list.iterator(); !i.is_last(); i.next())
 		{
-			if (i.item()->get<PlayerControlHuman>()->local())
-				i.item()->update_server(u);
-			else if (level.local) // server needs to manually update the animator because it's normally updated by the Parkour component
-				i.item()->get<Animator>()->update_server(u);
-			i.item()->update_client(u);
+			vi_profile("Parkour");
+			for (auto i = Parkour::list.iterator(); !i.is_last(); i.next())
+			{
+				if (i.item()->get<PlayerControlHuman>()->local())
+					i.item()->update_server(u);
+				else if (level.local) // server needs to manually update the animator because it's normally updated by the Parkour component
+					i.item()->get<Animator>()->update_server(u);
+				i.item()->update_client(u);
+			}
 		}
 
-		for (auto i = Drone::list.iterator(); !i.is_last(); i.next())
-			i.item()->update_client_late(u);
+		{
+			vi_profile("Drone late");
+			for (auto i = Drone::list.iterator(); !i.is_last(); i.next())
+				i.item()->update_client_late(u);
+		}
 
 		Shield::update_all(u);
 
@@ -1088,7 +1227,11 @@ void Game::update(InputState* input, const InputState* last_input)
 
 	Overworld::update(u);
 
-	World::flush();
+	{
+		vi_profile("World::flush");
+		Benchmark::Timer timer(Benchmark::Subsystem::World);
+		World::flush();
+	}
 
 	Audio::param_global(AK::GAME_PARAMETERS::TIMESCALE, session.effective_time_scale());
 	Audio::update_all(u);
@@ -1097,7 +1240,11 @@ void Game::update(InputState* input, const InputState* last_input)
 	Menu::update_end(u);
 #endif
 
-	Net::update_end(u);
+	{
+		vi_profile("Net::update_end");
+		Benchmark::Timer timer(Benchmark::Subsystem::Net);
+		Net::update_end(u);
+	}
 
 	Auth::update();
 
@@ -1115,6 +1262,7 @@ void Game::config_apply()
 
 void Game::term()
 {
+	Jobs::term();
 	Net::term();
 	Audio::term();
 #if !SERVER && !defined(__ORBIS__)
@@ -1593,6 +1741,118 @@ void Game::draw_alpha_late(const RenderParams& render_params)
 
 #endif
 
+#if !RELEASE_BUILD
+// bit-at-a-time scan, the way Bitmask::next used to work
+s32 bitmask_next_reference(const Bitmask<MAX_ENTITIES>& mask, s32 i)
+{
+	i++;
+	while (i < mask.end && !mask.get(i))
+		i++;
+	return i;
+}
+
+void benchmark_bitmask_iteration(const char* label, const Bitmask<MAX_ENTITIES>& mask)
+{
+	const s32 iterations = 10000;
+
+	s64 sum_reference = 0;
+	r64 start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (s32 i = mask.start; i < mask.end; i = bitmask_next_reference(mask, i))
+			sum_reference += i;
+	}
+	r64 time_reference = platform::time() - start_time;
+
+	s64 sum = 0;
+	start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (s32 i = mask.start; i < mask.end; i = mask.next(i))
+			sum += i;
+	}
+	r64 time_word = platform::time() - start_time;
+
+	vi_assert(sum == sum_reference);
+	vi_debug("%s (%d of %d): per bit %.2fus, per word %.2fus", label, s32(mask.count()), MAX_ENTITIES, time_reference * 1000000.0 / r64(iterations), time_word * 1000000.0 / r64(iterations));
+}
+
+void benchmark_iteration()
+{
+	Bitmask<MAX_ENTITIES> mask;
+	for (s32 i = 0; i < MAX_ENTITIES; i += 97)
+		mask.set(i, true);
+	mask.set(MAX_ENTITIES - 1, true);
+	benchmark_bitmask_iteration("sparse", mask);
+
+	mask.clear();
+	for (s32 i = 0; i < MAX_ENTITIES; i++)
+		mask.set(i, mersenne::randf_co() < 0.9f);
+	benchmark_bitmask_iteration("dense", mask);
+
+	// live entities: filtering by hand vs. Join
+	const s32 iterations = 1000;
+	s32 count_filter = 0;
+	r64 start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (auto i = Transform::list.iterator(); !i.is_last(); i.next())
+		{
+			if (i.item()->has<Target>() && i.item()->has<Shield>())
+				count_filter++;
+		}
+	}
+	r64 time_filter = platform::time() - start_time;
+
+	s32 count_join = 0;
+	start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (auto i = Join<Shield, Target, Transform>::iterator(); !i.is_last(); i.next())
+			count_join++;
+	}
+	r64 time_join = platform::time() - start_time;
+
+	vi_assert(count_filter == count_join);
+	vi_debug("Transform+Target+Shield (%d of %d transforms): filter %.2fus, join %.2fus", count_join / iterations, s32(Transform::list.count()), time_filter * 1000000.0 / r64(iterations), time_join * 1000000.0 / r64(iterations));
+}
+
+// reads every absolute transform the given number of times, walking parent chains vs. inside a CacheScope.
+// the scoped time includes computing the table when the scope opens
+void benchmark_transforms(s32 reads)
+{
+	reads = vi_max(1, reads);
+	const s32 iterations = 100;
+
+	Vec3 sum_walk = Vec3::zero;
+	r64 start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (s32 k = 0; k < reads; k++)
+		{
+			for (auto i = Transform::list.iterator(); !i.is_last(); i.next())
+				sum_walk += i.item()->absolute_pos();
+		}
+	}
+	r64 time_walk = platform::time() - start_time;
+
+	Vec3 sum_cached = Vec3::zero;
+	start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		Transform::CacheScope transform_cache;
+		for (s32 k = 0; k < reads; k++)
+		{
+			for (auto i = Transform::list.iterator(); !i.is_last(); i.next())
+				sum_cached += i.item()->absolute_pos();
+		}
+	}
+	r64 time_cached = platform::time() - start_time;
+
+	vi_debug("%d transforms, %d reads each: walk %.2fus, scope %.2fus, difference %f", s32(Transform::list.count()), reads, time_walk * 1000000.0 / r64(iterations), time_cached * 1000000.0 / r64(iterations), (sum_walk - sum_cached).length());
+}
+#endif
+
 void game_end_cheat(b8 win)
 {
 	if (Game::level.mode == Game::Mode::Pvp && Game::session.type == SessionType::Story)
@@ -1637,6 +1897,12 @@ void Game::execute(const char* cmd)
 {
 	if (strcmp(cmd, "netstat") == 0)
 		Net::show_stats = !Net::show_stats;
+#if VI_PROFILE
+	else if (strcmp(cmd, "profile stats") == 0)
+		Profile::stats();
+	else if (strstr(cmd, "profile trace ") == cmd)
+		Profile::trace_export(cmd + strlen("profile trace "));
+#endif
 #if !SERVER
 	else if (strstr(cmd, "replay") == cmd)
 	{
@@ -1747,6 +2013,34 @@ void Game::execute(const char* cmd)
 			schedule_load_level(level, Mode::Pvp);
 		}
 	}
+	else if (strstr(cmd, "bench ") == cmd)
+	{
+		const char* name = cmd + strlen("bench ");
+		const char* delimiter = strchr(name, ' ');
+		const char* arg = delimiter ? delimiter + 1 : nullptr;
+		if (strstr(name, "compress") == name)
+			Net::benchmark_compression(arg);
+		else if (strcmp(name, "delta") == 0)
+			Net::benchmark_delta_cache();
+		else if (strcmp(name, "history") == 0)
+			Net::benchmark_history();
+		else if (strcmp(name, "posdelta") == 0)
+			Net::benchmark_position_delta();
+		else if (strcmp(name, "serialize") == 0)
+			Net::benchmark_serialize();
+		else if (strcmp(name, "ailatency") == 0)
+			AI::benchmark_latency();
+		else if (strstr(name, "astar") == name)
+			AI::Worker::benchmark_astar(arg ? s32(std::strtol(arg, nullptr, 10)) : 128);
+		else if (strcmp(name, "iterate") == 0)
+			benchmark_iteration();
+		else if (strstr(name, "transforms") == name)
+			benchmark_transforms(arg ? s32(std::strtol(arg, nullptr, 10)) : 1);
+		else if (strcmp(name, "level") == 0)
+			Loader::benchmark_levels();
+		else if (strcmp(name, "crc") == 0)
+			Net::benchmark_crc32();
+	}
 	else if (strcmp(cmd, "killai") == 0)
 	{
 		for (auto i = PlayerControlAI::list.iterator(); !i.is_last(); i.next())
@@ -1835,6 +2129,7 @@ void Game::unload_level()
 		Audio::listener_disable(i);
 
 	World::clear(); // deletes all entities
+	Spatial::clear();
 
 	// PlayerAI is not part of the entity system
 	PlayerAI::list.clear();
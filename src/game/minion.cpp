@@ -18,6 +18,7 @@
 #include "entities.h"
 #include "render/particles.h"
 #include "net.h"
+#include "spatial.h"
 #include "team.h"
 #include "parkour.h"
 #include "data/components.h"
@@ -101,9 +102,13 @@ Minion* Minion::closest(AI::TeamMask mask, const Vec3& pos, r32* distance)
 {
 	Minion* closest = nullptr;
 	r32 closest_distance = FLT_MAX;
+
+	Spatial::Result candidates;
+	Spatial::closest_candidates(pos, component_mask, mask, &candidates);
+
 	for (auto i = list.iterator(); !i.is_last(); i.next())
 	{
-		if (AI::match(i.item()->get<AIAgent>()->team, mask))
+		if (Spatial::maybe(candidates, i.item()->entity()) && AI::match(i.item()->get<AIAgent>()->team, mask))
 		{
 			r32 d = (pos - i.item()->get<Transform>()->absolute_pos()).length_squared();
 			if (d < closest_distance)
@@ -306,13 +311,17 @@ Entity* closest_target(Minion* me, AI::Team team)
 	r32 best_cost = FLT_MAX;
 	Vec3 pos = me->get<Transform>()->absolute_pos();
 
+	// can_see() won't see anything farther than this
+	Spatial::Result in_range;
+	Spatial::radius(me->head_pos(), MINION_VISION_RANGE + FORCE_FIELD_RADIUS, ~ComponentMask(0), Spatial::TeamsAny, &in_range);
+
 	for (auto i = Battery::list.iterator(); !i.is_last(); i.next())
 	{
 		Battery* item = i.item();
 		if (item->team != team && item->team != AI::TeamNone)
 		{
 			Vec3 item_pos = item->get<Transform>()->absolute_pos();
-			if (me->can_see(item->entity()))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -331,7 +340,7 @@ Entity* closest_target(Minion* me, AI::Team team)
 		Turret* item = i.item();
 		if (item->team != team)
 		{
-			if (me->can_see(item->entity(), false, false))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity(), false, false))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -348,7 +357,7 @@ Entity* closest_target(Minion* me, AI::Team team)
 		if (item->team != team)
 		{
 			Vec3 item_pos = item->get<Transform>()->absolute_pos();
-			if (me->can_see(item->entity()))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -365,7 +374,7 @@ Entity* closest_target(Minion* me, AI::Team team)
 		if (item->get<AIAgent>()->team != team)
 		{
 			Vec3 item_pos = item->get<Transform>()->absolute_pos();
-			if (me->can_see(item->entity()))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -382,7 +391,7 @@ Entity* closest_target(Minion* me, AI::Team team)
 		if (item->team != team)
 		{
 			Vec3 item_pos = item->get<Transform>()->absolute_pos();
-			if (me->can_see(item->entity()))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -399,7 +408,7 @@ Entity* closest_target(Minion* me, AI::Team team)
 		if (item->team != team && !item->has<Battery>())
 		{
 			Vec3 item_pos = item->get<Transform>()->absolute_pos();
-			if (me->can_see(item->entity()))
+			if (Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 				return item->entity();
 			r32 cost = entity_cost(me, pos, team, item->entity());
 			if (cost < best_cost)
@@ -452,12 +461,16 @@ ForceField* force_field_between_me_and_target(Minion* me)
 
 Entity* visible_target(Minion* me, AI::Team team)
 {
+	// can_see() won't see anything farther than this
+	Spatial::Result in_range;
+	Spatial::radius(me->head_pos(), MINION_VISION_RANGE + FORCE_FIELD_RADIUS, ~ComponentMask(0), Spatial::TeamsAny, &in_range);
+
 	for (auto i = PlayerCommon::list.iterator(); !i.is_last(); i.next())
 	{
 		PlayerCommon* player = i.item();
 		if (player->get<AIAgent>()->team != team)
 		{
-			if (me->can_see(player->entity(), true))
+			if (Spatial::maybe(in_range, player->entity()) && me->can_see(player->entity(), true))
 				return player->entity();
 		}
 	}
@@ -468,28 +481,28 @@ Entity* visible_target(Minion* me, AI::Team team)
 	for (auto i = Turret::list.iterator(); !i.is_last(); i.next())
 	{
 		Turret* turret = i.item();
-		if (turret->team != team && me->can_see(turret->entity()))
+		if (turret->team != team && Spatial::maybe(in_range, turret->entity()) && me->can_see(turret->entity()))
 			return turret->entity();
 	}
 
 	for (auto i = Minion::list.iterator(); !i.is_last(); i.next())
 	{
 		Minion* minion = i.item();
-		if (minion->get<AIAgent>()->team != team && me->can_see(minion->entity()))
+		if (minion->get<AIAgent>()->team != team && Spatial::maybe(in_range, minion->entity()) && me->can_see(minion->entity()))
 			return minion->entity();
 	}
 
 	for (auto i = MinionSpawner::list.iterator(); !i.is_last(); i.next())
 	{
 		MinionSpawner* item = i.item();
-		if (item->team != team && me->can_see(item->entity()))
+		if (item->team != team && Spatial::maybe(in_range, item->entity()) && me->can_see(item->entity()))
 			return item->entity();
 	}
 
 	for (auto i = Grenade::list.iterator(); !i.is_last(); i.next())
 	{
 		Grenade* grenade = i.item();
-		if (grenade->team != team && me->can_see(grenade->entity()))
+		if (grenade->team != team && Spatial::maybe(in_range, grenade->entity()) && me->can_see(grenade->entity()))
 			return grenade->entity();
 	}
 
@@ -498,6 +511,7 @@ Entity* visible_target(Minion* me, AI::Team team)
 		ForceField* field = i.item();
 		if (field->team != team
 			&& !(field->flags & ForceField::FlagInvincible)
+			&& Spatial::maybe(in_range, field->entity())
 			&& me->can_see(field->entity()))
 			return field->entity();
 	}
@@ -505,14 +519,14 @@ Entity* visible_target(Minion* me, AI::Team team)
 	for (auto i = Battery::list.iterator(); !i.is_last(); i.next())
 	{
 		Battery* battery = i.item();
-		if (battery->team != team && battery->team != AI::TeamNone && me->can_see(battery->entity()))
+		if (battery->team != team && battery->team != AI::TeamNone && Spatial::maybe(in_range, battery->entity()) && me->can_see(battery->entity()))
 			return battery->entity();
 	}
 
 	for (auto i = Rectifier::list.iterator(); !i.is_last(); i.next())
 	{
 		Rectifier* rectifier = i.item();
-		if (rectifier->team != team && !rectifier->has<Battery>() && me->can_see(rectifier->entity()))
+		if (rectifier->team != team && !rectifier->has<Battery>() && Spatial::maybe(in_range, rectifier->entity()) && me->can_see(rectifier->entity()))
 			return rectifier->entity();
 	}
 
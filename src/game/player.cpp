@@ -4214,11 +4214,12 @@ void PlayerControlHuman::update(const Update& u)
 						}
 
 						// check shields
-						for (auto i = Shield::list.iterator(); !i.is_last(); i.next())
+						for (auto i = Join<Shield, Target>::iterator(); !i.is_last(); i.next())
 						{
-							if (get<Drone>()->should_collide(i.item()->get<Target>()))
+							Target* target = i.get<Target>();
+							if (get<Drone>()->should_collide(target))
 							{
-								Vec3 shield_pos = i.item()->get<Target>()->absolute_pos();
+								Vec3 shield_pos = target->absolute_pos();
 								Vec3 intersection;
 								if (LMath::ray_sphere_intersect_flattened_plane(trace_start, trace_end, shield_pos, me, DRONE_SHIELD_RADIUS + raycast_radius, &intersection))
 								{
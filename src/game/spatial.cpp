@@ -0,0 +1,381 @@
+#include "spatial.h"
+#include "data/components.h"
+#include "entities.h"
+#include "minion.h"
+#include "drone.h"
+#include "ai.h"
+#include "game.h"
+#include "profile.h"
+#include <climits>
+
+namespace VI
+{
+
+namespace Spatial
+{
+
+#define SPATIAL_CELL_SIZE 16.0f
+#define SPATIAL_BUCKETS 1024 // power of two
+// radius(), segment(), nearest() and closest_candidates() are only exact if nothing we index moves faster than this.
+// DEBUG builds check it every build()
+#define SPATIAL_SPEED_MAX (DRONE_FLY_SPEED * 1.5f)
+#define SPATIAL_SLACK 2.0f // target offsets and the like
+#define SPATIAL_NEAREST_MAX 16
+
+struct Entry
+{
+	Vec3 pos;
+	ComponentMask components;
+	s32 cell[3];
+	ID entity;
+	AI::Team team;
+};
+
+Array<Entry> entries; // sorted by bucket
+Array<Entry> entries_unsorted;
+s32 bucket_start[SPATIAL_BUCKETS + 1];
+Bitmask<MAX_ENTITIES> indexed_mask;
+Revision indexed_revision[MAX_ENTITIES];
+s32 cell_min[3];
+s32 cell_max[3];
+r32 build_time;
+
+inline s32 cell_coord(r32 x)
+{
+	return s32(floorf(x * (1.0f / SPATIAL_CELL_SIZE)));
+}
+
+inline s32 bucket(s32 x, s32 y, s32 z)
+{
+	return s32((u32(x) * 73856093u) ^ (u32(y) * 19349663u) ^ (u32(z) * 83492791u)) & (SPATIAL_BUCKETS - 1);
+}
+
+// how far anything could have moved since the last build
+r32 padding()
+{
+	return SPATIAL_SPEED_MAX * ((Game::time.total - build_time) + Game::time.delta) + SPATIAL_SLACK;
+}
+
+inline b8 entry_match(const Entry& e, ComponentMask components, AI::TeamMask teams)
+{
+	return (e.components & components) && (teams == TeamsAny || AI::match(e.team, teams));
+}
+
+void clear()
+{
+	entries.length = 0;
+	indexed_mask.clear();
+	memset(bucket_start, 0, sizeof(bucket_start));
+}
+
+void build()
+{
+	vi_profile("Spatial::build");
+
+#if DEBUG
+	// make sure nothing still indexed outran the padding the queries gave it
+	{
+		r32 limit = SPATIAL_SPEED_MAX * (Game::time.total - build_time) + SPATIAL_SLACK;
+		for (s32 i = 0; i < entries.length; i++)
+		{
+			const Entry& entry = entries[i];
+			if (!Entity::list.active(entry.entity))
+				continue;
+			const Entity* e = &Entity::list[entry.entity];
+			if (!indexed(e) || !e->has<Transform>())
+				continue;
+			r32 moved = (e->get<Transform>()->absolute_pos() - entry.pos).length();
+			if (moved > limit)
+				vi_debug("Spatial: entity %d moved %fm between builds, more than the %fm SPATIAL_SPEED_MAX allows", s32(entry.entity), moved, limit);
+		}
+	}
+#endif
+
+	clear();
+	entries_unsorted.length = 0;
+
+	ComponentMask mask = Target::component_mask
+		| Health::component_mask
+		| ForceField::component_mask
+		| Rectifier::component_mask
+		| Battery::component_mask
+		| MinionSpawner::component_mask
+		| Grenade::component_mask;
+
+	for (s32 i = 0; i < 3; i++)
+	{
+		cell_min[i] = INT_MAX;
+		cell_max[i] = INT_MIN;
+	}
+
+	s32 counts[SPATIAL_BUCKETS] = {};
+	{
+		Transform::CacheScope transform_cache;
+		for (auto i = Entity::iterator(mask); !i.is_last(); i.next())
+		{
+			Entity* e = i.item();
+			if (!e->has<Transform>())
+				continue;
+
+			Entry* entry = entries_unsorted.add();
+			entry->pos = e->get<Transform>()->absolute_pos();
+			entry->components = e->component_mask;
+			entry->entity = i.index;
+			entry->team = AI::entity_team(e);
+			entry->cell[0] = cell_coord(entry->pos.x);
+			entry->cell[1] = cell_coord(entry->pos.y);
+			entry->cell[2] = cell_coord(entry->pos.z);
+			for (s32 j = 0; j < 3; j++)
+			{
+				cell_min[j] = vi_min(cell_min[j], entry->cell[j]);
+				cell_max[j] = vi_max(cell_max[j], entry->cell[j]);
+			}
+			counts[bucket(entry->cell[0], entry->cell[1], entry->cell[2])]++;
+
+			indexed_mask.set(i.index, true);
+			indexed_revision[i.index] = e->revision;
+		}
+	}
+
+	// counting sort into buckets
+	bucket_start[0] = 0;
+	for (s32 i = 0; i < SPATIAL_BUCKETS; i++)
+		bucket_start[i + 1] = bucket_start[i] + counts[i];
+	entries.resize(entries_unsorted.length);
+	for (s32 i = 0; i < entries_unsorted.length; i++)
+	{
+		const Entry& entry = entries_unsorted[i];
+		s32 b = bucket(entry.cell[0], entry.cell[1], entry.cell[2]);
+		counts[b]--;
+		entries[bucket_start[b] + counts[b]] = entry;
+	}
+
+	build_time = Game::time.total;
+}
+
+b8 indexed(const Entity* e)
+{
+	ID id = e->id();
+	return indexed_mask.get(id) && indexed_revision[id] == e->revision;
+}
+
+// calls the function for every entry in the given cell range, or for every entry if the range is huge
+template<typename T> void cells_foreach(const s32 lo[3], const s32 hi[3], T* fn)
+{
+	s64 cells = s64(hi[0] - lo[0] + 1) * s64(hi[1] - lo[1] + 1) * s64(hi[2] - lo[2] + 1);
+	if (cells > s64(entries.length))
+	{
+		for (s32 i = 0; i < entries.length; i++)
+			(*fn)(entries[i]);
+		return;
+	}
+
+	for (s32 x = lo[0]; x <= hi[0]; x++)
+	{
+		for (s32 y = lo[1]; y <= hi[1]; y++)
+		{
+			for (s32 z = lo[2]; z <= hi[2]; z++)
+			{
+				s32 b = bucket(x, y, z);
+				for (s32 i = bucket_start[b]; i < bucket_start[b + 1]; i++)
+				{
+					const Entry& entry = entries[i];
+					if (entry.cell[0] == x && entry.cell[1] == y && entry.cell[2] == z) // skip hash collisions
+						(*fn)(entry);
+				}
+			}
+		}
+	}
+}
+
+void bounds(const Vec3& a, const Vec3& b, r32 r, s32 lo[3], s32 hi[3])
+{
+	lo[0] = vi_max(cell_min[0], cell_coord(vi_min(a.x, b.x) - r));
+	lo[1] = vi_max(cell_min[1], cell_coord(vi_min(a.y, b.y) - r));
+	lo[2] = vi_max(cell_min[2], cell_coord(vi_min(a.z, b.z) - r));
+	hi[0] = vi_min(cell_max[0], cell_coord(vi_max(a.x, b.x) + r));
+	hi[1] = vi_min(cell_max[1], cell_coord(vi_max(a.y, b.y) + r));
+	hi[2] = vi_min(cell_max[2], cell_coord(vi_max(a.z, b.z) + r));
+}
+
+void radius(const Vec3& pos, r32 radius, ComponentMask components, AI::TeamMask teams, Result* result)
+{
+	result->clear();
+	if (entries.length == 0)
+		return;
+
+	struct Fn
+	{
+		Result* result;
+		Vec3 pos;
+		r32 radius_sq;
+		ComponentMask components;
+		AI::TeamMask teams;
+
+		void operator()(const Entry& entry)
+		{
+			if (entry_match(entry, components, teams)
+				&& (entry.pos - pos).length_squared() < radius_sq)
+				result->set(entry.entity, true);
+		}
+	};
+
+	r32 r = radius + padding();
+	Fn fn = { result, pos, r * r, components, teams };
+	s32 lo[3];
+	s32 hi[3];
+	bounds(pos, pos, r, lo, hi);
+	cells_foreach(lo, hi, &fn);
+}
+
+void segment(const Vec3& a, const Vec3& b, r32 radius, ComponentMask components, AI::TeamMask teams, Result* result)
+{
+	result->clear();
+	if (entries.length == 0)
+		return;
+
+	struct Fn
+	{
+		Result* result;
+		Vec3 a;
+		Vec3 dir;
+		r32 length;
+		r32 radius_sq;
+		ComponentMask components;
+		AI::TeamMask teams;
+
+		void operator()(const Entry& entry)
+		{
+			if (entry_match(entry, components, teams))
+			{
+				Vec3 to_entry = entry.pos - a;
+				r32 t = vi_max(0.0f, vi_min(length, to_entry.dot(dir)));
+				if ((to_entry - dir * t).length_squared() < radius_sq)
+					result->set(entry.entity, true);
+			}
+		}
+	};
+
+	Vec3 diff = b - a;
+	r32 length = diff.length();
+	r32 r = radius + padding();
+	Fn fn = { result, a, length > 0.0f ? diff / length : Vec3::zero, length, r * r, components, teams };
+	s32 lo[3];
+	s32 hi[3];
+	bounds(a, b, r, lo, hi);
+	cells_foreach(lo, hi, &fn);
+}
+
+s32 nearest(const Vec3& pos, s32 k, ComponentMask components, AI::TeamMask teams, Entity** out, r32* distances)
+{
+	vi_assert(k > 0 && k <= SPATIAL_NEAREST_MAX);
+
+	struct Fn
+	{
+		Vec3 pos;
+		ComponentMask components;
+		AI::TeamMask teams;
+		s32 k;
+		s32 count;
+		r32 distance_sq[SPATIAL_NEAREST_MAX];
+		ID entity[SPATIAL_NEAREST_MAX];
+
+		void operator()(const Entry& entry)
+		{
+			if (!entry_match(entry, components, teams))
+				return;
+			const Entity* e = &Entity::list[entry.entity];
+			if (!Entity::list.active(entry.entity) || !indexed(e))
+				return;
+
+			r32 d = (entry.pos - pos).length_squared();
+			if (count == k && d >= distance_sq[count - 1])
+				return;
+
+			// insertion sort
+			s32 i = count < k ? count++ : count - 1;
+			while (i > 0 && distance_sq[i - 1] > d)
+			{
+				distance_sq[i] = distance_sq[i - 1];
+				entity[i] = entity[i - 1];
+				i--;
+			}
+			distance_sq[i] = d;
+			entity[i] = entry.entity;
+		}
+	};
+
+	Fn fn;
+	fn.pos = pos;
+	fn.components = components;
+	fn.teams = teams;
+	fn.k = k;
+	fn.count = 0;
+
+	if (entries.length > 0)
+	{
+		// search rings of cells outward until nothing unvisited can be closer than what we have
+		s32 center[3] = { cell_coord(pos.x), cell_coord(pos.y), cell_coord(pos.z) };
+		s32 ring_max = 0;
+		for (s32 i = 0; i < 3; i++)
+			ring_max = vi_max(ring_max, vi_max(center[i] - cell_min[i], cell_max[i] - center[i]));
+
+		for (s32 ring = 0; ring <= ring_max; ring++)
+		{
+			s64 shell = ring == 0 ? 1 : (s64(2 * ring + 1) * s64(2 * ring + 1) * s64(2 * ring + 1)) - (s64(2 * ring - 1) * s64(2 * ring - 1) * s64(2 * ring - 1));
+			if (shell > s64(entries.length))
+			{
+				// the rings are getting too big to be worth it; check everything
+				fn.count = 0;
+				for (s32 i = 0; i < entries.length; i++)
+					fn(entries[i]);
+				break;
+			}
+
+			for (s32 x = center[0] - ring; x <= center[0] + ring; x++)
+			{
+				for (s32 y = center[1] - ring; y <= center[1] + ring; y++)
+				{
+					b8 edge = x == center[0] - ring || x == center[0] + ring || y == center[1] - ring || y == center[1] + ring;
+					for (s32 z = center[2] - ring; z <= center[2] + ring; z += (edge || ring == 0) ? 1 : ring * 2)
+					{
+						s32 b = bucket(x, y, z);
+						for (s32 i = bucket_start[b]; i < bucket_start[b + 1]; i++)
+						{
+							const Entry& entry = entries[i];
+							if (entry.cell[0] == x && entry.cell[1] == y && entry.cell[2] == z)
+								fn(entry);
+						}
+					}
+				}
+			}
+
+			r32 covered = r32(ring) * SPATIAL_CELL_SIZE; // everything within this distance has been visited
+			if (fn.count == k && fn.distance_sq[k - 1] <= covered * covered)
+				break;
+		}
+	}
+
+	for (s32 i = 0; i < fn.count; i++)
+	{
+		out[i] = &Entity::list[fn.entity[i]];
+		if (distances)
+			distances[i] = sqrtf(fn.distance_sq[i]);
+	}
+	return fn.count;
+}
+
+// everything that could currently be the closest match, given how far things might have moved since the build
+void closest_candidates(const Vec3& pos, ComponentMask components, AI::TeamMask teams, Result* result)
+{
+	Entity* e;
+	r32 distance;
+	if (nearest(pos, 1, components, teams, &e, &distance))
+		radius(pos, distance + padding(), components, teams, result);
+	else
+		result->clear();
+}
+
+}
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "data/entity.h"
+#include "lmath.h"
+
+namespace VI
+{
+
+// uniform hash grid over the positions of everything gameplay code asks "what's near me" about
+// rebuilt once per frame. entities keep moving after the build, so queries pad their radius
+// by however far anything could have moved since; callers still do their own exact checks.
+// the padding assumes nothing indexed moves faster than SPATIAL_SPEED_MAX (see spatial.cpp).
+// anything that teleports or outruns it can be missed until the next build
+namespace Spatial
+{
+	typedef Bitmask<MAX_ENTITIES> Result; // indexed by entity ID
+
+	const AI::TeamMask TeamsAny = AI::TeamMask(0x7f); // unlike AI::TeamAll, includes AI::TeamNone
+
+	void build();
+	void clear();
+
+	// everything within the given radius of the point
+	void radius(const Vec3&, r32, ComponentMask, AI::TeamMask, Result*);
+	// everything within the given radius of the line segment
+	void segment(const Vec3&, const Vec3&, r32, ComponentMask, AI::TeamMask, Result*);
+	// up to k entities, closest first, as of the last build. returns the number found
+	s32 nearest(const Vec3&, s32, ComponentMask, AI::TeamMask, Entity**, r32* = nullptr);
+	// superset of whatever is closest right now
+	void closest_candidates(const Vec3&, ComponentMask, AI::TeamMask, Result*);
+
+	// false if the entity was created after the last build, so it's not in any Result
+	b8 indexed(const Entity*);
+
+	// true if the entity showed up in the query, or if the query couldn't have known about it
+	inline b8 maybe(const Result& result, const Entity* e)
+	{
+		return result.get(e->id()) || !indexed(e);
+	}
+}
+
+}
@@ -20,6 +20,7 @@
 #include "overworld.h"
 #include "player.h"
 #include "common.h"
+#include "profile.h"
 
 namespace VI
 {
@@ -302,6 +303,26 @@ UpgradeInfo UpgradeInfo::list[s32(Upgrade::count)] =
 	},
 };
 
+#define VISIBILITY_TTL 0.15f // seconds a line-of-sight result is good for
+#define VISIBILITY_AGE_MAX 0.5f // past this, a result gets rechecked whether or not there's budget left
+#define VISIBILITY_MOVE_TOLERANCE 1.0f // recheck early if either end has moved this far
+#define VISIBILITY_RAYCAST_BUDGET 12 // per frame, not counting required checks
+
+// line of sight between two players' drones, shared by both directions.
+// indexed by the lower manager ID * MAX_PLAYERS + the higher one
+struct VisibilityPair
+{
+	Ref<Entity> a;
+	Ref<Entity> b;
+	Vec3 a_pos;
+	Vec3 b_pos;
+	r32 time;
+	b8 clear;
+};
+
+VisibilityPair visibility_pairs[MAX_PLAYERS * MAX_PLAYERS];
+RaycastBatch visibility_rays;
+
 void Team::awake_all()
 {
 	game_over_real_time = 0.0f;
@@ -322,7 +343,10 @@ void Team::awake_all()
 	winner = nullptr;
 	score_summary.length = 0;
 	for (s32 i = 0; i < MAX_PLAYERS * MAX_PLAYERS; i++)
+	{
 		PlayerManager::visibility[i].value = false;
+		visibility_pairs[i].a = nullptr;
+	}
 }
 
 s32 Team::teams_with_active_players()
@@ -494,25 +518,6 @@ Team* Team::with_most_energy_collected()
 	return result;
 }
 
-b8 visibility_check(Entity* i, Entity* j, r32 i_range)
-{
-	Vec3 start = i->get<Transform>()->absolute_pos();
-	Vec3 end = j->get<Transform>()->absolute_pos();
-	Vec3 diff = end - start;
-
-	r32 dist_sq = diff.length_squared();
-	if (btFuzzyZero(dist_sq))
-		return true;
-	else if (dist_sq < i_range * i_range)
-	{
-		btCollisionWorld::ClosestRayResultCallback ray_callback(start, end);
-		Physics::raycast(&ray_callback, CollisionAudio);
-		if (!ray_callback.hasHit())
-			return true;
-	}
-
-	return false;
-}
 
 // determine which rectifiers can see the given player
 void get_rectifier_visibility(b8 visibility[MAX_TEAMS], Entity* player_entity)
@@ -538,33 +543,134 @@ void get_rectifier_visibility(b8 visibility[MAX_TEAMS], Entity* player_entity)
 	}
 }
 
+// whether pair's cached line of sight can be used as-is, can wait for budget, or has to be checked now
+enum class VisibilityStatus : s8
+{
+	Fresh,
+	Stale,
+	Required,
+};
+
+VisibilityStatus visibility_status(const VisibilityPair& pair, Entity* a, Entity* b, const Vec3& a_pos, const Vec3& b_pos)
+{
+	r32 age = Game::time.total - pair.time;
+	if (pair.a.ref() != a || pair.b.ref() != b || age < 0.0f || age > VISIBILITY_AGE_MAX)
+		return VisibilityStatus::Required;
+	if (age > VISIBILITY_TTL
+		|| (a_pos - pair.a_pos).length_squared() > VISIBILITY_MOVE_TOLERANCE * VISIBILITY_MOVE_TOLERANCE
+		|| (b_pos - pair.b_pos).length_squared() > VISIBILITY_MOVE_TOLERANCE * VISIBILITY_MOVE_TOLERANCE)
+		return VisibilityStatus::Stale;
+	return VisibilityStatus::Fresh;
+}
+
 void update_visibility(const Update& u)
 {
-	// update player visibility
+	vi_profile("update_visibility");
+	Transform::CacheScope transform_cache;
+
+	Entity* entities[MAX_PLAYERS] = {};
+	Vec3 positions[MAX_PLAYERS];
+	r32 ranges[MAX_PLAYERS];
 	for (auto i = PlayerManager::list.iterator(); !i.is_last(); i.next())
 	{
-		Entity* i_entity = i.item()->instance.ref();
+		Entity* e = i.item()->instance.ref();
+		if (e)
+		{
+			entities[i.index] = e;
+			positions[i.index] = e->get<Transform>()->absolute_pos();
+			ranges[i.index] = e->has<Drone>() ? e->get<Drone>()->range() : DRONE_MAX_DISTANCE;
+		}
+	}
 
-		if (!i_entity)
+	// figure out which pairs need a raycast. pairs on the same team, or too far apart for
+	// either one to see the other, don't need one at all
+	StaticArray<s32, MAX_PLAYERS * MAX_PLAYERS / 2> stale;
+	StaticArray<s32, MAX_PLAYERS * MAX_PLAYERS / 2> checks; // pairs to raycast this frame
+	for (auto i = PlayerManager::list.iterator(); !i.is_last(); i.next())
+	{
+		ID a = i.index;
+		if (!entities[a])
 			continue;
+		Team* a_team = i.item()->team.ref();
+		for (auto j = PlayerManager::list.iterator(); !j.is_last(); j.next())
+		{
+			ID b = j.index;
+			if (b <= a || !entities[b] || j.item()->team.ref() == a_team)
+				continue;
 
-		Team* i_team = i.item()->team.ref();
+			r32 range = vi_max(ranges[a], ranges[b]);
+			r32 distance_sq = (positions[b] - positions[a]).length_squared();
+			if (btFuzzyZero(distance_sq) || distance_sq >= range * range)
+				continue;
 
-		r32 i_range = i_entity->has<Drone>() ? i_entity->get<Drone>()->range() : DRONE_MAX_DISTANCE;
+			s32 index = a * MAX_PLAYERS + b;
+			VisibilityStatus status = visibility_status(visibility_pairs[index], entities[a], entities[b], positions[a], positions[b]);
+			if (status == VisibilityStatus::Required)
+				checks.add(index);
+			else if (status == VisibilityStatus::Stale)
+				stale.add(index);
+		}
+	}
 
-		for (auto j = PlayerManager::list.iterator(); !j.is_last(); j.next())
+	// spend the budget on whichever stale pairs were checked longest ago
+	for (s32 budget = VISIBILITY_RAYCAST_BUDGET; budget > 0 && stale.length > 0; budget--)
+	{
+		s32 oldest = 0;
+		for (s32 i = 1; i < stale.length; i++)
 		{
-			Team* j_team = j.item()->team.ref();
+			if (visibility_pairs[stale[i]].time < visibility_pairs[stale[oldest]].time)
+				oldest = i;
+		}
+		checks.add(stale[oldest]);
+		stale.remove(oldest);
+	}
 
+	if (checks.length > 0)
+	{
+		visibility_rays.clear();
+		for (s32 i = 0; i < checks.length; i++)
+			visibility_rays.add(positions[checks[i] / MAX_PLAYERS], positions[checks[i] % MAX_PLAYERS], CollisionAudio);
+		Physics::raycast(&visibility_rays);
+
+		for (s32 i = 0; i < checks.length; i++)
+		{
+			s32 a = checks[i] / MAX_PLAYERS;
+			s32 b = checks[i] % MAX_PLAYERS;
+			VisibilityPair* pair = &visibility_pairs[checks[i]];
+			pair->a = entities[a];
+			pair->b = entities[b];
+			pair->a_pos = positions[a];
+			pair->b_pos = positions[b];
+			pair->time = Game::time.total;
+			pair->clear = !visibility_rays.hit(i);
+		}
+	}
+
+	// update player visibility
+	for (auto i = PlayerManager::list.iterator(); !i.is_last(); i.next())
+	{
+		ID a = i.index;
+		if (!entities[a])
+			continue;
+
+		Team* i_team = i.item()->team.ref();
+
+		for (auto j = PlayerManager::list.iterator(); !j.is_last(); j.next())
+		{
+			ID b = j.index;
 			PlayerManager::Visibility* visibility = &PlayerManager::visibility[PlayerManager::visibility_hash(i.item(), j.item())];
 
-			if (i_team == j_team)
+			if (i_team == j.item()->team.ref())
 				visibility->value = true;
+			else if (!entities[b])
+				visibility->value = false;
 			else
 			{
-				Entity* j_entity = j.item()->instance.ref();
-				if (j_entity)
-					visibility->value = visibility_check(i_entity, j_entity, i_range);
+				r32 distance_sq = (positions[b] - positions[a]).length_squared();
+				if (btFuzzyZero(distance_sq))
+					visibility->value = true;
+				else if (distance_sq < ranges[a] * ranges[a])
+					visibility->value = visibility_pairs[vi_min(a, b) * MAX_PLAYERS + vi_max(a, b)].clear;
 				else
 					visibility->value = false;
 			}
@@ -249,6 +249,7 @@ const char* arm_out_extension = ".arm";
 const char* texture_extension = ".png";
 const char* shader_extension = ".glsl";
 const char* level_out_extension = ".lvl";
+const char* level_blob_out_extension = ".lvb";
 const char* string_extension = ".json";
 
 const char* string_asset_name = "en";
@@ -753,6 +754,16 @@ b8 map_contains_value2(const Map2<T>& map, const T& t)
 	return false;
 }
 
+// level blobs aren't in the manifest; they go wherever their .lvl goes
+b8 level_blob_in_use(const Manifest& m, const std::string& filename)
+{
+	size_t extension_length = strlen(level_blob_out_extension);
+	if (filename.length() <= extension_length || filename.compare(filename.length() - extension_length, extension_length, level_blob_out_extension) != 0)
+		return false;
+	std::string level_path = filename.substr(0, filename.length() - extension_length) + level_out_extension;
+	return map_contains_value(m.levels, level_path);
+}
+
 b8 output_file_in_use(const Manifest& m, const char* filename)
 {
 	std::string filename_str = filename;
@@ -766,6 +777,7 @@ b8 output_file_in_use(const Manifest& m, const char* filename)
 		|| map_contains_value2(m.uniforms, filename_str)
 		|| map_contains_value(m.fonts, filename_str)
 		|| map_contains_value(m.levels, filename_str)
+		|| level_blob_in_use(m, filename_str)
 		|| map_contains_value(m.nav_meshes, filename_str)
 		|| map_contains_value(m.string_files, filename_str);
 }
@@ -3122,6 +3134,7 @@ void import_level(ImporterState& state, const std::string& asset_in_path, const
 	clean_name(clean_asset_name);
 	std::string asset_out_path = out_folder + clean_asset_name + level_out_extension;
 	std::string nav_mesh_out_path = out_folder + clean_asset_name + nav_mesh_out_extension;
+	std::string blob_out_path = out_folder + clean_asset_name + level_blob_out_extension;
 
 	s64 mtime = platform::filemtime(asset_in_path);
 	b8 rebuild = state.rebuild
@@ -3249,6 +3262,23 @@ void import_level(ImporterState& state, const std::string& asset_in_path, const
 		Json::json_free(json);
 #endif
 	}
+
+	// precompiled copy of the level for the game to load
+	// blob_load does the same freshness check the game does, and also catches blobs from an older format
+	cJSON* blob = rebuild ? nullptr : Json::blob_load(blob_out_path.c_str(), asset_out_path.c_str());
+	Json::json_free(blob);
+	if (!blob)
+	{
+		cJSON* json = Json::load(asset_out_path.c_str());
+		if (!json || !Json::blob_save(json, blob_out_path.c_str(), asset_out_path.c_str()))
+		{
+			fprintf(stderr, "Error: Failed to write level blob %s.\n", blob_out_path.c_str());
+			state.error = true;
+		}
+		else
+			printf("%s\n", blob_out_path.c_str());
+		Json::json_free(json);
+	}
 }
 
 b8 import_copy(ImporterState& state, Map<std::string>& manifest, const std::string& asset_in_path, const std::string& out_folder, const std::string& extension)
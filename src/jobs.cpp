@@ -0,0 +1,289 @@
+#include "jobs.h"
+#include "vi_assert.h"
+#include "lmath.h"
+#include "data/array.h"
+#include "profile.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace VI
+{
+
+namespace Jobs
+{
+
+#define JOBS_THREADS_MAX 7
+#define JOBS_QUEUE_SIZE 256 // per thread; power of two
+#define JOBS_PER_WAVE_MAX 512 // dealt round-robin, so with even one worker no queue gets more than JOBS_QUEUE_SIZE
+#define JOBS_PASSES_PER_WAVE_MAX 8
+
+struct Job
+{
+	const Pass* pass;
+	s32 begin;
+	s32 end;
+};
+
+// the jobs [begin, end) of a pass. passes too big for one wave get split across several
+struct Slice
+{
+	const Pass* pass;
+	s32 begin;
+	s32 end;
+};
+
+// the owner pushes and pops at the back, thieves take from the front
+struct Queue
+{
+	Job jobs[JOBS_QUEUE_SIZE];
+	std::mutex mutex;
+	u32 front;
+	u32 back;
+
+	Queue()
+		: jobs(), mutex(), front(), back()
+	{
+	}
+
+	void push(const Job& job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		vi_assert(back - front < JOBS_QUEUE_SIZE);
+		jobs[back % JOBS_QUEUE_SIZE] = job;
+		back++;
+	}
+
+	b8 pop(Job* job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (front == back)
+			return false;
+		back--;
+		*job = jobs[back % JOBS_QUEUE_SIZE];
+		return true;
+	}
+
+	b8 steal(Job* job)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (front == back)
+			return false;
+		*job = jobs[front % JOBS_QUEUE_SIZE];
+		front++;
+		return true;
+	}
+};
+
+// queues[0] belongs to the thread calling run()
+Queue queues[JOBS_THREADS_MAX + 1];
+StaticArray<std::thread*, JOBS_THREADS_MAX> threads;
+std::mutex mutex;
+std::condition_variable condition_work;
+std::condition_variable condition_done;
+std::atomic<s32> remaining; // unfinished jobs in the current wave
+u32 wave; // bumped every time there's new work; guarded by mutex
+b8 quit;
+
+thread_local ComponentMask writes_current = ~ComponentMask(0);
+
+void execute(const Job& job)
+{
+	vi_profile(job.pass->name);
+	writes_current = job.pass->writes;
+	job.pass->function(job.pass->context, job.begin, job.end);
+	writes_current = ~ComponentMask(0);
+}
+
+// pop our own work first, then go looking in everyone else's queue
+b8 work(s32 index)
+{
+	Job job;
+	b8 found = queues[index].pop(&job);
+	for (s32 i = 1; !found && i <= threads.length; i++)
+		found = queues[(index + i) % (threads.length + 1)].steal(&job);
+	if (!found)
+		return false;
+
+	execute(job);
+	if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		// last one; wake up run(). the lock makes sure it's either still checking remaining or already waiting
+		std::lock_guard<std::mutex> lock(mutex);
+		condition_done.notify_one();
+	}
+	return true;
+}
+
+void thread_loop(s32 index)
+{
+	vi_profile_thread("jobs");
+	u32 wave_last = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!quit && wave == wave_last)
+				condition_work.wait(lock);
+			if (quit)
+				break;
+			wave_last = wave;
+		}
+
+		// jobs never queue more jobs, so once every queue comes up empty there's nothing left for us this wave.
+		// go back to sleep rather than spinning while the last few finish somewhere else
+		while (work(index))
+		{
+		}
+	}
+}
+
+void init(s32 threads_reserved)
+{
+	quit = false;
+	s32 count = vi_max(0, vi_min(JOBS_THREADS_MAX, s32(std::thread::hardware_concurrency()) - 1 - threads_reserved));
+	for (s32 i = 0; i < count; i++)
+		threads.add(new std::thread(thread_loop, i + 1));
+}
+
+void term()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	condition_work.notify_all();
+	for (s32 i = 0; i < threads.length; i++)
+	{
+		threads[i]->join();
+		delete threads[i];
+	}
+	threads.length = 0;
+}
+
+s32 thread_count()
+{
+	return threads.length;
+}
+
+b8 writable(ComponentMask mask)
+{
+	return (writes_current & mask) == mask;
+}
+
+b8 conflict(const Pass& a, const Pass& b)
+{
+	return (a.writes & (b.reads | b.writes)) || (b.writes & a.reads);
+}
+
+s32 job_count(const Pass& pass)
+{
+	vi_assert(pass.grain > 0);
+	return (pass.count + pass.grain - 1) / pass.grain;
+}
+
+Job job_get(const Pass& pass, s32 index)
+{
+	s32 begin = index * pass.grain;
+	return { &pass, begin, vi_min(pass.count, begin + pass.grain) };
+}
+
+void run_wave(const Slice* slices, s32 count)
+{
+	s32 total = 0;
+	for (s32 i = 0; i < count; i++)
+		total += slices[i].end - slices[i].begin;
+	if (total == 0)
+		return;
+
+	if (threads.length == 0 || total == 1)
+	{
+		// not worth waking anyone up
+		for (s32 i = 0; i < count; i++)
+		{
+			const Slice& slice = slices[i];
+			for (s32 j = slice.begin; j < slice.end; j++)
+				execute(job_get(*slice.pass, j));
+		}
+		return;
+	}
+
+	remaining.store(total, std::memory_order_relaxed);
+
+	// deal the jobs out round-robin; stealing evens out whatever we get wrong
+	s32 queue = 0;
+	for (s32 i = 0; i < count; i++)
+	{
+		const Slice& slice = slices[i];
+		for (s32 j = slice.begin; j < slice.end; j++)
+		{
+			queues[queue].push(job_get(*slice.pass, j));
+			queue = (queue + 1) % (threads.length + 1);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		wave++;
+	}
+	condition_work.notify_all();
+
+	while (work(0))
+	{
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		while (remaining.load(std::memory_order_acquire) > 0)
+			condition_done.wait(lock);
+	}
+}
+
+void run(const Pass* passes, s32 count)
+{
+	vi_assert(writable(~ComponentMask(0))); // no running passes from inside a pass
+
+	// grow each wave until the next pass conflicts with something already in it,
+	// or until the queues would overflow. a pass with more jobs than fit gets split by job range;
+	// its pieces run in order, each in its own wave
+	StaticArray<Slice, JOBS_PASSES_PER_WAVE_MAX> slices;
+	s32 wave_jobs = 0;
+	for (s32 i = 0; i < count; i++)
+	{
+		const Pass& pass = passes[i];
+		b8 ok = slices.length < JOBS_PASSES_PER_WAVE_MAX;
+		for (s32 k = 0; ok && k < slices.length; k++)
+		{
+			if (conflict(*slices[k].pass, pass))
+				ok = false;
+		}
+		if (!ok)
+		{
+			run_wave(slices.data, slices.length);
+			slices.length = 0;
+			wave_jobs = 0;
+		}
+
+		s32 jobs = job_count(pass);
+		s32 begin = 0;
+		while (begin < jobs)
+		{
+			if (wave_jobs == JOBS_PER_WAVE_MAX)
+			{
+				run_wave(slices.data, slices.length);
+				slices.length = 0;
+				wave_jobs = 0;
+			}
+			s32 end = vi_min(jobs, begin + (JOBS_PER_WAVE_MAX - wave_jobs));
+			slices.add({ &pass, begin, end });
+			wave_jobs += end - begin;
+			begin = end;
+		}
+	}
+	run_wave(slices.data, slices.length);
+}
+
+}
+
+}
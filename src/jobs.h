@@ -0,0 +1,42 @@
+#pragma once
+#include "types.h"
+
+namespace VI
+{
+
+// work-stealing job system for update passes that can run on many cores at once
+// each pass declares which components it reads and writes. consecutive passes that don't
+// conflict run together; anything else waits for the passes before it to finish.
+// the calling thread works too, and run() doesn't return until everything is done.
+namespace Jobs
+{
+	// processes items [begin, end)
+	typedef void Function(void*, s32, s32);
+
+	struct Pass
+	{
+		const char* name; // must live forever; shows up in the profiler
+		Function* function;
+		void* context;
+		s32 count;
+		s32 grain; // items per job
+		ComponentMask reads;
+		ComponentMask writes;
+	};
+
+	void init(s32); // threads other systems keep busy; the pool is sized around them
+	void term();
+	s32 thread_count(); // not counting the calling thread
+
+	void run(const Pass*, s32);
+	inline void run(const Pass& pass)
+	{
+		run(&pass, 1);
+	}
+
+	// true if the current thread is allowed to write these components.
+	// always true outside of a job
+	b8 writable(ComponentMask);
+}
+
+}
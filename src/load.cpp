@@ -8,6 +8,7 @@
 #endif
 #include "cjson/cJSON.h"
 #include "data/json.h"
+#include "platform/util.h"
 #include "data/unicode.h"
 #include "ai.h"
 #include "settings.h"
@@ -1191,10 +1192,59 @@ const char* nav_mesh_path(AssetID id)
 		return mod_nav_paths[id - Loader::compiled_level_count];
 }
 
+// the importer writes a precompiled blob next to every .lvl
+void level_blob_path(AssetID id, char* out)
+{
+	const char* path = Loader::level_path(id);
+	s32 length = s32(strlen(path));
+	vi_assert(length <= MAX_PATH_LENGTH);
+	memcpy(out, path, length + 1);
+	if (length > 4 && strcmp(&out[length - 4], ".lvl") == 0)
+		memcpy(&out[length - 4], ".lvb", 4);
+	else
+		out[0] = '\0';
+}
+
 cJSON* Loader::level(AssetID id)
 {
-	return Json::load(level_path(id));
+	char path[MAX_PATH_LENGTH + 1];
+	level_blob_path(id, path);
+	cJSON* json = path[0] ? Json::blob_load(path, level_path(id)) : nullptr;
+	if (!json)
+		json = Json::load(level_path(id));
+	return json;
+}
+
+#if !RELEASE_BUILD
+void Loader::benchmark_levels()
+{
+	r64 total_json = 0.0;
+	r64 total_blob = 0.0;
+	for (AssetID i = 0; i < compiled_level_count; i++)
+	{
+		r64 start = platform::time();
+		cJSON* json = Json::load(level_path(i));
+		r64 time_json = platform::time() - start;
+		Json::json_free(json);
+
+		char path[MAX_PATH_LENGTH + 1];
+		level_blob_path(i, path);
+		start = platform::time();
+		cJSON* blob = path[0] ? Json::blob_load(path, level_path(i)) : nullptr;
+		r64 time_blob = platform::time() - start;
+		Json::json_free(blob);
+
+		if (blob)
+			vi_debug("%s: json %.3fms, blob %.3fms", level_name(i), time_json * 1000.0, time_blob * 1000.0);
+		else
+			vi_debug("%s: json %.3fms, no blob", level_name(i), time_json * 1000.0);
+		total_json += time_json;
+		if (blob)
+			total_blob += time_blob;
+	}
+	vi_debug("%d levels: json %.3fms, blob %.3fms", s32(compiled_level_count), total_json * 1000.0, total_blob * 1000.0);
 }
+#endif
 
 void Loader::level_free(cJSON* json)
 {
@@ -104,6 +104,9 @@ struct Loader
 
 	static cJSON* level(AssetID);
 	static void level_free(cJSON*);
+#if !RELEASE_BUILD
+	static void benchmark_levels();
+#endif
 
 	static void nav_mesh(AssetID, GameType);
 	static void nav_mesh_free();
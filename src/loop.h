@@ -25,6 +25,8 @@
 #endif
 
 #include "game/game.h"
+#include "game/benchmark.h"
+#include "profile.h"
 
 namespace VI
 {
@@ -1610,10 +1612,79 @@ void resolution_apply(const DisplayMode& mode)
 	resolution_current = mode;
 }
 
+#if SERVER
+// sleeps until absolute tick deadlines rather than "tick rate minus however long the update took",
+// so oversleeping on one tick doesn't push back every tick after it
+struct TickScheduler
+{
+	r64 deadline;
+	r64 report_time;
+	r64 lateness_total;
+	r64 lateness_max;
+	s32 ticks;
+	s32 overruns; // ticks that started late because the previous one ran long
+	s32 resyncs; // times we fell too far behind and gave up catching up
+
+	TickScheduler()
+		: deadline(-1.0), report_time(), lateness_total(), lateness_max(), ticks(), overruns(), resyncs()
+	{
+	}
+
+	void wait(r64 interval)
+	{
+		r64 now = platform::time();
+		if (deadline < 0.0)
+		{
+			deadline = now;
+			report_time = now + NET_TICK_STATS_INTERVAL;
+			return;
+		}
+
+		deadline += interval;
+
+		if (now > deadline + interval * r64(NET_TICK_MAX_CATCH_UP))
+		{
+			resyncs++;
+			deadline = now;
+		}
+		else if (now > deadline)
+		{
+			// behind schedule; run this tick immediately and let the next few catch up
+			overruns++;
+		}
+		else
+		{
+			if (deadline - now > NET_TICK_BUSY_WAIT)
+				platform::sleep_until(deadline - NET_TICK_BUSY_WAIT);
+			// the OS can wake us up late; spin the rest of the way
+			do
+			{
+				now = platform::time();
+			} while (now < deadline);
+		}
+
+		r64 lateness = now - deadline;
+		lateness_total += lateness;
+		lateness_max = vi_max(lateness_max, lateness);
+		ticks++;
+
+		if (now > report_time)
+		{
+			vi_debug("Tick lateness over %d ticks: mean %.3fms, max %.3fms. %d overruns, %d resyncs.", ticks, (lateness_total / r64(ticks)) * 1000.0, lateness_max * 1000.0, overruns, resyncs);
+			report_time = now + NET_TICK_STATS_INTERVAL;
+			lateness_total = 0.0;
+			lateness_max = 0.0;
+			ticks = 0;
+			overruns = 0;
+			resyncs = 0;
+		}
+	}
+};
+#endif
+
 void loop(LoopSwapper* swapper_render, PhysicsSwapper* swapper_physics)
 {
-	mersenne::srand(u32(platform::timestamp()));
-	noise::reseed();
+	vi_profile_thread("update");
 
 	LoopSync* sync_render = swapper_render->swap<SwapType::Write>();
 
@@ -1691,6 +1762,13 @@ void loop(LoopSwapper* swapper_render, PhysicsSwapper* swapper_physics)
 
 	r32 time_update = 0.0f; // time required for update
 
+#if SERVER
+	if (Benchmark::active && !Benchmark::start())
+		Game::quit = true;
+
+	TickScheduler scheduler;
+#endif
+
 	while (!Game::quit)
 	{
 		// update loop
@@ -1700,28 +1778,33 @@ void loop(LoopSwapper* swapper_render, PhysicsSwapper* swapper_physics)
 		{
 			// limit framerate
 
-			r32 dt_limit;
 #if SERVER
-			dt_limit = Net::tick_rate();
+			if (!Benchmark::active)
+				scheduler.wait(r64(Net::tick_rate()));
 #else
-			dt_limit = vi_max(1.0f / r32(Settings::framerate_limit), sync_render->input.focus ? 0.0f : (1.0f / 30.0f));
-#endif
-
+			r32 dt_limit = vi_max(1.0f / r32(Settings::framerate_limit), sync_render->input.focus ? 0.0f : (1.0f / 30.0f));
 			r32 delay = dt_limit - time_update;
 			if (delay > 0)
 				platform::sleep(delay);
+#endif
 		}
 
+		vi_profile("Loop::loop");
+
 		r64 time_update_start = platform::time();
 
 #if DEBUG
 		if (sync_render->input.keys.get(s32(KeyCode::F5)))
 			vi_assert(false);
 #endif
-		if (sync_physics)
-			sync_physics = swapper_physics->next<SwapType::Write>();
-		else
-			sync_physics = swapper_physics->get();
+		{
+			vi_profile("physics wait");
+			Benchmark::Timer timer(Benchmark::Subsystem::Physics);
+			if (sync_physics)
+				sync_physics = swapper_physics->next<SwapType::Write>();
+			else
+				sync_physics = swapper_physics->get();
+		}
 
 		Game::update(&sync_render->input, &last_input);
 
@@ -1738,10 +1821,13 @@ void loop(LoopSwapper* swapper_render, PhysicsSwapper* swapper_physics)
 		sync_render->write(true);
 		sync_render->write(true);
 
-		for (auto i = Camera::list.iterator(); !i.is_last(); i.next())
 		{
-			if (i.item()->flag(CameraFlagActive))
-				draw(sync_render, i.item());
+			Transform::CacheScope transform_cache; // nothing moves while we're drawing
+			for (auto i = Camera::list.iterator(); !i.is_last(); i.next())
+			{
+				if (i.item()->flag(CameraFlagActive))
+					draw(sync_render, i.item());
+			}
 		}
 #endif
 
@@ -1762,6 +1848,15 @@ void loop(LoopSwapper* swapper_render, PhysicsSwapper* swapper_physics)
 
 		time_update = r32(platform::time() - time_update_start);
 
+#if SERVER
+		if (Benchmark::active)
+		{
+			Benchmark::record(Benchmark::Subsystem::Tick, r64(time_update));
+			if (Benchmark::tick_done())
+				sync_render->quit = Game::quit = true;
+		}
+#endif
+
 		sync_render = swapper_render->swap<SwapType::Write>();
 		sync_render->queue.length = 0;
 	}
@@ -1,6 +1,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include "net.h"
 #include "platform/sock.h"
+#include "platform/util.h"
 #include "game/game.h"
 #if SERVER
 #include "asset/level.h"
@@ -25,6 +26,7 @@
 #include "game/overworld.h"
 #include "game/scripts.h"
 #include "game/master.h"
+#include "game/benchmark.h"
 #include "console.h"
 #include "asset/armature.h"
 #include "asset/animation.h"
@@ -144,12 +146,74 @@ enum class ServerPacket : s8
 	count,
 };
 
+// compact copy of a StateFrame as kept in the history
+// transforms are stored in columns covering only the active slots, in index order
+// positions and rotations are quantized the same way serialize_transform quantizes them for each Resolution
+struct StateFrameCompact
+{
+	Array<u64> transform_pos; // Low and Medium: packed position; High: index into transform_pos_high
+	Array<Vec3> transform_pos_high;
+	Array<u64> transform_rot; // smallest three
+	Array<Vec3> transform_target_local_offset;
+	Array<Ref<Transform>> transform_parent;
+	Array<Revision> transform_revision;
+	Array<Resolution> transform_resolution;
+	Array<WalkerState> walkers; // active walkers only, in index order
+	PlayerManagerState players[MAX_PLAYERS];
+	DroneState drones[MAX_PLAYERS];
+	ParkourStateFrame parkours[MAX_PLAYERS];
+	Bitmask<MAX_ENTITIES> transforms_active;
+	Bitmask<MAX_MINIONS * 2> walkers_active;
+	r32 timestamp;
+	SequenceID sequence_id;
+};
+
+// the most recent frame is kept in full
+// older frames are reconstructed on demand into a small LRU cache
 struct StateHistory
 {
-	StaticArray<StateFrame, NET_HISTORY_SIZE> frames;
+	StaticArray<StateFrameCompact, NET_HISTORY_SIZE> frames;
+	StateFrame latest;
+	StateFrame cache[NET_HISTORY_CACHE_SIZE];
+	s32 cache_index[NET_HISTORY_CACHE_SIZE]; // index into frames; -1 if the cache slot is empty
+	u32 cache_used[NET_HISTORY_CACHE_SIZE];
+	u32 cache_counter;
 	s32 current_index;
+
+	StateHistory();
+	~StateHistory();
 };
 
+StateHistory::StateHistory()
+	: frames(), cache_counter(), current_index()
+{
+	new (&latest) StateFrame();
+	for (s32 i = 0; i < NET_HISTORY_CACHE_SIZE; i++)
+	{
+		new (&cache[i]) StateFrame();
+		cache_index[i] = -1;
+		cache_used[i] = 0;
+	}
+}
+
+StateHistory::~StateHistory()
+{
+	// StaticArray doesn't run destructors
+	for (s32 i = 0; i < frames.length; i++)
+		frames[i].~StateFrameCompact();
+}
+
+// a state frame delta-encoded against one specific base frame
+// the server encodes each one once per tick and splices it into every client packet that shares the base
+struct StateFrameDelta
+{
+	StreamWrite stream;
+	SequenceID base; // NET_SEQUENCE_INVALID if encoded without a base
+	SequenceID base_prev; // frame before the base, used to extrapolate positions; NET_SEQUENCE_INVALID if none
+};
+
+typedef StaticArray<StateFrameDelta, MAX_PLAYERS> StateFrameDeltaCache;
+
 struct Ack
 {
 	u64 previous_sequences;
@@ -198,6 +262,8 @@ struct StatePersistent
 	Sock::Handle master_sock;
 	Master::Messenger master;
 	Sock::Address master_addr;
+	Sock::SendBatch master_outgoing; // flushed at the end of every frame
+	Sock::ReceiveBatch master_incoming;
 };
 StatePersistent state_persistent;
 
@@ -1472,6 +1538,133 @@ void calculate_rtt(r32 timestamp, const Ack& ack, const MessageHistory& send_his
 		*rtt = (*rtt * 0.95f) + (new_rtt * 0.05f);
 }
 
+// same encoding as serialize_r32_range, except it rounds to the nearest step,
+// so a value that has already been through the wire comes back out unchanged
+u32 quantize_r32(r32 value, r32 min, r32 max, s32 bits)
+{
+	u32 umax = (1 << bits) - 1;
+	r32 q = r32(umax) / (max - min);
+	r32 v = vi_max(min, vi_min(max, value));
+	return vi_min(u32(((v - min) * q) + 0.5f), umax);
+}
+
+r32 dequantize_r32(u32 u, r32 min, r32 max, s32 bits)
+{
+	u32 umax = (1 << bits) - 1;
+	r32 q = r32(umax) / (max - min);
+	return min + r32(u) / q;
+}
+
+// Low and Medium resolution only; see serialize_position
+void position_quantize(const Vec3& pos, Resolution r, s32* coords)
+{
+	vi_assert(r != Resolution::High);
+	s32 bits_xz = r == Resolution::Low ? 17 : 19;
+	s32 bits_y = r == Resolution::Low ? 12 : 14;
+	coords[0] = s32(quantize_r32(pos.x, -512, 512, bits_xz));
+	coords[1] = s32(quantize_r32(pos.y, -128, 128, bits_y));
+	coords[2] = s32(quantize_r32(pos.z, -512, 512, bits_xz));
+}
+
+Vec3 position_dequantize(const s32* coords, Resolution r)
+{
+	vi_assert(r != Resolution::High);
+	s32 bits_xz = r == Resolution::Low ? 17 : 19;
+	s32 bits_y = r == Resolution::Low ? 12 : 14;
+	return Vec3
+	(
+		dequantize_r32(u32(coords[0]), -512, 512, bits_xz),
+		dequantize_r32(u32(coords[1]), -128, 128, bits_y),
+		dequantize_r32(u32(coords[2]), -512, 512, bits_xz)
+	);
+}
+
+s32 position_bits(Resolution r, s32 axis)
+{
+	if (axis == 1)
+		return r == Resolution::Low ? 12 : 14;
+	else
+		return r == Resolution::Low ? 17 : 19;
+}
+
+u64 position_pack(const Vec3& pos, Resolution r)
+{
+	s32 coords[3];
+	position_quantize(pos, r, coords);
+	s32 bits_xz = position_bits(r, 0);
+	s32 bits_y = position_bits(r, 1);
+	return u64(coords[0]) | (u64(coords[1]) << bits_xz) | (u64(coords[2]) << (bits_xz + bits_y));
+}
+
+Vec3 position_unpack(u64 packed, Resolution r)
+{
+	s32 bits_xz = position_bits(r, 0);
+	s32 bits_y = position_bits(r, 1);
+	u64 mask_xz = (u64(1) << bits_xz) - 1;
+	u64 mask_y = (u64(1) << bits_y) - 1;
+	s32 coords[3] =
+	{
+		s32(packed & mask_xz),
+		s32((packed >> bits_xz) & mask_y),
+		s32((packed >> (bits_xz + bits_y)) & mask_xz),
+	};
+	return position_dequantize(coords, r);
+}
+
+// smallest three; see serialize_quat
+u64 rotation_pack(const Quat& rot, Resolution r)
+{
+	Quat q = Quat::normalize(rot);
+	s32 largest_index = 0; // w
+	if (fabsf(q.x) > fabsf(q[largest_index]))
+		largest_index = 1;
+	if (fabsf(q.y) > fabsf(q[largest_index]))
+		largest_index = 2;
+	if (fabsf(q.z) > fabsf(q[largest_index]))
+		largest_index = 3;
+	if (q[largest_index] < 0.0f)
+	{
+		q.w *= -1.0f;
+		q.x *= -1.0f;
+		q.y *= -1.0f;
+		q.z *= -1.0f;
+	}
+
+	s32 bits = r == Resolution::High ? 16 : 9;
+	u64 packed = u64(largest_index);
+	s32 shift = 2;
+	for (s32 i = 0; i < 4; i++)
+	{
+		if (i != largest_index)
+		{
+			packed |= u64(quantize_r32(q[i], -0.707107f, 0.707107f, bits)) << shift;
+			shift += bits;
+		}
+	}
+	return packed;
+}
+
+Quat rotation_unpack(u64 packed, Resolution r)
+{
+	s32 bits = r == Resolution::High ? 16 : 9;
+	u64 mask = (u64(1) << bits) - 1;
+	s32 largest_index = s32(packed & 3);
+	Quat q;
+	r32 sum = 0.0f;
+	s32 shift = 2;
+	for (s32 i = 0; i < 4; i++)
+	{
+		if (i != largest_index)
+		{
+			q[i] = dequantize_r32(u32((packed >> shift) & mask), -0.707107f, 0.707107f, bits);
+			sum += q[i] * q[i];
+			shift += bits;
+		}
+	}
+	q[largest_index] = sqrtf(vi_max(0.0f, 1.0f - sum));
+	return q;
+}
+
 b8 equal_states_quat(const TransformState& a, const TransformState& b)
 {
 	r32 tolerance_rot = 0.002f;
@@ -1482,11 +1675,158 @@ b8 equal_states_quat(const TransformState& a, const TransformState& b)
 	return Quat::angle(a.rot, b.rot) < tolerance_rot;
 }
 
-template<typename Stream> b8 serialize_transform(Stream* p, TransformState* transform, const TransformState* base)
+enum class PositionMode : s8
+{
+	Absolute,
+	Delta, // against the base
+	Extrapolate, // against base + (base - base_prev), scaled by how far apart the frames are
+	count,
+};
+
+// scale a quantized velocity from base_prev -> base out to base -> frame, rounding half away from zero.
+// integer math so both sides predict exactly the same thing
+s32 position_extrapolate(s32 delta, s32 ticks, s32 ticks_prev)
+{
+	s64 scaled = s64(delta) * ticks;
+	s64 half = ticks_prev / 2;
+	return s32((scaled >= 0 ? scaled + half : scaled - half) / ticks_prev);
+}
+
+#if !RELEASE_BUILD
+b8 benchmark_position_absolute; // force absolute position encoding, for comparison
+#endif
+
+#define POSITION_DELTA_BUCKETS 4
+const s32 position_delta_bucket_bits[POSITION_DELTA_BUCKETS] = { 0, 4, 8, 14 };
+
+// bits needed to encode the given delta; -1 if it doesn't fit
+s32 position_delta_cost(s32 delta)
+{
+	u32 zigzag = (u32(delta) << 1) ^ u32(delta >> 31);
+	for (s32 i = 0; i < POSITION_DELTA_BUCKETS; i++)
+	{
+		if (zigzag < (u32(1) << position_delta_bucket_bits[i]))
+			return 2 + position_delta_bucket_bits[i];
+	}
+	return -1;
+}
+
+// 2-bit bucket, followed by a zigzag-encoded delta of 0, 4, 8 or 14 bits
+template<typename Stream> b8 serialize_position_delta(Stream* p, s32* value, s32 predicted, s32 max)
+{
+	u32 zigzag;
+	s32 bucket;
+	if (Stream::IsWriting)
+	{
+		s32 delta = *value - predicted;
+		zigzag = (u32(delta) << 1) ^ u32(delta >> 31);
+		bucket = 0;
+		while (zigzag >= (u32(1) << position_delta_bucket_bits[bucket]))
+			bucket++;
+	}
+	serialize_int(p, s32, bucket, 0, POSITION_DELTA_BUCKETS - 1);
+	if (position_delta_bucket_bits[bucket] > 0)
+		serialize_bits(p, u32, zigzag, position_delta_bucket_bits[bucket]);
+	else
+		zigzag = 0;
+	if (Stream::IsReading)
+	{
+		*value = predicted + (s32(zigzag >> 1) ^ -s32(zigzag & 1));
+		if (*value < 0 || *value > max)
+			net_error();
+	}
+	return true;
+}
+
+// base_prev is only given if it has the same revision, parent, and resolution as base
+// ticks: sequences from base to this frame. ticks_prev: sequences from base_prev to base
+template<typename Stream> b8 serialize_transform(Stream* p, TransformState* transform, const TransformState* base, const TransformState* base_prev, s32 ticks = 1, s32 ticks_prev = 1)
 {
 	serialize_enum(p, Resolution, transform->resolution);
-	if (!serialize_position(p, &transform->pos, transform->resolution))
-		net_error();
+	if (transform->resolution == Resolution::High)
+	{
+		if (!serialize_position(p, &transform->pos, transform->resolution))
+			net_error();
+	}
+	else
+	{
+		// work in quantized coordinates, so that both sides predict exactly the same thing
+		s32 coords[3];
+		if (Stream::IsWriting)
+			position_quantize(transform->pos, transform->resolution, coords);
+
+		s32 predictions[s32(PositionMode::count)][3];
+		b8 has_base = base && base->resolution == transform->resolution;
+		b8 has_base_prev = has_base && base_prev && base_prev->resolution == transform->resolution;
+		if (has_base)
+		{
+			position_quantize(base->pos, base->resolution, predictions[s32(PositionMode::Delta)]);
+			if (has_base_prev)
+			{
+				s32 prev[3];
+				position_quantize(base_prev->pos, base_prev->resolution, prev);
+				for (s32 i = 0; i < 3; i++)
+				{
+					s32 max = (1 << position_bits(transform->resolution, i)) - 1;
+					s32 base_coord = predictions[s32(PositionMode::Delta)][i];
+					predictions[s32(PositionMode::Extrapolate)][i] = vi_max(0, vi_min(max, base_coord + position_extrapolate(base_coord - prev[i], ticks, ticks_prev)));
+				}
+			}
+		}
+
+		PositionMode mode = PositionMode::Absolute;
+		if (has_base)
+		{
+			if (Stream::IsWriting)
+			{
+				// pick the cheapest encoding
+				s32 best_cost = position_bits(transform->resolution, 0) * 2 + position_bits(transform->resolution, 1);
+				for (s32 m = s32(PositionMode::Delta); m <= s32(has_base_prev ? PositionMode::Extrapolate : PositionMode::Delta); m++)
+				{
+					s32 cost = 0;
+					for (s32 i = 0; i < 3; i++)
+					{
+						s32 c = position_delta_cost(coords[i] - predictions[m][i]);
+						if (c == -1)
+						{
+							cost = -1;
+							break;
+						}
+						cost += c;
+					}
+					if (cost != -1 && cost < best_cost)
+					{
+						best_cost = cost;
+						mode = PositionMode(m);
+					}
+				}
+#if !RELEASE_BUILD
+				if (benchmark_position_absolute)
+					mode = PositionMode::Absolute;
+#endif
+			}
+			serialize_enum(p, PositionMode, mode);
+			if (mode == PositionMode::Extrapolate && !has_base_prev)
+				net_error();
+		}
+
+		if (mode == PositionMode::Absolute)
+		{
+			for (s32 i = 0; i < 3; i++)
+				serialize_int(p, s32, coords[i], 0, (1 << position_bits(transform->resolution, i)) - 1);
+		}
+		else
+		{
+			for (s32 i = 0; i < 3; i++)
+			{
+				if (!serialize_position_delta(p, &coords[i], predictions[s32(mode)][i], (1 << position_bits(transform->resolution, i)) - 1))
+					net_error();
+			}
+		}
+
+		if (Stream::IsReading)
+			transform->pos = position_dequantize(coords, transform->resolution);
+	}
 
 	b8 b;
 	if (Stream::IsWriting)
@@ -1622,17 +1962,22 @@ template<typename Stream> b8 serialize_player_manager(Stream* p, PlayerManagerSt
 
 b8 equal_states_transform(const TransformState& a, const TransformState& b)
 {
-	r32 tolerance_pos = 0.008f;
-	if (a.resolution == Resolution::Medium || b.resolution == Resolution::Medium)
-		tolerance_pos = 0.002f;
-	if (a.resolution == Resolution::High || b.resolution == Resolution::High)
-		tolerance_pos = 0.001f;
-
 	if (a.revision == b.revision
 		&& a.resolution == b.resolution
 		&& a.parent.equals(b.parent)
 		&& equal_states_quat(a, b))
 	{
+		if (a.resolution != Resolution::High)
+		{
+			// positions are delta-encoded in the quantized domain, so compare exactly what goes over the wire
+			s32 coords_a[3];
+			s32 coords_b[3];
+			position_quantize(a.pos, a.resolution, coords_a);
+			position_quantize(b.pos, b.resolution, coords_b);
+			return coords_a[0] == coords_b[0] && coords_a[1] == coords_b[1] && coords_a[2] == coords_b[2];
+		}
+
+		r32 tolerance_pos = 0.001f;
 		return s32(a.pos.x / tolerance_pos) == s32(b.pos.x / tolerance_pos)
 			&& s32(a.pos.y / tolerance_pos) == s32(b.pos.y / tolerance_pos)
 			&& s32(a.pos.z / tolerance_pos) == s32(b.pos.z / tolerance_pos);
@@ -1698,7 +2043,65 @@ b8 equal_states_parkour(const StateFrame* frame_a, const StateFrame* frame_b, s3
 	return false;
 }
 
-template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame, const StateFrame* base)
+// a transform one client has a different position and rotation for than the shared state history
+struct TransformOverride
+{
+	Quat rot;
+	Vec3 pos;
+	ID index;
+};
+
+typedef StaticArray<TransformOverride, NET_RELEVANCE_MAX_OVERRIDES> TransformOverrides;
+
+// lets the server write a delta for what one client actually has, without copying the shared frames to patch them
+struct StateFrameOverrides
+{
+	Bitmask<MAX_ENTITIES> mask; // every index overridden in any of the lists
+	const TransformOverrides* frame;
+	const TransformOverrides* base;
+	const TransformOverrides* base_prev;
+};
+
+const TransformState& transform_override(const TransformState& state, const TransformOverrides* overrides, s32 index, TransformState* scratch)
+{
+	if (overrides)
+	{
+		for (s32 i = 0; i < overrides->length; i++)
+		{
+			const TransformOverride& o = (*overrides)[i];
+			if (o.index == index)
+			{
+				*scratch = state;
+				scratch->pos = o.pos;
+				scratch->rot = o.rot;
+				return *scratch;
+			}
+		}
+	}
+	return state;
+}
+
+b8 equal_states_transform(const StateFrame* a, const StateFrame* b, s32 index, const StateFrameOverrides* overrides)
+{
+	if (!overrides || !overrides->mask.get(index))
+		return equal_states_transform(a, b, index);
+
+	if (!a || !b || a->transforms_active.get(index) != b->transforms_active.get(index))
+		return false;
+	if (!a->transforms_active.get(index))
+		return true;
+	TransformState scratch_a;
+	TransformState scratch_b;
+	return equal_states_transform
+	(
+		transform_override(a->transforms[index], overrides->frame, index, &scratch_a),
+		transform_override(b->transforms[index], overrides->base, index, &scratch_b)
+	);
+}
+
+// base_prev is the client's frame before base, if it has one
+// overrides only apply when writing
+template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame, const StateFrame* base, const StateFrame* base_prev = nullptr, const StateFrameOverrides* overrides = nullptr)
 {
 	if (Stream::IsReading)
 	{
@@ -1713,6 +2116,17 @@ template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame,
 
 	// transforms
 	{
+		// the client doesn't ack every frame, so the gaps between base_prev, base and this frame vary
+		s32 ticks = 1;
+		s32 ticks_prev = 1;
+		if (base && base_prev)
+		{
+			ticks = sequence_relative_to(frame->sequence_id, base->sequence_id);
+			ticks_prev = sequence_relative_to(base->sequence_id, base_prev->sequence_id);
+			if (ticks <= 0 || ticks_prev <= 0)
+				base_prev = nullptr;
+		}
+
 		s32 changed_count;
 		if (Stream::IsWriting)
 		{
@@ -1721,7 +2135,7 @@ template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame,
 			s32 index = vi_min(s32(frame->transforms_active.start), base ? s32(base->transforms_active.start) : MAX_ENTITIES - 1);
 			while (index < vi_max(s32(frame->transforms_active.end), base ? s32(base->transforms_active.end) : 0))
 			{
-				if (!equal_states_transform(frame, base, index))
+				if (!equal_states_transform(frame, base, index, overrides))
 					changed_count++;
 				index++;
 			}
@@ -1735,7 +2149,7 @@ template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame,
 		{
 			if (Stream::IsWriting)
 			{
-				while (equal_states_transform(frame, base, index))
+				while (equal_states_transform(frame, base, index, overrides))
 					index++;
 			}
 
@@ -1762,7 +2176,34 @@ template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame,
 				serialize_bool(p, parent_changed);
 				if (parent_changed)
 					serialize_ref(p, frame->transforms[index].parent);
-				if (!serialize_transform(p, &frame->transforms[index], (base && !revision_changed) ? &base->transforms[index] : nullptr))
+				// overrides only touch position and rotation, so everything above is the same either way
+				TransformState* transform = &frame->transforms[index];
+				TransformState scratch_transform;
+				TransformState scratch_base;
+				TransformState scratch_base_prev;
+				b8 overridden = Stream::IsWriting && overrides && overrides->mask.get(index);
+				if (overridden)
+				{
+					scratch_transform = transform_override(*transform, overrides->frame, index, &scratch_transform);
+					transform = &scratch_transform;
+				}
+				const TransformState* transform_base = nullptr;
+				const TransformState* transform_base_prev = nullptr;
+				if (base && !revision_changed && base->transforms_active.get(index))
+				{
+					transform_base = &base->transforms[index];
+					if (overridden)
+						transform_base = &transform_override(*transform_base, overrides->base, index, &scratch_base);
+					if (base_prev && base_prev->transforms_active.get(index))
+					{
+						const TransformState* prev = &base_prev->transforms[index];
+						if (prev->revision == transform_base->revision
+							&& prev->resolution == transform_base->resolution
+							&& prev->parent.equals(transform_base->parent))
+							transform_base_prev = overridden ? &transform_override(*prev, overrides->base_prev, index, &scratch_base_prev) : prev;
+					}
+				}
+				if (!serialize_transform(p, transform, transform_base, transform_base_prev, ticks, ticks_prev))
 					net_error();
 			}
 
@@ -1864,6 +2305,31 @@ template<typename Stream> b8 serialize_state_frame(Stream* p, StateFrame* frame,
 	return true;
 }
 
+// returns the encoded (frame, base) delta, encoding it only if no other client has asked for the same base yet
+// the cache must be cleared whenever the frame changes
+const StreamWrite* state_frame_delta(StateFrameDeltaCache* cache, StateFrame* frame, const StateFrame* base, const StateFrame* base_prev)
+{
+	SequenceID base_sequence_id = base ? base->sequence_id : NET_SEQUENCE_INVALID;
+	SequenceID base_prev_sequence_id = base_prev ? base_prev->sequence_id : NET_SEQUENCE_INVALID;
+	for (s32 i = 0; i < cache->length; i++)
+	{
+		if ((*cache)[i].base == base_sequence_id && (*cache)[i].base_prev == base_prev_sequence_id)
+			return &(*cache)[i].stream;
+	}
+
+	vi_assert(cache->length < cache->capacity());
+	StateFrameDelta* delta = cache->add();
+	delta->base = base_sequence_id;
+	delta->base_prev = base_prev_sequence_id;
+	delta->stream.reset();
+	if (!serialize_state_frame(&delta->stream, frame, base, base_prev))
+	{
+		cache->length--;
+		return nullptr;
+	}
+	return &delta->stream;
+}
+
 Resolution transform_resolution(const Transform* t)
 {
 	if (t->has<Drone>())
@@ -1879,6 +2345,8 @@ r32 quantized_rotation(r32 r)
 
 void state_frame_build(StateFrame* frame)
 {
+	Transform::CacheScope transform_cache;
+
 	frame->sequence_id = state_common.local_sequence_id;
 
 	// transforms
@@ -2027,6 +2495,69 @@ void animation_layer_interpolate(const AnimationLayer& last, const AnimationLaye
 	}
 }
 
+void transform_state_interpolate(const StateFrame& a, const StateFrame& b, s32 index, TransformState* transform, r32 blend)
+{
+	const TransformState& last = a.transforms[index];
+	const TransformState& next = b.transforms[index];
+
+	transform->parent = next.parent;
+	transform->revision = next.revision;
+
+	if (last.revision == next.revision)
+	{
+		if (last.parent.id == next.parent.id)
+		{
+			transform->pos = Vec3::lerp(blend, last.pos, next.pos);
+			transform->rot = Quat::slerp(blend, last.rot, next.rot);
+			transform->target_local_offset = Vec3::lerp(blend, last.target_local_offset, next.target_local_offset);
+		}
+		else
+		{
+			Vec3 last_pos;
+			Quat last_rot;
+			transform_absolute(a, index, &last_pos, &last_rot);
+
+			if (next.parent.id != IDNull)
+				transform_absolute_to_relative(b, next.parent.id, &last_pos, &last_rot);
+
+			transform->pos = Vec3::lerp(blend, last_pos, next.pos);
+			transform->rot = Quat::slerp(blend, last_rot, next.rot);
+			transform->target_local_offset = Vec3::lerp(blend, last.target_local_offset, next.target_local_offset);
+		}
+	}
+	else
+	{
+		transform->pos = next.pos;
+		transform->rot = next.rot;
+		transform->target_local_offset = next.target_local_offset;
+	}
+}
+
+void drone_state_interpolate(const DroneState& last, const DroneState& next, DroneState* drone, r32 blend)
+{
+	drone->active = next.active;
+	if (drone->active)
+	{
+		drone->revision = next.revision;
+		if (last.revision == next.revision)
+		{
+			drone->cooldown = LMath::lerpf(blend, last.cooldown, next.cooldown);
+			drone->cooldown_ability_switch = LMath::lerpf(blend, last.cooldown_ability_switch, next.cooldown_ability_switch);
+			drone->angle_horizontal = LMath::angle_range(LMath::lerpf(blend, last.angle_horizontal, LMath::closest_angle(next.angle_horizontal, last.angle_horizontal)));
+			drone->angle_vertical = LMath::angle_range(LMath::lerpf(blend, last.angle_vertical, LMath::closest_angle(next.angle_vertical, last.angle_vertical)));
+		}
+		else
+		{
+			drone->angle_horizontal = next.angle_horizontal;
+			drone->angle_vertical = next.angle_vertical;
+			drone->cooldown = next.cooldown;
+			drone->cooldown_ability_switch = next.cooldown_ability_switch;
+		}
+
+		drone->collision_state = next.collision_state;
+	}
+}
+
 void state_frame_interpolate(const StateFrame& a, const StateFrame& b, StateFrame* result, r32 timestamp)
 {
 	result->timestamp = timestamp;
@@ -2040,41 +2571,7 @@ void state_frame_interpolate(const StateFrame& a, const StateFrame& b, StateFram
 		s32 index = s32(b.transforms_active.start);
 		while (index < b.transforms_active.end)
 		{
-			TransformState* transform = &result->transforms[index];
-			const TransformState& last = a.transforms[index];
-			const TransformState& next = b.transforms[index];
-
-			transform->parent = next.parent;
-			transform->revision = next.revision;
-
-			if (last.revision == next.revision)
-			{
-				if (last.parent.id == next.parent.id)
-				{
-					transform->pos = Vec3::lerp(blend, last.pos, next.pos);
-					transform->rot = Quat::slerp(blend, last.rot, next.rot);
-					transform->target_local_offset = Vec3::lerp(blend, last.target_local_offset, next.target_local_offset);
-				}
-				else
-				{
-					Vec3 last_pos;
-					Quat last_rot;
-					transform_absolute(a, index, &last_pos, &last_rot);
-
-					if (next.parent.id != IDNull)
-						transform_absolute_to_relative(b, next.parent.id, &last_pos, &last_rot);
-
-					transform->pos = Vec3::lerp(blend, last_pos, next.pos);
-					transform->rot = Quat::slerp(blend, last_rot, next.rot);
-					transform->target_local_offset = Vec3::lerp(blend, last.target_local_offset, next.target_local_offset);
-				}
-			}
-			else
-			{
-				transform->pos = next.pos;
-				transform->rot = next.rot;
-				transform->target_local_offset = next.target_local_offset;
-			}
+			transform_state_interpolate(a, b, index, &result->transforms[index], blend);
 			index = b.transforms_active.next(index);
 		}
 	}
@@ -2123,33 +2620,7 @@ void state_frame_interpolate(const StateFrame& a, const StateFrame& b, StateFram
 
 	// drones
 	for (s32 index = 0; index < MAX_PLAYERS; index++)
-	{
-		DroneState* drone = &result->drones[index];
-		const DroneState& last = a.drones[index];
-		const DroneState& next = b.drones[index];
-
-		drone->active = next.active;
-		if (drone->active)
-		{
-			drone->revision = next.revision;
-			if (last.revision == next.revision)
-			{
-				drone->cooldown = LMath::lerpf(blend, last.cooldown, next.cooldown);
-				drone->cooldown_ability_switch = LMath::lerpf(blend, last.cooldown_ability_switch, next.cooldown_ability_switch);
-				drone->angle_horizontal = LMath::angle_range(LMath::lerpf(blend, last.angle_horizontal, LMath::closest_angle(next.angle_horizontal, last.angle_horizontal)));
-				drone->angle_vertical = LMath::angle_range(LMath::lerpf(blend, last.angle_vertical, LMath::closest_angle(next.angle_vertical, last.angle_vertical)));
-			}
-			else
-			{
-				drone->angle_horizontal = next.angle_horizontal;
-				drone->angle_vertical = next.angle_vertical;
-				drone->cooldown = next.cooldown;
-				drone->cooldown_ability_switch = next.cooldown_ability_switch;
-			}
-
-			drone->collision_state = next.collision_state;
-		}
-	}
+		drone_state_interpolate(a.drones[index], b.drones[index], &result->drones[index], blend);
 
 	// parkours
 	for (s32 i = 0; i < MAX_PLAYERS; i++)
@@ -2171,82 +2642,245 @@ void state_frame_interpolate(const StateFrame& a, const StateFrame& b, StateFram
 	}
 }
 
+// reset a frame for reuse, only touching the transform slots that were in use
+void state_frame_clear(StateFrame* frame)
+{
+	s32 index = s32(frame->transforms_active.start);
+	while (index < frame->transforms_active.end)
+	{
+		frame->transforms[index] = TransformState();
+		index = frame->transforms_active.next(index);
+	}
+	frame->transforms_active.clear();
+	frame->walkers_active.clear();
+	memset(frame->players, 0, sizeof(frame->players));
+	memset(frame->walkers, 0, sizeof(frame->walkers));
+	memset(frame->drones, 0, sizeof(frame->drones));
+	memset(frame->parkours, 0, sizeof(frame->parkours));
+	frame->timestamp = 0.0f;
+	frame->sequence_id = 0;
+}
+
+void state_frame_compress(const StateFrame& frame, StateFrameCompact* compact)
+{
+	compact->timestamp = frame.timestamp;
+	compact->sequence_id = frame.sequence_id;
+
+	// transforms
+	{
+		compact->transforms_active = frame.transforms_active;
+		compact->transform_pos.length = 0;
+		compact->transform_pos_high.length = 0;
+		compact->transform_rot.length = 0;
+		compact->transform_target_local_offset.length = 0;
+		compact->transform_parent.length = 0;
+		compact->transform_revision.length = 0;
+		compact->transform_resolution.length = 0;
+		s32 index = s32(frame.transforms_active.start);
+		while (index < frame.transforms_active.end)
+		{
+			const TransformState& transform = frame.transforms[index];
+			if (transform.resolution == Resolution::High)
+			{
+				compact->transform_pos.add(u64(compact->transform_pos_high.length));
+				compact->transform_pos_high.add(transform.pos);
+			}
+			else
+				compact->transform_pos.add(position_pack(transform.pos, transform.resolution));
+			compact->transform_rot.add(rotation_pack(transform.rot, transform.resolution));
+			compact->transform_target_local_offset.add(transform.target_local_offset);
+			compact->transform_parent.add(transform.parent);
+			compact->transform_revision.add(transform.revision);
+			compact->transform_resolution.add(transform.resolution);
+			index = frame.transforms_active.next(index);
+		}
+	}
+
+	// walkers
+	{
+		compact->walkers_active = frame.walkers_active;
+		compact->walkers.length = 0;
+		s32 index = s32(frame.walkers_active.start);
+		while (index < frame.walkers_active.end)
+		{
+			compact->walkers.add(frame.walkers[index]);
+			index = frame.walkers_active.next(index);
+		}
+	}
+
+	memcpy(compact->players, frame.players, sizeof(compact->players));
+	memcpy(compact->drones, frame.drones, sizeof(compact->drones));
+	memcpy(compact->parkours, frame.parkours, sizeof(compact->parkours));
+}
+
+void state_frame_decompress(const StateFrameCompact& compact, StateFrame* frame)
+{
+	state_frame_clear(frame);
+	frame->timestamp = compact.timestamp;
+	frame->sequence_id = compact.sequence_id;
+
+	// transforms
+	{
+		frame->transforms_active = compact.transforms_active;
+		s32 column = 0;
+		s32 index = s32(compact.transforms_active.start);
+		while (index < compact.transforms_active.end)
+		{
+			TransformState* transform = &frame->transforms[index];
+			transform->resolution = compact.transform_resolution[column];
+			if (transform->resolution == Resolution::High)
+				transform->pos = compact.transform_pos_high[s32(compact.transform_pos[column])];
+			else
+				transform->pos = position_unpack(compact.transform_pos[column], transform->resolution);
+			transform->rot = rotation_unpack(compact.transform_rot[column], transform->resolution);
+			transform->target_local_offset = compact.transform_target_local_offset[column];
+			transform->parent = compact.transform_parent[column];
+			transform->revision = compact.transform_revision[column];
+			column++;
+			index = compact.transforms_active.next(index);
+		}
+	}
+
+	// walkers
+	{
+		frame->walkers_active = compact.walkers_active;
+		s32 column = 0;
+		s32 index = s32(compact.walkers_active.start);
+		while (index < compact.walkers_active.end)
+		{
+			frame->walkers[index] = compact.walkers[column];
+			column++;
+			index = compact.walkers_active.next(index);
+		}
+	}
+
+	memcpy(frame->players, compact.players, sizeof(frame->players));
+	memcpy(frame->drones, compact.drones, sizeof(frame->drones));
+	memcpy(frame->parkours, compact.parkours, sizeof(frame->parkours));
+}
+
+// returns the full frame to fill in; call state_frame_commit once it's done
 StateFrame* state_frame_add(StateHistory* history)
 {
-	StateFrame* frame;
 	if (history->frames.length < history->frames.capacity())
 	{
-		frame = history->frames.add();
+		history->frames.add();
 		history->current_index = history->frames.length - 1;
 	}
 	else
-	{
 		history->current_index = (history->current_index + 1) % history->frames.capacity();
-		frame = &history->frames[history->current_index];
+
+	// this slot is about to be overwritten
+	for (s32 i = 0; i < NET_HISTORY_CACHE_SIZE; i++)
+	{
+		if (history->cache_index[i] == history->current_index)
+			history->cache_index[i] = -1;
 	}
-	new (frame) StateFrame();
+
+	StateFrame* frame = &history->latest;
+	state_frame_clear(frame);
 	frame->timestamp = state_common.timestamp;
 	return frame;
 }
 
-const StateFrame* state_frame_by_sequence(const StateHistory& history, SequenceID sequence_id)
+void state_frame_commit(StateHistory* history)
 {
-	if (history.frames.length > 0)
+	state_frame_compress(history->latest, &history->frames[history->current_index]);
+}
+
+const StateFrame* state_frame_get(StateHistory* history, s32 index)
+{
+	if (index == history->current_index)
+		return &history->latest;
+
+	history->cache_counter++;
+	s32 lru = 0;
+	for (s32 i = 0; i < NET_HISTORY_CACHE_SIZE; i++)
 	{
-		s32 index = history.current_index;
+		if (history->cache_index[i] == index)
+		{
+			history->cache_used[i] = history->cache_counter;
+			return &history->cache[i];
+		}
+		if (history->cache_used[i] < history->cache_used[lru])
+			lru = i;
+	}
+
+	state_frame_decompress(history->frames[index], &history->cache[lru]);
+	history->cache_index[lru] = index;
+	history->cache_used[lru] = history->cache_counter;
+	return &history->cache[lru];
+}
+
+// index into history->frames of a frame returned by state_frame_get
+s32 state_frame_index(const StateHistory& history, const StateFrame& frame)
+{
+	if (&frame == &history.latest)
+		return history.current_index;
+	for (s32 i = 0; i < NET_HISTORY_CACHE_SIZE; i++)
+	{
+		if (&frame == &history.cache[i])
+			return history.cache_index[i];
+	}
+	vi_assert(false);
+	return -1;
+}
+
+const StateFrame* state_frame_by_sequence(StateHistory* history, SequenceID sequence_id)
+{
+	if (history->frames.length > 0)
+	{
+		s32 index = history->current_index;
 		for (s32 i = 0; i < NET_PREVIOUS_SEQUENCES_SEARCH; i++)
 		{
-			const StateFrame* frame = &history.frames[index];
-			if (frame->sequence_id == sequence_id)
-				return frame;
+			if (history->frames[index].sequence_id == sequence_id)
+				return state_frame_get(history, index);
 
 			// loop backward through most recent frames
-			index = index > 0 ? index - 1 : history.frames.length - 1;
-			if (index == history.current_index || history.frames[index].timestamp < state_common.timestamp - NET_TIMEOUT) // hit the end
+			index = index > 0 ? index - 1 : history->frames.length - 1;
+			if (index == history->current_index || history->frames[index].timestamp < state_common.timestamp - NET_TIMEOUT) // hit the end
 				break;
 		}
 	}
 	return nullptr;
 }
 
-const StateFrame* state_frame_by_timestamp(const StateHistory& history, r32 timestamp)
+const StateFrame* state_frame_by_timestamp(StateHistory* history, r32 timestamp)
 {
-	if (history.frames.length > 0)
+	if (history->frames.length > 0)
 	{
-		s32 index = history.current_index;
+		s32 index = history->current_index;
 		for (s32 i = 0; i < NET_PREVIOUS_SEQUENCES_SEARCH; i++)
 		{
-			const StateFrame* frame = &history.frames[index];
-
-			if (frame->timestamp < timestamp)
-				return &history.frames[index];
+			if (history->frames[index].timestamp < timestamp)
+				return state_frame_get(history, index);
 
 			// loop backward through most recent frames
-			index = index > 0 ? index - 1 : history.frames.length - 1;
-			if (index == history.current_index || history.frames[index].timestamp < state_common.timestamp - NET_TIMEOUT) // hit the end
+			index = index > 0 ? index - 1 : history->frames.length - 1;
+			if (index == history->current_index || history->frames[index].timestamp < state_common.timestamp - NET_TIMEOUT) // hit the end
 				break;
 		}
 	}
 	return nullptr;
 }
 
-const StateFrame* state_frame_next(const StateHistory& history, const StateFrame& frame)
+const StateFrame* state_frame_next(StateHistory* history, const StateFrame& frame)
 {
-	if (history.frames.length > 1)
+	if (history->frames.length > 1)
 	{
-		s32 current_index = s32(&frame - history.frames.data);
+		s32 current_index = state_frame_index(*history, frame);
 		s32 index = current_index;
 		while (true)
 		{
 			// search forward
-			index = (index == history.frames.length - 1) ? 0 : (index + 1);
+			index = (index == history->frames.length - 1) ? 0 : (index + 1);
 
 			if (index == current_index) // hit the end
 				break;
 
-			const StateFrame* f = &history.frames[index];
-			if (f->timestamp > frame.timestamp - NET_TIMEOUT && sequence_more_recent(f->sequence_id, frame.sequence_id))
-				return f;
+			const StateFrameCompact& f = history->frames[index];
+			if (f.timestamp > frame.timestamp - NET_TIMEOUT && sequence_more_recent(f.sequence_id, frame.sequence_id))
+				return state_frame_get(history, index);
 		}
 	}
 	return nullptr;
@@ -2300,6 +2934,25 @@ b8 master_user_role_set(u32 server_id, u32 user_id, Master::Role role)
 namespace Server
 {
 
+struct RelevanceRecord
+{
+	TransformOverrides overrides; // transforms we deferred, so the client still has an older value for them
+	SequenceID sequence_id;
+};
+
+// what we've actually sent this client, relative to the shared state history
+// indexed by sequence_id % NET_RELEVANCE_HISTORY
+struct ClientRelevance
+{
+	RelevanceRecord records[NET_RELEVANCE_HISTORY];
+
+	ClientRelevance()
+	{
+		for (s32 i = 0; i < NET_RELEVANCE_HISTORY; i++)
+			records[i].sequence_id = NET_SEQUENCE_INVALID;
+	}
+};
+
 struct Client
 {
 	enum Flags : s8
@@ -2332,6 +2985,8 @@ struct Client
 	MessageFrameState processed_msg_frame = { NET_SEQUENCE_COUNT - 1, true };
 	SequenceID first_load_sequence;
 	SequenceID acked_state_frame = NET_SEQUENCE_INVALID; // most recent state frame the client has acked
+	SequenceID acked_state_frame_previous = NET_SEQUENCE_INVALID; // the frame before that in the client's history
+	ClientRelevance* relevance;
 	char username[MAX_USERNAME + 1];
 	s8 flags = FlagLowLatencyInterpolation;
 
@@ -2379,6 +3034,9 @@ struct StateServer
 	r32 master_timer;
 	r32 idle_timer = NET_SERVER_IDLE_TIME;
 	Sock::Address replay_address;
+	StateFrameDeltaCache state_frame_deltas; // cleared every tick
+	StateFrameOverrides relevance_overrides; // scratch
+	StreamWrite relevance_stream; // scratch
 	b8 transitioning_level;
 };
 StateServer state_server;
@@ -2529,6 +3187,7 @@ void init()
 		fprintf(stderr, "%s\n", Sock::get_error());
 		vi_assert(false);
 	}
+	state_persistent.master_sock.batch = &state_persistent.master_outgoing;
 
 	master_init();
 	master_send(Master::Message::Disconnect);
@@ -2631,6 +3290,185 @@ b8 packet_build_disconnect(StreamWrite* p, DisconnectReason reason)
 	return true;
 }
 
+// interest management
+// every tick, a client gets its own entities, drones its team can see, and anything near its team's drones
+// everything else only gets updated every few ticks, to leave room in the packet for the stuff that matters
+
+struct RelevanceViewer
+{
+	Vec3 pos;
+	r32 range;
+};
+
+struct RelevanceContext
+{
+	StaticArray<RelevanceViewer, MAX_PLAYERS> viewers; // the client's team
+	StaticArray<PlayerManager*, MAX_GAMEPADS> managers; // the client's players
+	Team* team;
+};
+
+void relevance_context(const Client* client, RelevanceContext* context)
+{
+	context->team = nullptr;
+	for (s32 i = 0; i < client->players.length; i++)
+	{
+		PlayerHuman* player = client->players[i].ref();
+		if (player)
+		{
+			PlayerManager* manager = player->get<PlayerManager>();
+			context->managers.add(manager);
+			context->team = manager->team.ref();
+		}
+	}
+
+	if (context->team)
+	{
+		for (auto i = PlayerManager::list.iterator(); !i.is_last(); i.next())
+		{
+			Entity* instance = i.item()->instance.ref();
+			if (instance && i.item()->team.ref() == context->team)
+			{
+				RelevanceViewer* viewer = context->viewers.add();
+				viewer->pos = instance->get<Transform>()->absolute_pos();
+				// same range the client's camera uses
+				viewer->range = (instance->has<Drone>() ? instance->get<Drone>()->range() : DRONE_MAX_DISTANCE) * NET_RELEVANCE_RANGE_SCALE;
+			}
+		}
+	}
+}
+
+// number of ticks between updates of the given transform for this client
+s32 relevance_interval(const Client* client, const RelevanceContext& context, s32 index)
+{
+	if (!context.team) // still loading in
+		return 1;
+
+	Transform* transform = &Transform::list[index];
+	Entity* entity = transform->entity();
+	if (client_owns(client, entity))
+		return 1;
+
+	PlayerManager* owner = PlayerManager::owner(entity);
+	if (owner && entity->has<Drone>())
+	{
+		if (owner->team.ref() == context.team)
+			return 1;
+		for (s32 i = 0; i < context.managers.length; i++)
+		{
+			if (PlayerManager::visibility[PlayerManager::visibility_hash(context.managers[i], owner)].value)
+				return 1;
+		}
+	}
+
+	Vec3 pos = transform->absolute_pos();
+	for (s32 i = 0; i < context.viewers.length; i++)
+	{
+		const RelevanceViewer& viewer = context.viewers[i];
+		if ((pos - viewer.pos).length_squared() < viewer.range * viewer.range)
+			return 1;
+	}
+
+	return entity->has<Drone>() ? NET_RELEVANCE_HIDDEN_DRONE_INTERVAL : NET_RELEVANCE_LOW_INTERVAL;
+}
+
+const RelevanceRecord* relevance_record(const ClientRelevance* relevance, SequenceID sequence_id)
+{
+	const RelevanceRecord* record = &relevance->records[sequence_id % NET_RELEVANCE_HISTORY];
+	return record->sequence_id == sequence_id ? record : nullptr;
+}
+
+// delta-encode the frame for this client, deferring transforms it doesn't need right now
+// base and base_prev are the shared history frames the client has. they get nulled out if we no longer know exactly what the client has for them
+const StreamWrite* state_frame_delta_relevant(Client* client, StateFrame* frame, const StateFrame** base, const StateFrame** base_prev)
+{
+	RelevanceRecord* record = &client->relevance->records[frame->sequence_id % NET_RELEVANCE_HISTORY];
+
+	const RelevanceRecord* base_record = nullptr;
+	if (*base)
+	{
+		base_record = relevance_record(client->relevance, (*base)->sequence_id);
+		if (!base_record || base_record == record) // the record is gone or about to be overwritten
+			*base = nullptr;
+	}
+
+	const RelevanceRecord* base_prev_record = nullptr;
+	if (*base_prev)
+	{
+		base_prev_record = relevance_record(client->relevance, (*base_prev)->sequence_id);
+		if (!*base || !base_prev_record || base_prev_record == record)
+			*base_prev = nullptr;
+	}
+
+	record->sequence_id = frame->sequence_id;
+	record->overrides.length = 0;
+
+	if (!*base) // full frame; the client will have everything
+		return state_frame_delta(&state_server.state_frame_deltas, frame, nullptr, nullptr);
+
+	// pick transforms to defer
+	// only ones that the client already has with the same revision and parent; those just keep their old value on the client
+	StaticArray<ID, NET_RELEVANCE_MAX_OVERRIDES> deferred;
+	{
+		RelevanceContext context;
+		relevance_context(client, &context);
+		s32 index = s32(frame->transforms_active.start);
+		while (index < frame->transforms_active.end && deferred.length < deferred.capacity())
+		{
+			if ((*base)->transforms_active.get(index))
+			{
+				const TransformState& current = frame->transforms[index];
+				const TransformState& last = (*base)->transforms[index];
+				if (current.revision == last.revision
+					&& current.resolution == last.resolution
+					&& current.parent.equals(last.parent))
+				{
+					s32 interval = relevance_interval(client, context, index);
+					if (interval > 1 && (s32(frame->sequence_id) + index) % interval != 0)
+						deferred.add(ID(index));
+				}
+			}
+			index = frame->transforms_active.next(index);
+		}
+	}
+
+	if (deferred.length == 0
+		&& base_record->overrides.length == 0
+		&& (!*base_prev || base_prev_record->overrides.length == 0)) // client has exactly the shared frames
+		return state_frame_delta(&state_server.state_frame_deltas, frame, *base, *base_prev);
+
+	// deferred transforms stay the way the client has them
+	for (s32 i = 0; i < deferred.length; i++)
+	{
+		ID index = deferred[i];
+		TransformState scratch;
+		const TransformState& client_transform = transform_override((*base)->transforms[index], &base_record->overrides, index, &scratch);
+		if (!equal_states_transform(frame->transforms[index], client_transform))
+			record->overrides.add({ client_transform.rot, client_transform.pos, index });
+	}
+
+	// the serializer swaps in what the client actually has as it goes
+	StateFrameOverrides* overrides = &state_server.relevance_overrides;
+	overrides->mask.clear();
+	overrides->frame = &record->overrides;
+	overrides->base = &base_record->overrides;
+	overrides->base_prev = *base_prev ? &base_prev_record->overrides : nullptr;
+	for (s32 i = 0; i < record->overrides.length; i++)
+		overrides->mask.set(record->overrides[i].index, true);
+	for (s32 i = 0; i < base_record->overrides.length; i++)
+		overrides->mask.set(base_record->overrides[i].index, true);
+	if (*base_prev)
+	{
+		for (s32 i = 0; i < base_prev_record->overrides.length; i++)
+			overrides->mask.set(base_prev_record->overrides[i].index, true);
+	}
+
+	StreamWrite* stream = &state_server.relevance_stream;
+	stream->reset();
+	if (!serialize_state_frame(stream, frame, *base, *base_prev, overrides))
+		return nullptr;
+	return stream;
+}
+
 b8 packet_build_update(StreamWrite* p, Client* client, StateFrame* frame)
 {
 	packet_init(p);
@@ -2682,10 +3520,18 @@ b8 packet_build_update(StreamWrite* p, Client* client, StateFrame* frame)
 			&& sequence_relative_to(client->ack.sequence_id, client->first_load_sequence) > NET_ACK_PREVIOUS_SEQUENCES)
 			client->msgs_out_load_history.msg_frames.length = 0; // it's been long enough, we can stop worrying about this. all frames should have state frames by now
 
-		serialize_int(p, SequenceID, client->acked_state_frame, 0, NET_SEQUENCE_COUNT); // not NET_SEQUENCE_COUNT - 1, because base_sequence_id might be NET_SEQUENCE_INVALID
-		const StateFrame* base = state_frame_by_sequence(state_common.state_history, client->acked_state_frame);
-		if (!serialize_state_frame(p, frame, base))
+		const StateFrame* base = state_frame_by_sequence(&state_common.state_history, client->acked_state_frame);
+		const StateFrame* base_prev = nullptr;
+		if (base && sequence_more_recent(client->acked_state_frame, client->acked_state_frame_previous))
+			base_prev = state_frame_by_sequence(&state_common.state_history, client->acked_state_frame_previous);
+		const StreamWrite* delta = state_frame_delta_relevant(client, frame, &base, &base_prev);
+		SequenceID base_sequence_id = base ? client->acked_state_frame : NET_SEQUENCE_INVALID;
+		serialize_int(p, SequenceID, base_sequence_id, 0, NET_SEQUENCE_COUNT); // not NET_SEQUENCE_COUNT - 1, because base_sequence_id might be NET_SEQUENCE_INVALID
+		SequenceID base_prev_sequence_id = base_prev ? client->acked_state_frame_previous : NET_SEQUENCE_INVALID;
+		serialize_int(p, SequenceID, base_prev_sequence_id, 0, NET_SEQUENCE_COUNT);
+		if (!delta || p->would_overflow(delta->bits_written()))
 			net_error();
+		p->append(*delta);
 	}
 
 	packet_finalize(p);
@@ -2713,6 +3559,7 @@ void handle_client_disconnect(Client* c)
 			World::remove_deferred(player->entity());
 		}
 	}
+	delete c->relevance;
 	state_server.clients.remove(s32(c - &state_server.clients[0]));
 	master_send_status_update();
 }
@@ -2784,7 +3631,7 @@ void tick(const Update& u, r32 dt)
 			sync_time();
 	}
 
-	if (PlayerHuman::list.count() == 0)
+	if (PlayerHuman::list.count() == 0 && !Benchmark::active) // benchmark matches are all bots
 	{
 		if (state_server.mode != Mode::Idle)
 		{
@@ -2815,6 +3662,8 @@ void tick(const Update& u, r32 dt)
 	}
 	frame = state_frame_add(&state_common.state_history);
 	state_frame_build(frame);
+	state_frame_commit(&state_common.state_history);
+	state_server.state_frame_deltas.length = 0;
 
 	StreamWrite p;
 	for (s32 i = 0; i < state_server.clients.length; i++)
@@ -3015,6 +3864,7 @@ b8 packet_handle(StreamRead* p, const Sock::Address& address)
 						client = state_server.clients.add();
 						client_index = state_server.clients.length - 1;
 						new (client) Client();
+						client->relevance = new ClientRelevance();
 						client->address = address;
 						client->first_load_sequence = state_common.local_sequence_id;
 						{
@@ -3117,8 +3967,9 @@ b8 packet_handle(StreamRead* p, const Sock::Address& address)
 				client->flag(Client::FlagConnected, true);
 			}
 
-			// client is letting us know what the last state frame they received was
+			// client is letting us know what the last state frame they received was, and the one before it
 			serialize_int(p, SequenceID, client->acked_state_frame, 0, NET_SEQUENCE_COUNT);
+			serialize_int(p, SequenceID, client->acked_state_frame_previous, 0, NET_SEQUENCE_COUNT);
 
 			b8 most_recent;
 			{
@@ -3486,6 +4337,9 @@ void reset()
 		}
 	}
 
+	for (s32 i = 0; i < state_server.clients.length; i++)
+		delete state_server.clients[i].relevance;
+
 	state_server.~StateServer();
 	new (&state_server) StateServer();
 
@@ -3523,7 +4377,7 @@ r32 rtt(const PlayerHuman* p, SequenceID client_seq)
 	if (frame)
 	{
 		SequenceID server_seq = frame->remote_sequence_id;
-		const StateFrame* state_frame = state_frame_by_sequence(state_common.state_history, server_seq);
+		const StateFrame* state_frame = state_frame_by_sequence(&state_common.state_history, server_seq);
 		return state_common.timestamp - state_frame->timestamp;
 	}
 	else
@@ -3803,6 +4657,7 @@ void init()
 		fprintf(stderr, "%s\n", Sock::get_error());
 		vi_assert(false);
 	}
+	state_persistent.master_sock.batch = &state_persistent.master_outgoing;
 
 	master_init();
 }
@@ -3866,14 +4721,22 @@ b8 packet_build_update(StreamWrite* p, const Update& u)
 		}
 	}
 
-	// let the server know the last state frame we received
+	// let the server know the last state frame we received, and the one before it so the server can extrapolate positions
 	{
+		const StateHistory& history = state_common.state_history;
 		SequenceID most_recent_state_frame;
-		if (state_common.state_history.frames.length > 0)
-			most_recent_state_frame = state_common.state_history.frames[state_common.state_history.current_index].sequence_id;
+		if (history.frames.length > 0)
+			most_recent_state_frame = history.frames[history.current_index].sequence_id;
 		else
 			most_recent_state_frame = NET_SEQUENCE_INVALID;
 		serialize_int(p, SequenceID, most_recent_state_frame, 0, NET_SEQUENCE_COUNT); // not NET_SEQUENCE_COUNT - 1, because it might be NET_SEQUENCE_INVALID
+
+		SequenceID previous_state_frame;
+		if (history.frames.length > 1)
+			previous_state_frame = history.frames[history.current_index > 0 ? history.current_index - 1 : history.frames.length - 1].sequence_id;
+		else
+			previous_state_frame = NET_SEQUENCE_INVALID;
+		serialize_int(p, SequenceID, previous_state_frame, 0, NET_SEQUENCE_COUNT);
 	}
 
 	// we must serialize the current sequence ID separately from the message system
@@ -4099,10 +4962,10 @@ void update(const Update& u, r32 dt)
 	{
 		// determine whether we can use low-latency interpolation
 		r32 interpolation_time = state_common.timestamp - internal_interpolation_delay(true);
-		const StateFrame* frame = state_frame_by_timestamp(state_common.state_history, interpolation_time);
+		const StateFrame* frame = state_frame_by_timestamp(&state_common.state_history, interpolation_time);
 		if (frame)
 		{
-			if (state_frame_next(state_common.state_history, *frame))
+			if (state_frame_next(&state_common.state_history, *frame))
 				state_client.lag_score = vi_max(0.0f, state_client.lag_score - dt);
 			else
 				state_client.lag_score = vi_min(80.0f, state_client.lag_score + 4.0f * dt / tick_rate());
@@ -4152,10 +5015,10 @@ void update(const Update& u, r32 dt)
 
 	r32 interpolation_time = state_common.timestamp - interpolation_delay(nullptr);
 
-	const StateFrame* frame = state_frame_by_timestamp(state_common.state_history, interpolation_time);
+	const StateFrame* frame = state_frame_by_timestamp(&state_common.state_history, interpolation_time);
 	if (frame)
 	{
-		const StateFrame* frame_next = state_frame_next(state_common.state_history, *frame);
+		const StateFrame* frame_next = state_frame_next(&state_common.state_history, *frame);
 		const StateFrame* frame_final;
 		StateFrame interpolated;
 		if (frame_next)
@@ -4633,13 +5496,17 @@ b8 packet_handle(StreamRead* p, const Sock::Address& address)
 			{
 				SequenceID base_sequence_id;
 				serialize_int(p, SequenceID, base_sequence_id, 0, NET_SEQUENCE_COUNT); // not NET_SEQUENCE_COUNT - 1, because base_sequence_id might be NET_SEQUENCE_INVALID
-				const StateFrame* base = state_frame_by_sequence(state_common.state_history, base_sequence_id);
+				SequenceID base_prev_sequence_id;
+				serialize_int(p, SequenceID, base_prev_sequence_id, 0, NET_SEQUENCE_COUNT);
+				const StateFrame* base = state_frame_by_sequence(&state_common.state_history, base_sequence_id);
+				const StateFrame* base_prev = state_frame_by_sequence(&state_common.state_history, base_prev_sequence_id);
 				StateFrame frame;
-				if (!serialize_state_frame(p, &frame, base))
+				if (!serialize_state_frame(p, &frame, base, base_prev))
 					net_error();
 
 				// make sure the server says we have a base state frame if and only if we actually have it
-				if ((base_sequence_id == NET_SEQUENCE_INVALID) != (base == nullptr))
+				if ((base_sequence_id == NET_SEQUENCE_INVALID) != (base == nullptr)
+					|| (base_prev_sequence_id == NET_SEQUENCE_INVALID) != (base_prev == nullptr))
 				{
 					char str[NET_MAX_ADDRESS];
 					state_client.server_address.str(str);
@@ -4664,6 +5531,7 @@ b8 packet_handle(StreamRead* p, const Sock::Address& address)
 				if (state_common.state_history.frames.length == 0 || sequence_more_recent(frame.sequence_id, state_common.state_history.frames[state_common.state_history.current_index].sequence_id))
 				{
 					memcpy(state_frame_add(&state_common.state_history), &frame, sizeof(StateFrame));
+					state_frame_commit(&state_common.state_history);
 
 					// let players know where the server thinks they are immediately, with no interpolation
 					for (auto i = PlayerControlHuman::list.iterator(); !i.is_last(); i.next())
@@ -4913,9 +5781,9 @@ void packet_read(PacketEntry* entry)
 
 	state_common.bandwidth_in_counter += entry->packet.bytes_total;
 
-	if (entry->packet.bytes_total > 0 && entry->packet.read_checksum())
+	if (entry->packet.bytes_total > 0 && entry->packet.read_checksum()
+		&& packet_decompress(&entry->packet, entry->packet.bytes_total))
 	{
-		packet_decompress(&entry->packet, entry->packet.bytes_total);
 #if SERVER
 		Server::packet_handle(&entry->packet, entry->address);
 #else
@@ -4993,15 +5861,23 @@ void update_start(const Update& u)
 	}
 #endif
 
-	while (true)
 	{
-		PacketEntry entry(state_common.timestamp);
-		s32 bytes_received = Sock::udp_receive(&state_persistent.master_sock, &entry.address, entry.packet.data.data, NET_MAX_PACKET_SIZE);
-		entry.packet.resize_bytes(bytes_received);
-		if (bytes_received > 0)
-			packet_received(&entry);
-		else
-			break;
+		Sock::ReceiveBatch* incoming = &state_persistent.master_incoming;
+		while (Sock::udp_receive_batch(&state_persistent.master_sock, incoming) > 0)
+		{
+			for (s32 i = 0; i < incoming->count; i++)
+			{
+				s32 bytes_received = incoming->sizes[i];
+				if (bytes_received > 0)
+				{
+					PacketEntry entry(state_common.timestamp);
+					entry.address = incoming->senders[i];
+					memcpy(entry.packet.data.data, incoming->data[i], bytes_received);
+					entry.packet.resize_bytes(bytes_received);
+					packet_received(&entry);
+				}
+			}
+		}
 	}
 
 #if SERVER
@@ -5063,11 +5939,14 @@ void update_end(const Update& u)
 		}
 	}
 #endif
+
+	Sock::udp_flush(&state_persistent.master_sock);
 }
 
 void term()
 {
 	reset();
+	Sock::udp_flush(&state_persistent.master_sock);
 	Sock::close(&state_persistent.master_sock);
 #if SERVER
 	next_server_destroy(Server::state_server_persistent.next);
@@ -5290,7 +6169,8 @@ b8 msg_finalize(StreamWrite* p)
 	p->align();
 	p->flush();
 	StreamRead r;
-	memcpy(&r, p, sizeof(StreamRead));
+	r.data = p->data;
+	r.bytes_total = p->bytes_written();
 	r.rewind();
 	MessageType type;
 	serialize_enum(&r, MessageType, type);
@@ -5334,10 +6214,10 @@ r32 rtt(const PlayerHuman* p)
 
 b8 state_frame_by_timestamp(StateFrame* result, r32 timestamp)
 {
-	const StateFrame* frame_a = state_frame_by_timestamp(state_common.state_history, timestamp);
+	const StateFrame* frame_a = state_frame_by_timestamp(&state_common.state_history, timestamp);
 	if (frame_a)
 	{
-		const StateFrame* frame_b = state_frame_next(state_common.state_history, *frame_a);
+		const StateFrame* frame_b = state_frame_next(&state_common.state_history, *frame_a);
 		if (frame_b)
 			state_frame_interpolate(*frame_a, *frame_b, result, timestamp);
 		else
@@ -5347,6 +6227,415 @@ b8 state_frame_by_timestamp(StateFrame* result, r32 timestamp)
 	return false;
 }
 
+// set up a lazy view of the world at the given timestamp
+// interpolation happens on demand in transform_absolute() and rewind_drone()
+b8 rewind(Rewind* result, r32 timestamp)
+{
+	StateHistory* history = &state_common.state_history;
+	const StateFrame* frame_a = state_frame_by_timestamp(history, timestamp);
+	if (!frame_a)
+	{
+		result->a = -1;
+		result->b = -1;
+		result->transforms_active.clear();
+		return false;
+	}
+
+	s32 index_a = state_frame_index(*history, *frame_a);
+	SequenceID sequence_a = frame_a->sequence_id;
+	const StateFrame* frame_b = state_frame_next(history, *frame_a); // frame_a may be evicted from here on
+	s32 index_b = frame_b ? state_frame_index(*history, *frame_b) : -1;
+	SequenceID sequence_b = frame_b ? frame_b->sequence_id : NET_SEQUENCE_INVALID;
+	if (result->a == index_a
+		&& result->b == index_b
+		&& result->a_sequence_id == sequence_a
+		&& result->b_sequence_id == sequence_b
+		&& result->timestamp == timestamp)
+		return true; // same timestamp; keep everything we've already interpolated
+
+	result->a = index_a;
+	result->b = index_b;
+	result->a_sequence_id = sequence_a;
+	result->b_sequence_id = sequence_b;
+	result->timestamp = timestamp;
+	if (frame_b)
+	{
+		r32 timestamp_a = history->frames[index_a].timestamp;
+		vi_assert(timestamp >= timestamp_a);
+		result->blend = vi_min((timestamp - timestamp_a) / (frame_b->timestamp - timestamp_a), 1.0f);
+		result->transforms_active = frame_b->transforms_active;
+	}
+	else
+	{
+		result->blend = 0.0f;
+		result->transforms_active = frame_a->transforms_active;
+	}
+	result->transforms_cached.clear();
+	result->drones_cached.clear();
+	return true;
+}
+
+// returns null if the history has recycled the frame since the rewind was set up.
+// don't hold on to the result across other history lookups
+const StateFrame* rewind_frame(s32 index, SequenceID sequence_id)
+{
+	StateHistory* history = &state_common.state_history;
+	if (index < 0 || history->frames[index].sequence_id != sequence_id)
+		return nullptr;
+	const StateFrame* frame = state_frame_get(history, index);
+	return frame->sequence_id == sequence_id ? frame : nullptr;
+}
+
+// fetches both ends of the rewind. fetching b never evicts a, since a is the most recently used cache entry at that point
+b8 rewind_frames(const Rewind& rewind, const StateFrame** a, const StateFrame** b)
+{
+	*a = rewind_frame(rewind.a, rewind.a_sequence_id);
+	*b = rewind.b == -1 ? nullptr : rewind_frame(rewind.b, rewind.b_sequence_id);
+	return *a && (*b || rewind.b == -1);
+}
+
+const TransformState& rewind_transform(const Rewind& rewind, s32 index)
+{
+	if (!rewind.transforms_cached.get(index))
+	{
+		const StateFrame* a;
+		const StateFrame* b;
+		if (rewind_frames(rewind, &a, &b))
+		{
+			if (b)
+				transform_state_interpolate(*a, *b, index, &rewind.transforms[index], rewind.blend);
+			else
+				rewind.transforms[index] = a->transforms[index];
+		}
+		else
+		{
+			// the history moved on without us; fall back to the current game state
+			const Transform* transform = &Transform::list[index];
+			TransformState* state = &rewind.transforms[index];
+			*state = TransformState();
+			state->pos = transform->pos;
+			state->rot = transform->rot;
+			state->parent = transform->parent.ref() ? transform->parent : Ref<Transform>();
+			state->target_local_offset = transform->has<Target>() ? transform->get<Target>()->local_offset : Vec3::zero;
+		}
+		rewind.transforms_cached.set(index, true);
+	}
+	return rewind.transforms[index];
+}
+
+const DroneState& rewind_drone(const Rewind& rewind, s32 index)
+{
+	if (!rewind.drones_cached.get(index))
+	{
+		const StateFrame* a;
+		const StateFrame* b;
+		if (rewind_frames(rewind, &a, &b))
+		{
+			if (b)
+				drone_state_interpolate(a->drones[index], b->drones[index], &rewind.drones[index], rewind.blend);
+			else
+				rewind.drones[index] = a->drones[index];
+		}
+		else // no history at this timestamp, or it's gone
+			rewind.drones[index] = DroneState();
+		rewind.drones_cached.set(index, true);
+	}
+	return rewind.drones[index];
+}
+
+void transform_absolute(const Rewind& rewind, s32 index, Vec3* abs_pos, Quat* abs_rot, Vec3* local_offset)
+{
+	// if there's no history at this timestamp, everything comes from the current game state
+	const Bitmask<MAX_ENTITIES>& transforms_active = rewind.transforms_active;
+
+	if (abs_rot)
+		*abs_rot = Quat::identity;
+	*abs_pos = Vec3::zero;
+	if (local_offset)
+	{
+		vi_assert(index >= 0 && index < MAX_ENTITIES);
+		*local_offset = transforms_active.get(index) ? rewind_transform(rewind, index).target_local_offset : Vec3::zero;
+	}
+	while (index != IDNull)
+	{
+		if (transforms_active.get(index))
+		{
+			const TransformState& transform = rewind_transform(rewind, index);
+			if (abs_rot)
+				*abs_rot = transform.rot * *abs_rot;
+			*abs_pos = (transform.rot * *abs_pos) + transform.pos;
+			index = transform.parent.id;
+		}
+		else
+		{
+			// not tracked by the dynamic transform system; use the current game state
+			Transform* transform = &Transform::list[index];
+			if (abs_rot)
+				*abs_rot = transform->rot * *abs_rot;
+			*abs_pos = (transform->rot * *abs_pos) + transform->pos;
+			if (local_offset)
+			{
+				if (transform->has<Target>())
+					*local_offset = transform->get<Target>()->local_offset;
+				else
+					*local_offset = Vec3::zero;
+			}
+			index = transform->parent.ref() ? transform->parent.id : IDNull;
+		}
+	}
+}
+
+#if !RELEASE_BUILD
+b8 benchmark_packet_build(StreamWrite* p)
+{
+	using Stream = StreamWrite;
+	StateHistory* history = &state_common.state_history;
+	if (history->frames.length == 0)
+		return false;
+
+	// most recent state frame, delta-encoded against the one before it, like a typical ServerPacket::Update
+	StateFrame* frame = &history->latest;
+	const StateFrame* base = state_frame_by_sequence(history, sequence_advance(frame->sequence_id, -1));
+
+	packet_init(p);
+	ServerPacket type = ServerPacket::Update;
+	serialize_enum(p, ServerPacket, type);
+	if (!serialize_state_frame(p, frame, base))
+		net_error();
+	return true;
+}
+
+void benchmark_compression(const char* dictionary_path)
+{
+	StreamWrite p;
+	if (!benchmark_packet_build(&p))
+	{
+		vi_debug("%s", "No state frames available to benchmark.");
+		return;
+	}
+
+	if (dictionary_path)
+	{
+		FILE* f = fopen(dictionary_path, "rb");
+		if (!f)
+		{
+			vi_debug("Can't open dictionary file '%s'", dictionary_path);
+			return;
+		}
+		fseek(f, 0, SEEK_END);
+		s32 length = s32(ftell(f));
+		fseek(f, 0, SEEK_SET);
+		Array<u8> dictionary(length, length);
+		fread(dictionary.data, sizeof(u8), length, f);
+		fclose(f);
+		packet_compression_dictionary(dictionary.data, dictionary.length);
+	}
+
+	packet_compression_benchmark(p, 1000);
+
+	if (dictionary_path)
+		packet_compression_dictionary(nullptr, 0);
+}
+
+// 12 synthetic clients spread over a handful of acked base frames
+void benchmark_delta_cache()
+{
+	StateHistory* history = &state_common.state_history;
+	if (history->frames.length == 0)
+	{
+		vi_debug("%s", "No state frames available to benchmark.");
+		return;
+	}
+
+	StateFrame* frame = &history->latest;
+	const StateFrame* bases[MAX_PLAYERS];
+	for (s32 i = 0; i < MAX_PLAYERS; i++)
+		bases[i] = state_frame_by_sequence(history, sequence_advance(frame->sequence_id, -1 - (i % 3)));
+
+	const s32 iterations = 100;
+	StreamWrite p;
+
+	r64 start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		for (s32 i = 0; i < MAX_PLAYERS; i++)
+		{
+			p.reset();
+			serialize_state_frame(&p, frame, bases[i]);
+		}
+	}
+	r64 time_uncached = platform::time() - start_time;
+
+	StateFrameDeltaCache* cache = new StateFrameDeltaCache();
+	start_time = platform::time();
+	for (s32 j = 0; j < iterations; j++)
+	{
+		cache->length = 0;
+		for (s32 i = 0; i < MAX_PLAYERS; i++)
+		{
+			p.reset();
+			const StreamWrite* delta = state_frame_delta(cache, frame, bases[i], nullptr);
+			if (delta)
+				p.append(*delta);
+		}
+	}
+	r64 time_cached = platform::time() - start_time;
+	s32 distinct_bases = cache->length;
+	delete cache;
+
+	r64 scale = 1000000.0 / r64(iterations);
+	vi_debug("%d clients, %d distinct bases", MAX_PLAYERS, distinct_bases);
+	vi_debug("per-client encode: %.2fus per tick", time_uncached * scale);
+	vi_debug("shared delta cache: %.2fus per tick", time_cached * scale);
+}
+
+void benchmark_history()
+{
+	StateHistory* history = &state_common.state_history;
+	if (history->frames.length < 2)
+	{
+		vi_debug("%s", "No state frames available to benchmark.");
+		return;
+	}
+
+	s64 bytes = sizeof(StateHistory);
+	for (s32 i = 0; i < history->frames.length; i++)
+	{
+		const StateFrameCompact& frame = history->frames[i];
+		bytes += frame.transform_pos.reserved * sizeof(u64)
+			+ frame.transform_pos_high.reserved * sizeof(Vec3)
+			+ frame.transform_rot.reserved * sizeof(u64)
+			+ frame.transform_target_local_offset.reserved * sizeof(Vec3)
+			+ frame.transform_parent.reserved * sizeof(Ref<Transform>)
+			+ frame.transform_revision.reserved * sizeof(Revision)
+			+ frame.transform_resolution.reserved * sizeof(Resolution)
+			+ frame.walkers.reserved * sizeof(WalkerState);
+	}
+
+	const s32 iterations = 100;
+	s32 index = history->current_index > 0 ? history->current_index - 1 : history->frames.length - 1;
+	r64 start_time = platform::time();
+	for (s32 i = 0; i < iterations; i++)
+		state_frame_decompress(history->frames[index], &history->cache[0]);
+	r64 time_decompress = platform::time() - start_time;
+	history->cache_index[0] = index;
+
+	vi_debug("%d frames, %d active transforms", s32(history->frames.length), s32(history->latest.transforms_active.count()));
+	vi_debug("history: %lldkb, %lldkb uncompressed", bytes / 1024, s64(NET_HISTORY_SIZE * sizeof(StateFrame)) / 1024);
+	vi_debug("reconstruct: %.2fus per frame", time_decompress * 1000000.0 / r64(iterations));
+}
+
+// replays the state history in order, encoding each frame against the one before it
+// with absolute positions, plain deltas, and extrapolated deltas
+void benchmark_position_delta()
+{
+	StateHistory* history = &state_common.state_history;
+	if (history->frames.length < 3)
+	{
+		vi_debug("%s", "No state frames available to benchmark.");
+		return;
+	}
+
+	// copies, so the history cache can't pull them out from under us
+	StateFrame* frames = new StateFrame[3];
+	StateFrame* frame = &frames[0];
+	StateFrame* base = &frames[1];
+	StateFrame* base_prev = &frames[2];
+
+	s64 bits_absolute = 0;
+	s64 bits_delta = 0;
+	s64 bits_extrapolate = 0;
+	s32 count = 0;
+	StreamWrite p;
+
+	s32 oldest = history->frames.length < history->frames.capacity() ? 0 : (history->current_index + 1) % history->frames.length;
+	for (s32 i = 2; i < history->frames.length; i++)
+	{
+		memcpy(base_prev, state_frame_get(history, (oldest + i - 2) % history->frames.length), sizeof(StateFrame));
+		memcpy(base, state_frame_get(history, (oldest + i - 1) % history->frames.length), sizeof(StateFrame));
+		memcpy(frame, state_frame_get(history, (oldest + i) % history->frames.length), sizeof(StateFrame));
+
+		benchmark_position_absolute = true;
+		p.reset();
+		serialize_state_frame(&p, frame, base);
+		bits_absolute += p.bits_written();
+		benchmark_position_absolute = false;
+
+		p.reset();
+		serialize_state_frame(&p, frame, base);
+		bits_delta += p.bits_written();
+
+		p.reset();
+		serialize_state_frame(&p, frame, base, base_prev);
+		bits_extrapolate += p.bits_written();
+
+		count++;
+	}
+
+	delete[] frames;
+
+	vi_debug("%d frames", count);
+	vi_debug("absolute positions: %.1f bytes per frame", r64(bits_absolute) / r64(count * 8));
+	vi_debug("delta positions: %.1f bytes per frame", r64(bits_delta) / r64(count * 8));
+	vi_debug("extrapolated positions: %.1f bytes per frame", r64(bits_extrapolate) / r64(count * 8));
+}
+
+// full serialize_state_frame round trip of the latest frame against the one before it, write then read
+void benchmark_serialize()
+{
+	StateHistory* history = &state_common.state_history;
+	if (history->frames.length < 2)
+	{
+		vi_debug("%s", "No state frames available to benchmark.");
+		return;
+	}
+
+	StateFrame* frames = new StateFrame[3];
+	StateFrame* frame = &frames[0];
+	StateFrame* base = &frames[1];
+	StateFrame* result = &frames[2];
+	s32 index = history->current_index;
+	s32 index_base = index > 0 ? index - 1 : history->frames.length - 1;
+	memcpy(frame, state_frame_get(history, index), sizeof(StateFrame));
+	memcpy(base, state_frame_get(history, index_base), sizeof(StateFrame));
+
+	StreamWrite* p = new StreamWrite();
+	StreamRead* r = new StreamRead();
+
+	const s32 iterations = 1000;
+	r64 time_write = 0.0;
+	r64 time_read = 0.0;
+	s32 bits = 0;
+	b8 ok = true;
+	for (s32 i = 0; i < iterations; i++)
+	{
+		r64 start_time = platform::time();
+		p->reset();
+		serialize_state_frame(p, frame, base);
+		p->flush();
+		time_write += platform::time() - start_time;
+		bits = p->bits_written();
+
+		r->data = p->data;
+		r->bytes_total = p->bytes_written();
+		r->rewind();
+		start_time = platform::time();
+		ok &= serialize_state_frame(r, result, base);
+		time_read += platform::time() - start_time;
+		ok &= r->bits_read == bits && result->sequence_id == frame->sequence_id;
+	}
+
+	delete p;
+	delete r;
+	delete[] frames;
+
+	r64 scale = 1000000.0 / r64(iterations);
+	vi_debug("%d bytes per frame, %d active transforms, %d iterations", (bits + 7) / 8, s32(frame->transforms_active.count()), iterations);
+	vi_debug("write %.2fus, read %.2fus", time_write * scale, time_read * scale);
+	vi_debug("round trip %s", ok ? "ok" : "MISMATCH");
+}
+#endif
+
 r32 timestamp()
 {
 	return state_common.timestamp;
@@ -115,6 +115,24 @@ struct StateFrame
 	SequenceID sequence_id;
 };
 
+// lag compensation view of the state history at a given timestamp
+// only the transforms and drones that actually get queried are interpolated; results are cached until the timestamp changes
+// frames are looked up by history index and sequence on every access, since the history's frame cache reuses its slots
+struct Rewind
+{
+	mutable TransformState transforms[MAX_ENTITIES];
+	mutable DroneState drones[MAX_PLAYERS];
+	mutable Bitmask<MAX_ENTITIES> transforms_cached;
+	mutable Bitmask<MAX_PLAYERS> drones_cached;
+	Bitmask<MAX_ENTITIES> transforms_active;
+	s32 a = -1; // -1 if there's no history at this timestamp
+	s32 b = -1; // -1 if the timestamp is past the end of the history
+	SequenceID a_sequence_id;
+	SequenceID b_sequence_id;
+	r32 timestamp;
+	r32 blend;
+};
+
 void init();
 r32 interpolation_delay(const PlayerHuman*);
 r32 tick_rate();
@@ -232,9 +250,19 @@ StreamWrite* msg_new_local(MessageType);
 b8 msg_finalize(StreamWrite*);
 r32 rtt(const PlayerHuman*);
 b8 state_frame_by_timestamp(StateFrame*, r32);
+b8 rewind(Rewind*, r32);
+const DroneState& rewind_drone(const Rewind&, s32);
 void transform_absolute(const StateFrame&, s32, Vec3*, Quat* = nullptr, Vec3* = nullptr);
+void transform_absolute(const Rewind&, s32, Vec3*, Quat* = nullptr, Vec3* = nullptr);
 r32 timestamp();
 b8 player_is_admin(const PlayerHuman*);
+#if !RELEASE_BUILD
+void benchmark_compression(const char* = nullptr);
+void benchmark_delta_cache();
+void benchmark_history();
+void benchmark_position_delta();
+void benchmark_serialize();
+#endif
 
 }
 
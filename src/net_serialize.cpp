@@ -1,6 +1,28 @@
 #include "net_serialize.h"
 #include <cstdio>
+#include "platform/util.h"
 #include "assimp/contrib/zlib/zlib.h"
+#include <cstring>
+#include <atomic>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CRC32_PCLMUL 1
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC32_TARGET_PCLMUL
+#else
+#include <cpuid.h>
+#define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse4.1")))
+#endif
+#else
+#define CRC32_PCLMUL 0
+#endif
+
+#define CRC32_PCLMUL_MIN 64 // the folding kernel wants at least four 16-byte blocks
 
 namespace VI
 {
@@ -46,14 +68,235 @@ static const u32 crc32_table[256] =
 	0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d 
 };
 
+// crc32_table extended for slicing-by-8: slices[k][b] is the crc of byte b followed by k zero bytes
+struct Crc32Slices
+{
+	u32 table[8][256];
+	b8 pclmul;
+
+	Crc32Slices()
+	{
+		for (s32 i = 0; i < 256; i++)
+			table[0][i] = crc32_table[i];
+		for (s32 k = 1; k < 8; k++)
+		{
+			for (s32 i = 0; i < 256; i++)
+				table[k][i] = (table[k - 1][i] >> 8) ^ crc32_table[table[k - 1][i] & 0xFF];
+		}
+
+		pclmul = false;
+#if CRC32_PCLMUL
+#if defined(_MSC_VER)
+		s32 info[4];
+		__cpuid(info, 1);
+		pclmul = (info[2] & (1 << 1)) && (info[2] & (1 << 19)); // PCLMULQDQ and SSE4.1
+#else
+		u32 eax, ebx, ecx, edx;
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			pclmul = (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+#endif
+#endif
+	}
+};
+
+static const Crc32Slices crc32_slices;
+
+// these all work on the raw register, without the pre and post inversion
+
+inline u32 crc32_bytes(const u8* buffer, memory_index length, u32 value)
+{
+	for (memory_index i = 0; i < length; i++)
+		value = (value >> 8) ^ crc32_table[(value ^ buffer[i]) & 0xFF];
+	return value;
+}
+
+u32 crc32_slice8(const u8* buffer, memory_index length, u32 value)
+{
+	const u32 (*t)[256] = crc32_slices.table;
+	while (length >= 8)
+	{
+		// little endian: the first byte ends up in the low bits
+		u32 a;
+		u32 b;
+		memcpy(&a, buffer, sizeof(u32));
+		memcpy(&b, buffer + 4, sizeof(u32));
+		a ^= value;
+		value = t[7][a & 0xFF] ^ t[6][(a >> 8) & 0xFF] ^ t[5][(a >> 16) & 0xFF] ^ t[4][a >> 24]
+			^ t[3][b & 0xFF] ^ t[2][(b >> 8) & 0xFF] ^ t[1][(b >> 16) & 0xFF] ^ t[0][b >> 24];
+		buffer += 8;
+		length -= 8;
+	}
+	return crc32_bytes(buffer, length, value);
+}
+
+#if CRC32_PCLMUL
+// carry-less multiply folding, four 128-bit lanes at a time, then Barrett reduction.
+// see Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+// length must be a multiple of 16 and at least CRC32_PCLMUL_MIN
+CRC32_TARGET_PCLMUL u32 crc32_pclmul(const u8* buffer, memory_index length, u32 value)
+{
+	// constants for the reflected 0xedb88320 polynomial
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+	__m128i x1 = _mm_loadu_si128((const __m128i*)(buffer + 0x00));
+	__m128i x2 = _mm_loadu_si128((const __m128i*)(buffer + 0x10));
+	__m128i x3 = _mm_loadu_si128((const __m128i*)(buffer + 0x20));
+	__m128i x4 = _mm_loadu_si128((const __m128i*)(buffer + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(s32(value)));
+	buffer += 64;
+	length -= 64;
+
+	// fold four lanes forward 512 bits at a time
+	while (length >= 64)
+	{
+		__m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		__m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		__m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		__m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buffer + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buffer + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buffer + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buffer + 0x30)));
+		buffer += 64;
+		length -= 64;
+	}
+
+	// fold the four lanes into one
+	__m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// remaining 128-bit blocks
+	while (length >= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*)buffer)), x5);
+		buffer += 16;
+		length -= 16;
+	}
+
+	// 128 bits down to 64
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32
+	x2 = _mm_and_si128(x1, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return u32(_mm_extract_epi32(x1, 1));
+}
+#endif
+
+// standard CRC-32 (the zlib / ethernet one). same result regardless of which path runs
 u32 crc32(const u8* buffer, memory_index length, u32 value)
 {
 	value ^= 0xFFFFFFFF;
-	for (memory_index i = 0; i < length; i++) 
-		value = (value >> 8) ^ crc32_table[(value ^ buffer[i]) & 0xFF];
+#if CRC32_PCLMUL
+	if (crc32_slices.pclmul && length >= CRC32_PCLMUL_MIN)
+	{
+		memory_index blocks = length & ~memory_index(15);
+		value = crc32_pclmul(buffer, blocks, value);
+		buffer += blocks;
+		length -= blocks;
+	}
+#endif
+	value = crc32_slice8(buffer, length, value);
 	return value ^ 0xFFFFFFFF;
 }
 
+#if !RELEASE_BUILD
+// checks every path against the original byte-at-a-time loop, then times them
+void benchmark_crc32()
+{
+	const s32 buffer_size = 65536 + 64;
+	Array<u8> buffer(buffer_size, buffer_size);
+	u32 seed = 0x12345678;
+	for (s32 i = 0; i < buffer_size; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		buffer[i] = u8(seed >> 24);
+	}
+
+	// equality
+	s32 mismatches = 0;
+	s32 checks = 0;
+	{
+		const u8 check_string[] = "123456789";
+		if (crc32(check_string, 9) != 0xCBF43926)
+			mismatches++;
+		checks++;
+	}
+	for (s32 offset = 0; offset < 16; offset++)
+	{
+		for (s32 length = 0; length <= 2048; length += (length < 256 ? 1 : 37))
+		{
+			const u8* data = &buffer[offset];
+			u32 initial = u32(length) * 2654435761u;
+			u32 reference = crc32_bytes(data, length, initial ^ 0xFFFFFFFF) ^ 0xFFFFFFFF;
+			if (crc32(data, length, initial) != reference)
+				mismatches++;
+			if ((crc32_slice8(data, length, initial ^ 0xFFFFFFFF) ^ 0xFFFFFFFF) != reference)
+				mismatches++;
+			// chaining has to work too, the way packet_finalize does it
+			s32 split = length / 3;
+			if (crc32(data + split, length - split, crc32(data, split, initial)) != reference)
+				mismatches++;
+			checks += 3;
+		}
+	}
+	vi_debug("crc32: %d/%d checks match the reference, pclmul %s", checks - mismatches, checks, crc32_slices.pclmul ? "available" : "unavailable");
+
+	// throughput
+	const s32 sizes[] = { 64, 256, 1200, 65536 };
+	for (s32 s = 0; s < s32(sizeof(sizes) / sizeof(sizes[0])); s++)
+	{
+		s32 size = sizes[s];
+		s32 iterations = vi_max(1, (64 * 1024 * 1024) / size);
+		u32 sink = 0;
+
+		r64 start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+			sink ^= crc32_bytes(buffer.data, size, sink);
+		r64 time_bytes = platform::time() - start_time;
+
+		start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+			sink ^= crc32_slice8(buffer.data, size, sink);
+		r64 time_slice8 = platform::time() - start_time;
+
+		start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+			sink ^= crc32(buffer.data, size, sink);
+		r64 time_dispatch = platform::time() - start_time;
+
+		r64 megabytes = (r64(size) * r64(iterations)) / (1024.0 * 1024.0);
+		vi_debug("crc32 %d bytes: table %.0fMB/s, slice-by-8 %.0fMB/s, dispatched %.0fMB/s (%u)", size, megabytes / time_bytes, megabytes / time_slice8, megabytes / time_dispatch, sink);
+	}
+}
+#endif
+
 StreamWrite::StreamWrite()
 	: data(),
 	scratch(),
@@ -68,22 +311,30 @@ void StreamWrite::reset()
 	scratch_bits = 0;
 }
 
-void StreamWrite::bits(u32 value, s32 bits)
+void StreamWrite::bits_array(const u32* values, s32 count, s32 bits)
 {
 	vi_assert(bits >= 0);
 	vi_assert(bits <= 32);
-	value &= (u64(1) << bits) - 1;
-
-	scratch |= u64(value) << scratch_bits;
+	vi_assert(scratch_bits >= 0 && scratch_bits < 64);
 
-	scratch_bits += bits;
-
-	if (scratch_bits >= 32)
+	// keep the scratch in locals so it stays in registers for the whole run
+	u64 mask = (u64(1) << bits) - 1;
+	u64 s = scratch;
+	s32 s_bits = scratch_bits;
+	for (s32 i = 0; i < count; i++)
 	{
-		data.add(u32(scratch & 0xFFFFFFFF));
-		scratch >>= 32;
-		scratch_bits -= 32;
+		u64 v = u64(values[i]) & mask;
+		s |= v << s_bits;
+		s_bits += bits;
+		if (s_bits >= 64)
+		{
+			word(s);
+			s_bits -= 64;
+			s = v >> (bits - s_bits);
+		}
 	}
+	scratch = s;
+	scratch_bits = s_bits;
 }
 
 b8 StreamWrite::align()
@@ -114,49 +365,56 @@ s32 StreamWrite::align_bits() const
 	return (8 - (scratch_bits % 8 )) % 8;
 }
 
+// words are stored little-endian, so a byte-aligned stream is just a byte array.
+// spill the scratch into the buffer, copy the bytes after it, and pick the partial word back up
 void StreamWrite::bytes(const u8* buffer, s32 bytes)
 {
 	vi_assert(align_bits() == 0);
-	vi_assert((bits_written() % 32) == 0 || (bits_written() % 32) == 8 || (bits_written() % 32) == 16 || (bits_written() % 32 ) == 24);
-
-	s32 head_bytes = (4 - (bits_written() % 32 ) / 8) % 4;
-	if (head_bytes > bytes)
-		head_bytes = bytes;
-	for (s32 i = 0; i < head_bytes; i++)
-		bits(buffer[i], 8);
-	if (head_bytes == bytes)
-		return;
-
-	flush();
-
-	vi_assert(align_bits() == 0);
+	vi_assert(scratch_bits >= 0);
+	vi_assert(!would_overflow(bytes * 8));
 
-	s32 num_words = (bytes - head_bytes) / sizeof(u32);
-	if (num_words > 0)
+	u8* out = (u8*)data.data;
+	s32 pos = data.length * sizeof(u32);
+	for (s32 i = 0; i < scratch_bits; i += 8)
 	{
-		vi_assert((bits_written() % 32) == 0);
-		s32 write_pos = data.length;
-		data.resize(data.length + num_words);
-		memcpy(&data[write_pos], &buffer[head_bytes], num_words * sizeof(u32));
-		scratch = 0;
+		out[pos] = u8(scratch >> i);
+		pos++;
 	}
 
-	vi_assert(align_bits() == 0);
+	memcpy(&out[pos], buffer, bytes);
+	pos += bytes;
 
-	s32 tail_start = head_bytes + num_words * sizeof(u32);
-	s32 tail_bytes = bytes - tail_start;
-	vi_assert(tail_bytes >= 0 && tail_bytes < sizeof(u32));
-	for (s32 i = 0; i < tail_bytes; i++)
-		bits(buffer[tail_start + i], 8);
+	data.length = u16(pos / sizeof(u32));
+	scratch = 0;
+	scratch_bits = 0;
+	for (s32 i = data.length * sizeof(u32); i < pos; i++)
+	{
+		scratch |= u64(out[i]) << scratch_bits;
+		scratch_bits += 8;
+	}
 
-	vi_assert(align_bits() == 0);
+	vi_assert(bits_written() == pos * 8);
+}
 
-	vi_assert(head_bytes + num_words * sizeof(u32) + tail_bytes == bytes);
+// copy every bit written to the other stream onto the end of this one, at whatever bit offset we're at
+void StreamWrite::append(const StreamWrite& other)
+{
+	vi_assert(!would_overflow(other.bits_written()));
+	vi_assert(other.scratch_bits >= 0);
+	bits_array(other.data.data, other.data.length, 32);
+	if (other.scratch_bits > 32)
+	{
+		bits(u32(other.scratch), 32);
+		bits(u32(other.scratch >> 32), other.scratch_bits - 32);
+	}
+	else if (other.scratch_bits > 0)
+		bits(u32(other.scratch), other.scratch_bits);
 }
 
+// write out whatever's left in the scratch, rounded up to a whole u32
 void StreamWrite::flush()
 {
-	if (scratch_bits != 0)
+	while (scratch_bits > 0)
 	{
 		data.add(u32(scratch & 0xFFFFFFFF));
 		scratch >>= 32;
@@ -177,9 +435,7 @@ void StreamWrite::resize_bytes(s32 b)
 }
 
 StreamRead::StreamRead()
-	: scratch(),
-	scratch_bits(),
-	data(),
+	: data(),
 	bits_read(),
 	bytes_total()
 {
@@ -195,16 +451,6 @@ void StreamRead::rewind(s32 position)
 {
 	vi_assert(position <= data.length * 32);
 	bits_read = position;
-	if (bits_read < data.length * 32)
-	{
-		scratch_bits = 32 - (bits_read % 32);
-		scratch = u64(data[bits_read / 32]) >> (bits_read % 32);
-	}
-	else
-	{
-		scratch_bits = 0;
-		scratch = 0;
-	}
 }
 
 b8 StreamRead::read_checksum()
@@ -231,71 +477,36 @@ s32 StreamRead::bytes_read() const
 	return (bits_read % 8 == 0) ? bytes : (bytes + 1);
 }
 
-void StreamRead::bits(u32& output, s32 bits)
+void StreamRead::bits_array(u32* output, s32 count, s32 bits)
 {
 	vi_assert(bits >= 0);
 	vi_assert(bits <= 32);
-	vi_assert(bits_read + bits <= data.length * 32);
+	vi_assert(bits_read + bits * count <= data.length * 32);
 
-	if (scratch_bits < bits)
+	if (bits == 0)
 	{
-		scratch |= u64(data[(bits_read + scratch_bits) / 32]) << scratch_bits;
-		scratch_bits += 32;
+		for (s32 i = 0; i < count; i++)
+			output[i] = 0;
+		return;
 	}
 
-	bits_read += bits;
-
-	vi_assert(scratch_bits >= bits);
-
-	output = scratch & ((u64(1) << bits) - 1);
-
-	scratch >>= bits;
-	scratch_bits -= bits;
+	s32 position = bits_read;
+	for (s32 i = 0; i < count; i++)
+	{
+		output[i] = field(position, bits);
+		position += bits;
+	}
+	bits_read = position;
 }
 
 void StreamRead::bytes(u8* buffer, s32 bytes)
 {
 	vi_assert(align_bits() == 0);
 	vi_assert(bits_read + bytes * 8 <= data.length * 32);
-	vi_assert((bits_read % 32) == 0 || (bits_read % 32) == 8 || (bits_read % 32) == 16 || (bits_read % 32) == 24);
 
-	s32 head_bytes = (4 - (bits_read % 32) / 8) % 4;
-	if (head_bytes > bytes)
-		head_bytes = bytes;
-	for (s32 i = 0; i < head_bytes; i++)
-	{
-		u32 value;
-		bits(value, 8);
-		buffer[i] = (u8)value;
-	}
-	if (head_bytes == bytes)
-		return;
-
-	vi_assert(align_bits() == 0);
-
-	s32 num_words = (bytes - head_bytes) / 4;
-	if (num_words > 0)
-	{
-		vi_assert((bits_read % 32) == 0);
-		memcpy(&buffer[head_bytes], &data[bits_read / 32], num_words * sizeof(u32));
-		bits_read += num_words * 32;
-	}
-
-	vi_assert(align_bits() == 0);
-
-	s32 tail_start = head_bytes + num_words * sizeof(u32);
-	s32 tail_bytes = bytes - tail_start;
-	vi_assert(tail_bytes >= 0 && tail_bytes < sizeof(u32));
-	for (s32 i = 0; i < tail_bytes; i++)
-	{
-		u32 value;
-		bits(value, 8);
-		buffer[tail_start + i] = (u8)value;
-	}
-
-	vi_assert(align_bits() == 0);
-
-	vi_assert(head_bytes + num_words * sizeof(u32) + tail_bytes == bytes);
+	// byte aligned, and the words are little-endian, so this is one copy
+	memcpy(buffer, &((const u8*)data.data)[bits_read / 8], bytes);
+	bits_read += bytes * 8;
 }
 
 s32 StreamRead::align_bits() const
@@ -331,38 +542,148 @@ void packet_init(StreamWrite* p)
 	p->bits(NET_PROTOCOL_ID, 32); // packet_send() will replace this with the packet checksum
 }
 
+// zlib contexts are expensive to set up (deflateInit allocates a few hundred KB of window and hash state),
+// so every thread keeps one deflate and one inflate context alive and resets it between packets.
+// packets are still compressed independently; a persistent stream would break as soon as a packet got dropped.
+struct CompressionContext
+{
+	z_stream deflater;
+	z_stream inflater;
+	Array<u8> dictionary; // this thread's copy of compression_dictionary
+	u32 dictionary_version;
+	b8 deflater_active;
+	b8 inflater_active;
+
+	CompressionContext()
+		: deflater(), inflater(), dictionary(), dictionary_version(), deflater_active(), inflater_active()
+	{
+	}
+
+	~CompressionContext()
+	{
+		if (deflater_active)
+			deflateEnd(&deflater);
+		if (inflater_active)
+			inflateEnd(&inflater);
+	}
+};
+
+thread_local CompressionContext compression_context;
+
+// optional preset dictionary shared by all threads.
+// every endpoint that talks to this process must use the exact same dictionary, otherwise inflate fails the adler check.
+// it can be set from any thread while the network thread is compressing, so each thread works from its own copy
+// and only takes the lock to refresh it when the version changes.
+struct CompressionDictionary
+{
+	std::mutex mutex;
+	Array<u8> data;
+	std::atomic<u32> version;
+
+	CompressionDictionary()
+		: mutex(), data(), version(0)
+	{
+	}
+};
+
+CompressionDictionary compression_dictionary;
+
+void packet_compression_dictionary(const u8* data, s32 length)
+{
+	std::lock_guard<std::mutex> lock(compression_dictionary.mutex);
+	compression_dictionary.data.resize(length);
+	if (length > 0)
+		memcpy(compression_dictionary.data.data, data, length);
+	compression_dictionary.version.fetch_add(1, std::memory_order_release);
+}
+
+const Array<u8>& compression_dictionary_get()
+{
+	if (compression_dictionary.version.load(std::memory_order_acquire) != compression_context.dictionary_version)
+	{
+		std::lock_guard<std::mutex> lock(compression_dictionary.mutex);
+		Array<u8>* dictionary = &compression_context.dictionary;
+		dictionary->resize(compression_dictionary.data.length);
+		if (dictionary->length > 0)
+			memcpy(dictionary->data, compression_dictionary.data.data, dictionary->length);
+		compression_context.dictionary_version = compression_dictionary.version.load(std::memory_order_relaxed);
+	}
+	return compression_context.dictionary;
+}
+
+z_stream* deflater_get()
+{
+	z_stream* z = &compression_context.deflater;
+	if (compression_context.deflater_active)
+	{
+		s32 result = deflateReset(z);
+		vi_assert(result == Z_OK);
+	}
+	else
+	{
+		z->zalloc = nullptr;
+		z->zfree = nullptr;
+		z->opaque = nullptr;
+		s32 result = deflateInit(z, Z_DEFAULT_COMPRESSION);
+		vi_assert(result == Z_OK);
+		compression_context.deflater_active = true;
+	}
+
+	const Array<u8>& dictionary = compression_dictionary_get();
+	if (dictionary.length > 0)
+	{
+		s32 result = deflateSetDictionary(z, (const Bytef*)dictionary.data, dictionary.length);
+		vi_assert(result == Z_OK);
+	}
+
+	return z;
+}
+
+z_stream* inflater_get()
+{
+	z_stream* z = &compression_context.inflater;
+	if (compression_context.inflater_active)
+	{
+		s32 result = inflateReset(z);
+		vi_assert(result == Z_OK);
+	}
+	else
+	{
+		z->zalloc = nullptr;
+		z->zfree = nullptr;
+		z->opaque = nullptr;
+		z->next_in = nullptr;
+		z->avail_in = 0;
+		s32 result = inflateInit(z);
+		vi_assert(result == Z_OK);
+		compression_context.inflater_active = true;
+	}
+	return z;
+}
+
 void packet_finalize(StreamWrite* p)
 {
-	vi_assert(p->data[0] == NET_PROTOCOL_ID);
 	p->flush();
+	vi_assert(p->data[0] == NET_PROTOCOL_ID);
 
 	// compress everything but the protocol ID
 	StreamWrite compressed;
 	compressed.resize_bytes(NET_MAX_PACKET_SIZE);
-	z_stream z;
-	z.zalloc = nullptr;
-	z.zfree = nullptr;
-	z.opaque = nullptr;
-	z.next_out = (Bytef*)&compressed.data[1];
-	z.avail_out = NET_MAX_PACKET_SIZE - sizeof(u32);
-	z.next_in = (Bytef*)&p->data[1];
-	z.avail_in = p->bytes_written() - sizeof(u32);
-
-	s32 result = deflateInit(&z, Z_DEFAULT_COMPRESSION);
-	vi_assert(result == Z_OK);
+	z_stream* z = deflater_get();
+	z->next_out = (Bytef*)&compressed.data[1];
+	z->avail_out = NET_MAX_PACKET_SIZE - sizeof(u32);
+	z->next_in = (Bytef*)&p->data[1];
+	z->avail_in = p->bytes_written() - sizeof(u32);
 
-	result = deflate(&z, Z_FINISH);
+	s32 result = deflate(z, Z_FINISH);
 
-	vi_assert(result == Z_STREAM_END && z.avail_in == 0);
-
-	result = deflateEnd(&z);
-	vi_assert(result == Z_OK);
+	vi_assert(result == Z_STREAM_END && z->avail_in == 0);
 
 	p->reset();
-	p->resize_bytes(sizeof(u32) + NET_MAX_PACKET_SIZE - z.avail_out); // include one u32 for the CRC32
+	p->resize_bytes(sizeof(u32) + NET_MAX_PACKET_SIZE - z->avail_out); // include one u32 for the CRC32
 	vi_assert(p->data.length > 0);
 	p->data[p->data.length - 1] = 0; // make sure everything gets zeroed out so the CRC32 comes out right
-	memcpy(&p->data[1], &compressed.data[1], NET_MAX_PACKET_SIZE - z.avail_out);
+	memcpy(&p->data[1], &compressed.data[1], NET_MAX_PACKET_SIZE - z->avail_out);
 
 	// replace protocol ID with CRC32
 	u32 checksum = crc32((const u8*)&p->data[0], sizeof(u32));
@@ -371,38 +692,138 @@ void packet_finalize(StreamWrite* p)
 	p->data[0] = checksum;
 }
 
-void packet_decompress(StreamRead* p, s32 bytes)
+// everything past the CRC32 is untrusted, so any inflate error just means the packet gets dropped
+b8 packet_decompress(StreamRead* p, s32 bytes)
 {
+	if (bytes <= s32(sizeof(u32)))
+		return false;
+
 	StreamRead decompressed;
 	decompressed.resize_bytes(NET_MAX_PACKET_SIZE);
 	
-	z_stream z;
-	z.zalloc = nullptr;
-	z.zfree = nullptr;
-	z.opaque = nullptr;
-	z.next_in = (Bytef*)&p->data[1];
-	z.avail_in = bytes - sizeof(u32);
-	z.next_out = (Bytef*)&decompressed.data[1];
-	z.avail_out = NET_MAX_PACKET_SIZE - sizeof(u32);
-
-	s32 result = inflateInit(&z);
-	vi_assert(result == Z_OK);
-	
-	result = inflate(&z, Z_NO_FLUSH);
-	vi_assert(result == Z_STREAM_END);
-
-	result = inflateEnd(&z);
-	vi_assert(result == Z_OK);
+	z_stream* z = inflater_get();
+	z->next_in = (Bytef*)&p->data[1];
+	z->avail_in = bytes - sizeof(u32);
+	z->next_out = (Bytef*)&decompressed.data[1];
+	z->avail_out = NET_MAX_PACKET_SIZE - sizeof(u32);
+
+	s32 result = inflate(z, Z_NO_FLUSH);
+	if (result == Z_NEED_DICT)
+	{
+		// packet was compressed with a preset dictionary
+		const Array<u8>& dictionary = compression_dictionary_get();
+		result = dictionary.length > 0
+			? inflateSetDictionary(z, (const Bytef*)dictionary.data, dictionary.length)
+			: Z_DATA_ERROR;
+		if (result != Z_OK)
+		{
+			vi_debug("Discarding packet: inflate needs a dictionary we don't have (%d).", result);
+			return false;
+		}
+		result = inflate(z, Z_NO_FLUSH);
+	}
+	if (result != Z_STREAM_END)
+	{
+		vi_debug("Discarding packet: inflate failed (%d).", result);
+		return false;
+	}
 
 	p->reset();
-	p->resize_bytes(sizeof(u32) + (NET_MAX_PACKET_SIZE - sizeof(u32)) - z.avail_out);
+	p->resize_bytes(sizeof(u32) + (NET_MAX_PACKET_SIZE - sizeof(u32)) - z->avail_out);
 	vi_assert(p->data.length > 0);
 
 	p->data[p->data.length - 1] = 0;
-	memcpy(&p->data[1], &decompressed.data[1], NET_MAX_PACKET_SIZE - z.avail_out);
+	memcpy(&p->data[1], &decompressed.data[1], NET_MAX_PACKET_SIZE - z->avail_out);
 
 	p->bits_read = 32; // skip past the CRC32
+	return true;
+}
+
+#if !RELEASE_BUILD
+// compare the persistent compression contexts against a fresh deflateInit / inflateInit for every packet
+// the given packet must not be finalized yet
+void packet_compression_benchmark(const StreamWrite& packet, s32 iterations)
+{
+	StreamWrite source = packet;
+	source.flush();
+	vi_assert(source.data[0] == NET_PROTOCOL_ID);
+	s32 source_bytes = source.bytes_written() - sizeof(u32);
+	const Array<u8>& dictionary = compression_dictionary_get();
+
+	u8 buffer[NET_MAX_PACKET_SIZE];
+	u8 buffer_inflated[NET_MAX_PACKET_SIZE];
+
+	// one-shot contexts
+	s32 oneshot_bytes = 0;
+	r64 oneshot_deflate_time;
+	r64 oneshot_inflate_time;
+	{
+		r64 start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+		{
+			z_stream z = {};
+			z.next_in = (Bytef*)&source.data[1];
+			z.avail_in = source_bytes;
+			z.next_out = (Bytef*)buffer;
+			z.avail_out = sizeof(buffer);
+			deflateInit(&z, Z_DEFAULT_COMPRESSION);
+			if (dictionary.length > 0)
+				deflateSetDictionary(&z, (const Bytef*)dictionary.data, dictionary.length);
+			deflate(&z, Z_FINISH);
+			oneshot_bytes = s32(sizeof(buffer) - z.avail_out);
+			deflateEnd(&z);
+		}
+		oneshot_deflate_time = platform::time() - start_time;
+
+		start_time = platform::time();
+		for (s32 i = 0; i < iterations; i++)
+		{
+			z_stream z = {};
+			z.next_in = (Bytef*)buffer;
+			z.avail_in = oneshot_bytes;
+			z.next_out = (Bytef*)buffer_inflated;
+			z.avail_out = sizeof(buffer_inflated);
+			inflateInit(&z);
+			if (inflate(&z, Z_NO_FLUSH) == Z_NEED_DICT)
+			{
+				inflateSetDictionary(&z, (const Bytef*)dictionary.data, dictionary.length);
+				inflate(&z, Z_NO_FLUSH);
+			}
+			inflateEnd(&z);
+		}
+		oneshot_inflate_time = platform::time() - start_time;
+	}
+
+	// persistent contexts
+	s32 persistent_bytes = 0;
+	r64 persistent_deflate_time = 0.0;
+	r64 persistent_inflate_time = 0.0;
+	{
+		StreamWrite p;
+		StreamRead r;
+		for (s32 i = 0; i < iterations; i++)
+		{
+			p = source;
+			r64 start_time = platform::time();
+			packet_finalize(&p);
+			persistent_deflate_time += platform::time() - start_time;
+			persistent_bytes = p.bytes_written() - sizeof(u32);
+
+			memcpy(r.data.data, p.data.data, p.bytes_written());
+			r.resize_bytes(p.bytes_written());
+			start_time = platform::time();
+			b8 success = packet_decompress(&r, r.bytes_total);
+			vi_assert(success);
+			persistent_inflate_time += platform::time() - start_time;
+		}
+	}
+
+	r64 scale = 1000000.0 / r64(iterations);
+	vi_debug("%d bytes uncompressed, %d iterations, dictionary %d bytes", source_bytes, iterations, dictionary.length);
+	vi_debug("one-shot: %d bytes, deflate %.2fus, inflate %.2fus", oneshot_bytes, oneshot_deflate_time * scale, oneshot_inflate_time * scale);
+	vi_debug("persistent: %d bytes, deflate %.2fus, inflate %.2fus", persistent_bytes, persistent_deflate_time * scale, persistent_inflate_time * scale);
 }
+#endif
 
 // true if s1 > s2
 b8 sequence_more_recent(SequenceID s1, SequenceID s2)
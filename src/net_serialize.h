@@ -17,6 +17,9 @@ namespace Net
 #define NET_PROTOCOL_ID 0x6906c2fe
 
 u32 crc32(const u8*, memory_index, u32 value = 0);
+#if !RELEASE_BUILD
+void benchmark_crc32();
+#endif
 
 struct StreamWrite
 {
@@ -25,14 +28,17 @@ struct StreamWrite
 
 	static inline void error() { vi_debug_break(); }
 
-	u64 scratch;
-	s32 scratch_bits; // number of bits we've used in the last u32
+	u64 scratch; // bits go in at the bottom; written out to data 64 at a time
+	s32 scratch_bits; // number of bits in the scratch that haven't made it into data yet
 	StaticArray<u32, NET_MAX_PACKET_SIZE / sizeof(u32)> data;
 
 	StreamWrite();
 	b8 would_overflow(s32) const;
 	void bits(u32, s32);
+	void bits_array(const u32*, s32, s32); // same as calling bits() on each value with the same width
+	void word(u64);
 	void bytes(const u8*, s32);
+	void append(const StreamWrite&);
 	s32 bits_written() const;
 	s32 bytes_written() const;
 	s32 align_bits() const;
@@ -49,16 +55,16 @@ struct StreamRead
 
 	static inline void error() { }
 
-	u64 scratch;
-	s32 scratch_bits;
 	StaticArray<u32, NET_MAX_PACKET_SIZE / sizeof(u32)> data;
-	s32 bits_read;
+	s32 bits_read; // the only read state; every field is pulled straight out of data from here
 	s32 bytes_total;
 
 	StreamRead();
 	b8 read_checksum();
 	b8 would_overflow(s32) const;
 	void bits(u32&, s32);
+	void bits_array(u32*, s32, s32);
+	u32 field(s32, s32) const;
 	void bytes(u8*, s32);
 	s32 align_bits() const;
 	b8 align();
@@ -68,11 +74,72 @@ struct StreamRead
 	void rewind(s32 = 0);
 };
 
+// every serialize_* macro ends up in one of these, so they live here where they can be inlined
+
+// move a full 64-bit scratch into the buffer
+inline void StreamWrite::word(u64 w)
+{
+	s32 length = data.length;
+	vi_assert(length + 2 <= data.capacity());
+	data.data[length] = u32(w);
+	data.data[length + 1] = u32(w >> 32);
+	data.length = u16(length + 2);
+}
+
+inline void StreamWrite::bits(u32 value, s32 bits)
+{
+	vi_assert(bits >= 0);
+	vi_assert(bits <= 32);
+	vi_assert(scratch_bits >= 0 && scratch_bits < 64);
+	u64 v = u64(value) & ((u64(1) << bits) - 1);
+
+	scratch |= v << scratch_bits;
+	scratch_bits += bits;
+
+	if (scratch_bits >= 64)
+	{
+		word(scratch);
+		scratch_bits -= 64;
+		scratch = v >> (bits - scratch_bits); // whatever didn't fit
+	}
+}
+
+// a field is at most 32 bits starting at most 31 bits into a word, so it always fits in the two words starting at its first bit
+inline u32 StreamRead::field(s32 position, s32 bits) const
+{
+	s32 index = position >> 5;
+	s32 shift = position & 31;
+	u64 window = data.data[index];
+	if (shift + bits > 32)
+		window |= u64(data.data[index + 1]) << 32;
+	return u32((window >> shift) & ((u64(1) << bits) - 1));
+}
+
+inline void StreamRead::bits(u32& output, s32 bits)
+{
+	vi_assert(bits >= 0);
+	vi_assert(bits <= 32);
+	vi_assert(bits_read + bits <= data.length * 32);
+
+	if (bits == 0)
+	{
+		output = 0;
+		return;
+	}
+
+	output = field(bits_read, bits);
+	bits_read += bits;
+}
+
 typedef u16 SequenceID;
 
 void packet_init(StreamWrite*);
 void packet_finalize(StreamWrite*);
-void packet_decompress(StreamRead*, s32);
+b8 packet_decompress(StreamRead*, s32); // false if the packet is garbage and should be dropped
+void packet_compression_dictionary(const u8*, s32);
+#if !RELEASE_BUILD
+void packet_compression_benchmark(const StreamWrite&, s32);
+#endif
 
 // true if s1 > s2
 b8 sequence_more_recent(SequenceID, SequenceID);
@@ -238,6 +305,35 @@ do\
 		value = _min + r32(_u) / _q;\
 } while (0)
 
+// quantizes exactly like serialize_r32_range, for runs of values sharing one range
+#define serialize_r32_range_array(stream, values, _count, _min, _max, _bits)\
+do\
+{\
+	vi_assert(_min < _max);\
+	vi_assert(_bits > 0 && _bits < 32);\
+	vi_assert(_count <= 32);\
+	if ((stream)->would_overflow(_bits * _count))\
+		net_error();\
+	u32 _u[32];\
+	u32 _umax = (1 << _bits) - 1;\
+	r32 _q = r32(_umax) / r32(_max - _min);\
+	if (Stream::IsWriting)\
+	{\
+		for (s32 _i = 0; _i < _count; _i++)\
+		{\
+			r32 _v = values[_i] < _min ? _min : values[_i];\
+			_u[_i] = u32(r32(_v - _min) * _q);\
+			_u[_i] = _u[_i] < _umax ? _u[_i] : _umax;\
+		}\
+	}\
+	(stream)->bits_array(_u, _count, _bits);\
+	if (Stream::IsReading)\
+	{\
+		for (s32 _i = 0; _i < _count; _i++)\
+			values[_i] = _min + r32(_u[_i]) / _q;\
+	}\
+} while (0)
+
 #define serialize_r64(stream, value)\
 do\
 {\
@@ -359,15 +455,22 @@ template<typename Stream> b8 serialize_quat(Stream* p, Quat* rot, Resolution r)
 		}
 	}
 	s32 bits = r == Resolution::High ? 16 : 9;
-	serialize_r32_range(p, q[indices[0]], -0.707107f, 0.707107f, bits);
-	serialize_r32_range(p, q[indices[1]], -0.707107f, 0.707107f, bits);
-	serialize_r32_range(p, q[indices[2]], -0.707107f, 0.707107f, bits);
+	r32 components[3];
+	if (Stream::IsWriting)
+	{
+		for (s32 i = 0; i < 3; i++)
+			components[i] = q[indices[i]];
+	}
+	serialize_r32_range_array(p, components, 3, -0.707107f, 0.707107f, bits);
 
 	if (Stream::IsReading)
 	{
-		r32 a = q[indices[0]];
-		r32 b = q[indices[1]];
-		r32 c = q[indices[2]];
+		r32 a = components[0];
+		r32 b = components[1];
+		r32 c = components[2];
+		q[indices[0]] = a;
+		q[indices[1]] = b;
+		q[indices[2]] = c;
 		q[largest_index] = sqrtf(1.0f - (a * a) - (b * b) - (c * c));
 		*rot = q;
 	}
@@ -5,6 +5,8 @@
 #include "game/game.h"
 #include "game/entities.h"
 #include "game/player.h"
+#include "profile.h"
+#include "jobs.h"
 
 namespace VI
 {
@@ -17,10 +19,14 @@ btDiscreteDynamicsWorld* Physics::btWorld = new btDiscreteDynamicsWorld(dispatch
 
 void Physics::loop(PhysicsSwapper* swapper)
 {
+	vi_profile_thread("physics");
 	PhysicsSync* data = swapper->swap<SwapType::Read>();
 	while (!data->quit)
 	{
-		btWorld->stepSimulation(vi_min(data->time.delta, 0.1f), 3, data->timestep);
+		{
+			vi_profile("Physics::loop");
+			btWorld->stepSimulation(vi_min(data->time.delta, 0.1f), 3, data->timestep);
+		}
 		data = swapper->swap<SwapType::Read>();
 	}
 }
@@ -118,6 +124,173 @@ void Physics::raycast(btCollisionWorld::AllHitsRayResultCallback* ray_callback,
 	Physics::btWorld->rayTest(ray_callback->m_rayFromWorld, ray_callback->m_rayToWorld, *ray_callback);
 }
 
+#define RAYCAST_BATCH_GRAIN 4 // minimum queries per job
+#define RAYCAST_BATCH_JOBS 256 // plenty to keep every thread busy; past this, jobs get bigger instead of more numerous
+
+s32 RaycastBatch::add(const Vec3& a, const Vec3& b, s16 m, r32 r)
+{
+	s32 index = start.length;
+	start.add(a);
+	end.add(b);
+	radius.add(r);
+	mask.add(m);
+	return index;
+}
+
+void RaycastBatch::clear()
+{
+	start.length = 0;
+	end.length = 0;
+	radius.length = 0;
+	mask.length = 0;
+	fraction.length = 0;
+	point.length = 0;
+	normal.length = 0;
+	entity.length = 0;
+	group.length = 0;
+}
+
+// btCollisionWorld::rayTest() and convexSweepTest() walk the broadphase with a stack that belongs to the
+// broadphase, so they can't run on more than one thread at a time. these walk it with their own stack
+// and hand each candidate to the same narrowphase tests bullet uses
+struct BatchRayCollide : btDbvt::ICollide
+{
+	btCollisionWorld::ClosestRayResultCallback* callback;
+	btTransform from;
+	btTransform to;
+
+	void Process(const btDbvtNode* leaf)
+	{
+		btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+		if (callback->needsCollision(proxy))
+		{
+			btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+			btCollisionWorld::rayTestSingle(from, to, object, object->getCollisionShape(), object->getWorldTransform(), *callback);
+		}
+	}
+};
+
+struct BatchSweepCollide : btDbvt::ICollide
+{
+	btCollisionWorld::ClosestConvexResultCallback* callback;
+	const btConvexShape* shape;
+	btTransform from;
+	btTransform to;
+
+	void Process(const btDbvtNode* leaf)
+	{
+		btBroadphaseProxy* proxy = (btBroadphaseProxy*)leaf->data;
+		if (callback->needsCollision(proxy))
+		{
+			btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+			btCollisionWorld::objectQuerySingle(shape, from, to, object, object->getCollisionShape(), object->getWorldTransform(), *callback, Physics::btWorld->getDispatchInfo().m_allowedCcdPenetration);
+		}
+	}
+};
+
+void raycast_batch_job(void* context, s32 begin, s32 end)
+{
+	RaycastBatch* batch = (RaycastBatch*)context;
+	for (s32 i = begin; i < end; i++)
+	{
+		const btVector3 a = batch->start[i];
+		const btVector3 b = batch->end[i];
+
+		const btCollisionObject* hit_object;
+		btVector3 hit_point;
+		btVector3 hit_normal;
+		r32 hit_fraction;
+		if (batch->radius[i] > 0.0f)
+		{
+			btSphereShape sphere(batch->radius[i]);
+			btCollisionWorld::ClosestConvexResultCallback callback(a, b);
+			callback.m_collisionFilterMask = batch->mask[i];
+			callback.m_collisionFilterGroup = -1;
+
+			BatchSweepCollide collide;
+			collide.callback = &callback;
+			collide.shape = &sphere;
+			collide.from = btTransform(btQuaternion::getIdentity(), a);
+			collide.to = btTransform(btQuaternion::getIdentity(), b);
+
+			btVector3 radius(batch->radius[i], batch->radius[i], batch->radius[i]);
+			btVector3 bounds_min = a;
+			bounds_min.setMin(b);
+			btVector3 bounds_max = a;
+			bounds_max.setMax(b);
+			btDbvtVolume volume = btDbvtVolume::FromMM(bounds_min - radius, bounds_max + radius);
+			for (s32 j = 0; j < 2; j++)
+				Physics::broadphase->m_sets[j].collideTV(Physics::broadphase->m_sets[j].m_root, volume, collide);
+
+			hit_object = callback.hasHit() ? callback.m_hitCollisionObject : nullptr;
+			hit_point = callback.m_hitPointWorld;
+			hit_normal = callback.m_hitNormalWorld;
+			hit_fraction = callback.m_closestHitFraction;
+		}
+		else
+		{
+			btCollisionWorld::ClosestRayResultCallback callback(a, b);
+			callback.m_flags = btTriangleRaycastCallback::EFlags::kF_FilterBackfaces
+				| btTriangleRaycastCallback::EFlags::kF_KeepUnflippedNormal;
+			callback.m_collisionFilterMask = batch->mask[i];
+			callback.m_collisionFilterGroup = -1;
+
+			BatchRayCollide collide;
+			collide.callback = &callback;
+			collide.from = btTransform(btQuaternion::getIdentity(), a);
+			collide.to = btTransform(btQuaternion::getIdentity(), b);
+			for (s32 j = 0; j < 2; j++)
+				btDbvt::rayTest(Physics::broadphase->m_sets[j].m_root, a, b, collide);
+
+			hit_object = callback.hasHit() ? callback.m_collisionObject : nullptr;
+			hit_point = callback.m_hitPointWorld;
+			hit_normal = callback.m_hitNormalWorld;
+			hit_fraction = callback.m_closestHitFraction;
+		}
+
+		if (hit_object)
+		{
+			batch->fraction[i] = hit_fraction;
+			batch->point[i] = hit_point;
+			batch->normal[i] = hit_normal;
+			batch->entity[i] = ID(hit_object->getUserIndex());
+			batch->group[i] = hit_object->getBroadphaseHandle()->m_collisionFilterGroup;
+		}
+		else
+		{
+			batch->fraction[i] = 1.0f;
+			batch->point[i] = batch->end[i];
+			batch->normal[i] = Vec3::zero;
+			batch->entity[i] = IDNull;
+			batch->group[i] = 0;
+		}
+	}
+}
+
+void Physics::raycast(RaycastBatch* batch)
+{
+	vi_profile("Physics::raycast batch");
+	s32 count = batch->count();
+	batch->fraction.resize(count);
+	batch->point.resize(count);
+	batch->normal.resize(count);
+	batch->entity.resize(count);
+	batch->group.resize(count);
+
+	// any size works; Jobs::run splits passes that don't fit in one wave
+	Jobs::Pass pass =
+	{
+		"Physics::raycast",
+		&raycast_batch_job,
+		batch,
+		count,
+		vi_max(RAYCAST_BATCH_GRAIN, (count + RAYCAST_BATCH_JOBS - 1) / RAYCAST_BATCH_JOBS),
+		RigidBody::component_mask,
+		0,
+	};
+	Jobs::run(pass);
+}
+
 PinArray<RigidBody::Constraint, MAX_ENTITIES> RigidBody::global_constraints;
 
 RigidBody::RigidBody(Type type, const Vec3& size, r32 mass, s16 group, s16 mask, AssetID mesh_id, s8 flags)
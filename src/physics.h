@@ -48,6 +48,38 @@ struct RaycastCallbackExcept : btCollisionWorld::ClosestRayResultCallback
 	void ignore(const Entity*);
 };
 
+// independent ray and sphere sweep queries, run together across the job threads.
+// each query gets the closest hit, with the same filtering as Physics::raycast.
+// results come back as parallel arrays indexed the same as the queries. there's no limit on batch size
+struct RaycastBatch
+{
+	// queries
+	Array<Vec3> start;
+	Array<Vec3> end;
+	Array<r32> radius; // 0 for a plain ray
+	Array<s16> mask;
+
+	// results
+	Array<r32> fraction; // 1 if nothing was hit
+	Array<Vec3> point;
+	Array<Vec3> normal;
+	Array<ID> entity; // IDNull if nothing was hit
+	Array<s16> group; // collision group of whatever was hit
+
+	s32 add(const Vec3&, const Vec3&, s16 = ~CollisionTarget & ~CollisionWalker, r32 = 0.0f);
+	void clear();
+
+	inline s32 count() const
+	{
+		return start.length;
+	}
+
+	inline b8 hit(s32 i) const
+	{
+		return entity[i] != IDNull;
+	}
+};
+
 struct PhysicsSync
 {
 	b8 quit;
@@ -71,6 +103,7 @@ struct Physics
 
 	static void raycast(btCollisionWorld::ClosestRayResultCallback*, s16 = ~CollisionTarget & ~CollisionWalker);
 	static void raycast(btCollisionWorld::AllHitsRayResultCallback*, s16 = ~CollisionTarget & ~CollisionWalker);
+	static void raycast(RaycastBatch*);
 };
 
 struct RigidBody : public ComponentType<RigidBody>
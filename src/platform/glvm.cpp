@@ -4,6 +4,7 @@
 #include "render/glvm.h"
 #include "vi_assert.h"
 #include "types.h"
+#include "profile.h"
 
 namespace VI
 {
@@ -296,6 +297,7 @@ GLenum gl_primitive_modes[] =
 
 void render(RenderSync* sync)
 {
+	vi_profile("render");
 	sync->read_pos = 0;
 	while (sync->read_pos < sync->queue.length)
 	{
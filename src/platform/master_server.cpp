@@ -6,11 +6,16 @@
 #include "game/master.h"
 
 #include <thread>
+#include <mutex>
+#include <condition_variable>
 #if _WIN32
 #include <Windows.h>
 #else
 #include <sys/stat.h>
 #endif
+#if __linux__
+#include <sys/epoll.h>
+#endif
 #include <time.h>
 #include <chrono>
 #include <ctime>
@@ -313,6 +318,15 @@ namespace Master
 #define MASTER_SETTINGS_FILE "config.txt"
 #define MASTER_TOKEN_TIMEOUT (86400 * 2)
 #define MASTER_SERVER_LOAD_TIMEOUT 10.0
+#define MASTER_TIMER_RESOLUTION (1.0 / 60.0)
+#define MASTER_RECEIVE_BATCHES 8 // max batches of SOCK_BATCH_SIZE packets to handle before checking timers
+#define MASTER_DB_BUSY_TIMEOUT 100 // milliseconds the packet thread will wait on the writer's lock before giving up
+#define MASTER_DB_WRITER_BUSY_TIMEOUT 2000 // the writer thread can afford to wait
+#define MASTER_DB_WRITE_BATCH_MAX 64 // queued writes per transaction
+#define MASTER_DB_WRITE_TRANSACTION_MAX 0.02 // seconds the writer may hold the write lock before committing
+#define MASTER_DB_CHECKPOINT_INTERVAL 5.0 // seconds between WAL checkpoints on the writer thread
+#define MASTER_DB_WRITE_PARAMS 4
+#define MASTER_DB_WRITE_TEXT 63
 
 	r64 real_timestamp;
 	r64 global_timestamp;
@@ -375,9 +389,20 @@ namespace Master
 		s8 slots;
 	};
 
+	struct DbStatement
+	{
+		sqlite3_stmt* stmt;
+		b8 active; // handed out by db_query and not given back yet
+	};
+
+	// prepared statements keyed by a hash of their SQL text
+	typedef std::unordered_map<u64, DbStatement> DbStatementCache;
+
 	struct Global
 	{
 		sqlite3* db;
+		DbStatementCache statements;
+		s32 statements_active;
 		std::unordered_map<u64, Node> nodes;
 		std::unordered_map<u32, Sock::Address> server_config_map;
 		Sock::Handle sock;
@@ -388,18 +413,65 @@ namespace Master
 	};
 	Global global;
 
-	sqlite3_stmt* db_query(const char* sql)
+	u64 db_hash(const char* sql)
+	{
+		u64 hash = 14695981039346656037ULL;
+		for (const char* c = sql; *c; c++)
+			hash = (hash ^ u64(u8(*c))) * 1099511628211ULL;
+		return hash;
+	}
+
+	sqlite3_stmt* db_prepare(sqlite3* db, const char* sql)
 	{
 		sqlite3_stmt* stmt;
-		if (sqlite3_prepare_v2(global.db, sql, -1, &stmt, nullptr))
+		if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr))
 		{
-			fprintf(stderr, "SQL: Failed to prepare statement: %s\nError: %s", sql, sqlite3_errmsg(global.db));
+			fprintf(stderr, "SQL: Failed to prepare statement: %s\nError: %s", sql, sqlite3_errmsg(db));
 			vi_assert(false);
 		}
+		return stmt;
+	}
+
+	// returns null if a different statement already has this hash
+	DbStatement* db_statement_get(sqlite3* db, DbStatementCache* cache, const char* sql)
+	{
+		u64 hash = db_hash(sql);
+		auto i = cache->find(hash);
+		if (i == cache->end())
+		{
+			DbStatement entry;
+			entry.stmt = db_prepare(db, sql);
+			entry.active = false;
+			return &cache->insert(std::pair<u64, DbStatement>(hash, entry)).first->second;
+		}
+		else if (strcmp(sqlite3_sql(i->second.stmt), sql) == 0)
+			return &i->second;
+		else
+			return nullptr;
+	}
+
+	void db_statements_clear(DbStatementCache* cache)
+	{
+		for (auto i = cache->begin(); i != cache->end(); i++)
+			sqlite3_finalize(i->second.stmt);
+		cache->clear();
+	}
+
+	// statements are prepared once and reused; db_finalize() just resets them.
+	// a query that's already in use (nested inside a loop over the same query) gets a one-off statement
+	sqlite3_stmt* db_query(const char* sql)
+	{
 #if DEBUG_SQL
 		printf("%s\n", sql);
 #endif
-		return stmt;
+		DbStatement* entry = db_statement_get(global.db, &global.statements, sql);
+		if (entry && !entry->active)
+		{
+			entry->active = true;
+			global.statements_active++;
+			return entry->stmt;
+		}
+		return db_prepare(global.db, sql);
 	}
 
 	void db_bind_int(sqlite3_stmt* stmt, s32 index, s64 value)
@@ -437,19 +509,24 @@ namespace Master
 			return server->server.public_ipv6.port ? server->server.public_ipv6 : server->server.public_ipv4;
 	}
 
-	b8 db_step(sqlite3_stmt* stmt)
+	// SQLITE_ROW, SQLITE_DONE, or SQLITE_BUSY if the writer held the lock past MASTER_DB_BUSY_TIMEOUT.
+	// we don't stall the packet loop on a busy database; the statement is dropped and the caller has to deal with it
+	s32 db_step_result(sqlite3_stmt* stmt)
 	{
 		s32 result = sqlite3_step(stmt);
-		if (result == SQLITE_ROW)
-			return true;
-		else if (result == SQLITE_DONE)
-			return false;
-		else
+		if (result == SQLITE_BUSY)
+			fprintf(stderr, "SQL: Database busy, statement dropped: %s\n", sqlite3_sql(stmt));
+		else if (result != SQLITE_ROW && result != SQLITE_DONE)
 		{
 			fprintf(stderr, "SQL: Failed to step query.\nError: %s", sqlite3_errmsg(global.db));
 			vi_assert(false);
-			return false;
 		}
+		return result;
+	}
+
+	b8 db_step(sqlite3_stmt* stmt)
+	{
+		return db_step_result(stmt) == SQLITE_ROW;
 	}
 
 	s64 db_column_int(sqlite3_stmt* stmt, s32 index)
@@ -469,19 +546,54 @@ namespace Master
 
 	void db_finalize(sqlite3_stmt* stmt)
 	{
-		if (sqlite3_finalize(stmt))
+		auto i = global.statements.find(db_hash(sqlite3_sql(stmt)));
+		if (i != global.statements.end() && i->second.stmt == stmt)
+		{
+			// back into the cache. any step error has already been reported
+			vi_assert(i->second.active);
+			sqlite3_reset(stmt);
+			sqlite3_clear_bindings(stmt);
+			i->second.active = false;
+			global.statements_active--;
+		}
+		else if (sqlite3_finalize(stmt))
 		{
 			fprintf(stderr, "SQL: Failed to finalize query.\nError: %s", sqlite3_errmsg(global.db));
 			vi_assert(false);
 		}
 	}
 
-	s64 db_exec(sqlite3_stmt* stmt)
+	// puts back anything abandoned by an early return, like net_error() on a bad packet.
+	// called between packets and timers, when no query can legitimately be in progress
+	void db_statements_release()
+	{
+		if (global.statements_active == 0)
+			return;
+
+		for (auto i = global.statements.begin(); i != global.statements.end(); i++)
+		{
+			if (i->second.active)
+			{
+				sqlite3_reset(i->second.stmt);
+				sqlite3_clear_bindings(i->second.stmt);
+				i->second.active = false;
+			}
+		}
+		global.statements_active = 0;
+	}
+
+	// false if the statement was dropped. in that case rowid is untouched;
+	// sqlite3_last_insert_rowid() would still hold whatever the last successful insert got
+	b8 db_exec(sqlite3_stmt* stmt, s64* rowid = nullptr)
 	{
-		b8 more = db_step(stmt);
-		vi_assert(!more); // this kind of query shouldn't return any rows
+		s32 result = db_step_result(stmt);
+		vi_assert(result != SQLITE_ROW); // this kind of query shouldn't return any rows
 		db_finalize(stmt);
-		return sqlite3_last_insert_rowid(global.db);
+		if (result != SQLITE_DONE)
+			return false;
+		if (rowid)
+			*rowid = sqlite3_last_insert_rowid(global.db);
+		return true;
 	}
 	
 	void db_exec(const char* sql)
@@ -497,6 +609,215 @@ namespace Master
 		}
 	}
 
+	// writes that nobody reads back right away go to a second connection on a background thread,
+	// which commits whatever has piled up in one transaction. the packet thread never waits on an fsync:
+	// in WAL mode with synchronous=normal a commit doesn't sync, and only the writer thread checkpoints.
+	struct DbWrite
+	{
+		enum class Type : s8
+		{
+			Null,
+			Int,
+			Text,
+		};
+
+		struct Param
+		{
+			s64 value;
+			Type type;
+			char text[MASTER_DB_WRITE_TEXT + 1];
+		};
+
+		const char* sql; // must live forever
+		Param params[MASTER_DB_WRITE_PARAMS];
+		s32 param_count;
+	};
+
+	struct DbWriter
+	{
+		sqlite3* db;
+		DbStatementCache statements; // writer thread only
+		std::thread* thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		Array<DbWrite> queue; // guarded by mutex
+		b8 quit; // guarded by mutex
+	};
+	DbWriter db_writer;
+
+	DbWrite db_write(const char* sql)
+	{
+		DbWrite write;
+		write.sql = sql;
+		write.param_count = 0;
+		return write;
+	}
+
+	DbWrite::Param* db_write_param(DbWrite* write, s32 index)
+	{
+		vi_assert(index >= 0 && index < MASTER_DB_WRITE_PARAMS);
+		write->param_count = vi_max(write->param_count, index + 1);
+		return &write->params[index];
+	}
+
+	void db_write_bind_int(DbWrite* write, s32 index, s64 value)
+	{
+		DbWrite::Param* param = db_write_param(write, index);
+		param->type = DbWrite::Type::Int;
+		param->value = value;
+	}
+
+	void db_write_bind_null(DbWrite* write, s32 index)
+	{
+		db_write_param(write, index)->type = DbWrite::Type::Null;
+	}
+
+	void db_write_bind_text(DbWrite* write, s32 index, const char* text)
+	{
+		DbWrite::Param* param = db_write_param(write, index);
+		param->type = DbWrite::Type::Text;
+		vi_assert(strlen(text) <= MASTER_DB_WRITE_TEXT);
+		strncpy(param->text, text, MASTER_DB_WRITE_TEXT);
+		param->text[MASTER_DB_WRITE_TEXT] = '\0';
+	}
+
+	void db_write_queue(const DbWrite& write)
+	{
+#if DEBUG_SQL
+		printf("(queued) %s\n", write.sql);
+#endif
+		{
+			std::lock_guard<std::mutex> lock(db_writer.mutex);
+			db_writer.queue.add(write);
+		}
+		db_writer.condition.notify_one();
+	}
+
+	void db_writer_exec(const char* sql)
+	{
+		char* err;
+		if (sqlite3_exec(db_writer.db, sql, nullptr, nullptr, &err))
+		{
+			fprintf(stderr, "SQL statement failed: %s\nError: %s", sql, err);
+			sqlite3_free(err);
+		}
+	}
+
+	void db_writer_step(const DbWrite& write)
+	{
+		DbStatement* entry = db_statement_get(db_writer.db, &db_writer.statements, write.sql);
+		sqlite3_stmt* stmt = entry ? entry->stmt : db_prepare(db_writer.db, write.sql);
+
+		for (s32 i = 0; i < write.param_count; i++)
+		{
+			const DbWrite::Param& param = write.params[i];
+			s32 result;
+			if (param.type == DbWrite::Type::Int)
+				result = sqlite3_bind_int64(stmt, i + 1, param.value);
+			else if (param.type == DbWrite::Type::Text)
+				result = sqlite3_bind_text(stmt, i + 1, param.text, -1, SQLITE_STATIC);
+			else
+				result = sqlite3_bind_null(stmt, i + 1);
+			if (result)
+				fprintf(stderr, "SQL: Could not bind parameter at index %d.\nError: %s", i, sqlite3_errmsg(db_writer.db));
+		}
+
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+			fprintf(stderr, "SQL: Failed to step queued write: %s\nError: %s", write.sql, sqlite3_errmsg(db_writer.db));
+
+		if (entry)
+		{
+			sqlite3_reset(stmt);
+			sqlite3_clear_bindings(stmt);
+		}
+		else
+			sqlite3_finalize(stmt);
+	}
+
+	void db_writer_loop()
+	{
+		Array<DbWrite> batch;
+		r64 checkpoint_timestamp = platform::time();
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(db_writer.mutex);
+				if (db_writer.queue.length == 0 && !db_writer.quit)
+					db_writer.condition.wait_for(lock, std::chrono::duration<r64>(MASTER_DB_CHECKPOINT_INTERVAL));
+				if (db_writer.queue.length == 0 && db_writer.quit)
+					break;
+				batch.resize(db_writer.queue.length);
+				if (batch.length > 0)
+					memcpy(batch.data, db_writer.queue.data, sizeof(DbWrite) * batch.length);
+				db_writer.queue.length = 0;
+			}
+
+			// whatever piled up while the last batch was going in gets written in as few transactions as possible,
+			// but commit often enough that the packet thread never waits long on the lock
+			s32 i = 0;
+			while (i < batch.length)
+			{
+				r64 transaction_start = platform::time();
+				s32 transaction_end = vi_min(batch.length, i + MASTER_DB_WRITE_BATCH_MAX);
+				db_writer_exec("begin immediate;");
+				while (i < transaction_end)
+				{
+					db_writer_step(batch[i]);
+					i++;
+					if (platform::time() - transaction_start > MASTER_DB_WRITE_TRANSACTION_MAX)
+						break;
+				}
+				db_writer_exec("commit;");
+			}
+
+			r64 t = platform::time();
+			if (t - checkpoint_timestamp > MASTER_DB_CHECKPOINT_INTERVAL)
+			{
+				// the packet thread's connection never checkpoints, so the WAL gets folded back in (and synced) here
+				sqlite3_wal_checkpoint_v2(db_writer.db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+				checkpoint_timestamp = t;
+			}
+		}
+	}
+
+	s64 server_config_score(s64, s64);
+
+	// so queued play count updates can compute the score in the same statement as the increment
+	void db_server_config_score(sqlite3_context* context, int argc, sqlite3_value** argv)
+	{
+		sqlite3_result_int64(context, server_config_score(sqlite3_value_int64(argv[0]), sqlite3_value_int64(argv[1])));
+	}
+
+	b8 db_writer_init(const char* path)
+	{
+		if (sqlite3_open(path, &db_writer.db))
+		{
+			fprintf(stderr, "Can't open sqlite database for writing: %s", sqlite3_errmsg(db_writer.db));
+			return false;
+		}
+		sqlite3_busy_timeout(db_writer.db, MASTER_DB_WRITER_BUSY_TIMEOUT);
+		db_writer_exec("pragma synchronous=normal;");
+		sqlite3_create_function(db_writer.db, "server_config_score", 2, SQLITE_UTF8, nullptr, &db_server_config_score, nullptr, nullptr);
+		db_writer.quit = false;
+		db_writer.thread = new std::thread(&db_writer_loop);
+		return true;
+	}
+
+	// commits everything still queued
+	void db_writer_term()
+	{
+		{
+			std::lock_guard<std::mutex> lock(db_writer.mutex);
+			db_writer.quit = true;
+		}
+		db_writer.condition.notify_one();
+		db_writer.thread->join();
+		delete db_writer.thread;
+		db_writer.thread = nullptr;
+		db_statements_clear(&db_writer.statements);
+		sqlite3_close(db_writer.db);
+	}
+
 	Node* node_add_or_get(const Sock::Address& addr)
 	{
 		u64 hash = addr.hash();
@@ -607,20 +928,22 @@ namespace Master
 		sqlite3_stmt* stmt = db_query("select role from UserServer where user_id=? and server_id=? limit 1;");
 		db_bind_int(stmt, 0, user_id);
 		db_bind_int(stmt, 1, config_id);
+		Role role = Role::None;
 		if (db_step(stmt))
-			return Role(db_column_int(stmt, 0));
-		else
-			return Role::None;
+			role = Role(db_column_int(stmt, 0));
+		db_finalize(stmt);
+		return role;
 	}
 
 	b8 user_is_vip(u32 user_id)
 	{
 		sqlite3_stmt* stmt = db_query("select vip from User where id=? limit 1;");
 		db_bind_int(stmt, 0, user_id);
+		b8 vip = false;
 		if (db_step(stmt))
-			return b8(db_column_int(stmt, 0));
-		else
-			return false;
+			vip = b8(db_column_int(stmt, 0));
+		db_finalize(stmt);
+		return vip;
 	}
 
 	void username_vip_get(u32 user_id, char* username, b8* vip = nullptr)
@@ -639,6 +962,7 @@ namespace Master
 			if (vip)
 				*vip = false;
 		}
+		db_finalize(stmt);
 	}
 
 	b8 server_details_get(u32 config_id, u32 user_id, ServerDetails* details, Sock::Host::Type addr_type)
@@ -674,17 +998,17 @@ namespace Master
 	{
 		{
 			// record auth attempt
-			sqlite3_stmt* stmt = db_query("insert into AuthAttempt (timestamp, type, ip, user_id) values (?, ?, ?, ?);");
-			db_bind_int(stmt, 0, platform::timestamp());
-			db_bind_int(stmt, 1, s32(auth_type));
+			DbWrite write = db_write("insert into AuthAttempt (timestamp, type, ip, user_id) values (?, ?, ?, ?);");
+			db_write_bind_int(&write, 0, platform::timestamp());
+			db_write_bind_int(&write, 1, s32(auth_type));
 			char ip[NET_MAX_ADDRESS];
 			addr.str_ip_only(ip);
-			db_bind_text(stmt, 2, ip);
+			db_write_bind_text(&write, 2, ip);
 			if (key)
-				db_bind_int(stmt, 3, key->id);
+				db_write_bind_int(&write, 3, key->id);
 			else
-				db_bind_null(stmt, 3);
-			db_exec(stmt);
+				db_write_bind_null(&write, 3);
+			db_write_queue(write);
 		}
 
 		using Stream = StreamWrite;
@@ -727,6 +1051,7 @@ namespace Master
 			{
 				UserKey key;
 				key.token = u32(mersenne::rand());
+				b8 saved = true;
 
 				// save user in database
 
@@ -746,7 +1071,7 @@ namespace Master
 						db_bind_int(stmt, 1, platform::timestamp());
 						db_bind_text(stmt, 2, username);
 						db_bind_int(stmt, 3, key.id);
-						db_exec(stmt);
+						saved = db_exec(stmt);
 					}
 				}
 				else
@@ -757,11 +1082,16 @@ namespace Master
 					db_bind_int(stmt, 1, platform::timestamp());
 					db_bind_int(stmt, 2, itch_id);
 					db_bind_text(stmt, 3, username);
-					key.id = s32(db_exec(stmt));
+					s64 id;
+					saved = db_exec(stmt, &id);
+					if (saved)
+						key.id = s32(id);
 				}
 				db_finalize(stmt);
 
-				if (success)
+				if (!saved) // don't hand out a key the database doesn't know about
+					send_auth_response(node->addr, AuthType::Itch, nullptr, nullptr);
+				else if (success)
 				{
 					node->client.user_key = key;
 					send_auth_response(node->addr, AuthType::Itch, &key, username);
@@ -853,6 +1183,7 @@ namespace Master
 			{
 				UserKey key;
 				key.token = u32(mersenne::rand());
+				b8 saved = true;
 
 				// save user in database
 
@@ -872,7 +1203,7 @@ namespace Master
 						db_bind_int(stmt, 1, platform::timestamp());
 						db_bind_text(stmt, 2, username);
 						db_bind_int(stmt, 3, key.id);
-						db_exec(stmt);
+						saved = db_exec(stmt);
 					}
 				}
 				else
@@ -883,11 +1214,16 @@ namespace Master
 					db_bind_int(stmt, 1, platform::timestamp());
 					db_bind_int(stmt, 2, gamejolt_id);
 					db_bind_text(stmt, 3, username);
-					key.id = s32(db_exec(stmt));
+					s64 id;
+					saved = db_exec(stmt, &id);
+					if (saved)
+						key.id = s32(id);
 				}
 				db_finalize(stmt);
 
-				if (success)
+				if (!saved) // don't hand out a key the database doesn't know about
+					send_auth_response(node->addr, AuthType::GameJolt, nullptr, nullptr);
+				else if (success)
 				{
 					node->client.user_key = key;
 					send_auth_response(node->addr, AuthType::GameJolt, &key, username);
@@ -981,6 +1317,7 @@ namespace Master
 			{
 				UserKey key;
 				key.token = u32(mersenne::rand());
+				b8 saved = true;
 
 				// save user in database
 
@@ -1000,7 +1337,7 @@ namespace Master
 						db_bind_int(stmt, 1, platform::timestamp());
 						db_bind_text(stmt, 2, username);
 						db_bind_int(stmt, 3, key.id);
-						db_exec(stmt);
+						saved = db_exec(stmt);
 					}
 				}
 				else
@@ -1011,11 +1348,16 @@ namespace Master
 					db_bind_int(stmt, 1, platform::timestamp());
 					db_bind_int(stmt, 2, steam_id);
 					db_bind_text(stmt, 3, username);
-					key.id = s32(db_exec(stmt));
+					s64 id;
+					saved = db_exec(stmt, &id);
+					if (saved)
+						key.id = s32(id);
 				}
 				db_finalize(stmt);
 
-				if (success)
+				if (!saved) // don't hand out a key the database doesn't know about
+					send_auth_response(node->addr, AuthType::Steam, nullptr, nullptr);
+				else if (success)
 				{
 					node->client.user_key = key;
 					send_auth_response(node->addr, AuthType::Steam, &key, username);
@@ -1104,12 +1446,13 @@ namespace Master
 		}
 	}
 
+	// only the server browser's sort order reads this back, so it can go through the writer
 	void db_set_server_online(u32 id, b8 online)
 	{
-		sqlite3_stmt* stmt = db_query("update ServerConfig set online=? where id=?;");
-		db_bind_int(stmt, 0, online);
-		db_bind_int(stmt, 1, id);
-		db_exec(stmt);
+		DbWrite write = db_write("update ServerConfig set online=? where id=?;");
+		db_write_bind_int(&write, 0, online);
+		db_write_bind_int(&write, 1, id);
+		db_write_queue(write);
 	}
 
 	void disconnected(const Sock::Address& addr)
@@ -1197,7 +1540,18 @@ namespace Master
 					role = assign_role;
 
 				// update existing linkage
+				if (assign_role == Role::None)
+				{
+					// just a timestamp; nothing reads it back right away
+					DbWrite write = db_write("update UserServer set timestamp=? where user_id=? and server_id=?;");
+					db_write_bind_int(&write, 0, platform::timestamp());
+					db_write_bind_int(&write, 1, user_id);
+					db_write_bind_int(&write, 2, server_id);
+					db_write_queue(write);
+				}
+				else
 				{
+					// role changes have to land before the next user_role() query
 					sqlite3_stmt* stmt = db_query("update UserServer set timestamp=?, role=? where user_id=? and server_id=?;");
 					db_bind_int(stmt, 0, platform::timestamp());
 					db_bind_int(stmt, 1, s64(role));
@@ -1224,26 +1578,10 @@ namespace Master
 		if (assign_role == Role::None)
 		{
 			// the user is just playing on this server; update the server's play count and score
-			s64 plays;
-			{
-				sqlite3_stmt* stmt = db_query("select plays from ServerConfig where id=?;");
-				db_bind_int(stmt, 0, server_id);
-				{
-					b8 success = db_step(stmt);
-					vi_assert(success);
-				}
-				db_step(stmt);
-				plays = db_column_int(stmt, 0) + 1;
-				db_finalize(stmt);
-			}
-
-			{
-				sqlite3_stmt* stmt = db_query("update ServerConfig set plays=?, score=? where id=?;");
-				db_bind_int(stmt, 0, plays);
-				db_bind_int(stmt, 1, server_config_score(plays, platform::timestamp()));
-				db_bind_int(stmt, 2, server_id);
-				db_exec(stmt);
-			}
+			DbWrite write = db_write("update ServerConfig set plays=plays+1, score=server_config_score(plays+1, ?) where id=?;");
+			db_write_bind_int(&write, 0, platform::timestamp());
+			db_write_bind_int(&write, 1, server_id);
+			db_write_queue(write);
 		}
 
 		return role;
@@ -1883,6 +2221,7 @@ namespace Master
 				{
 					s64 token = db_column_int(stmt, 0);
 					s64 token_timestamp = db_column_int(stmt, 1);
+					db_finalize(stmt);
 					if (u32(token) == key.token && platform::timestamp() - token_timestamp < MASTER_TOKEN_TIMEOUT)
 					{
 						node->client.user_key = key;
@@ -1891,6 +2230,8 @@ namespace Master
 						return true;
 					}
 				}
+				else
+					db_finalize(stmt);
 			}
 		}
 
@@ -2135,6 +2476,7 @@ namespace Master
 									send_auth_response(node->addr, AuthType::Itch, &key, username);
 								}
 							}
+							db_finalize(stmt);
 						}
 #else
 						{
@@ -2387,7 +2729,10 @@ namespace Master
 					db_bind_int(stmt, 8, server_config_score(0, platform::timestamp()));
 					db_bind_text(stmt, 9, config.secret);
 					db_bind_int(stmt, 10, s64(config.preset));
-					config_id = u32(db_exec(stmt));
+					s64 id;
+					if (!db_exec(stmt, &id))
+						net_error();
+					config_id = u32(id);
 
 					// give friends access to new server
 					{
@@ -2416,11 +2761,15 @@ namespace Master
 						if (db_step(stmt))
 						{
 							b8 previously_private = b8(db_column_int(stmt, 0));
+							db_finalize(stmt);
 							if (!previously_private)
 								server_config_generate_secret(config.secret);
 						}
 						else // config doesn't exist
+						{
+							db_finalize(stmt);
 							net_error();
+						}
 					}
 
 					sqlite3_stmt* stmt = db_query("update ServerConfig set name=?, config=?, max_players=?, team_count=?, game_type=?, is_private=?, region=?, secret=?, preset=? where id=?;");
@@ -2436,7 +2785,8 @@ namespace Master
 					db_bind_text(stmt, 7, config.secret);
 					db_bind_int(stmt, 8, s64(config.preset));
 					db_bind_int(stmt, 9, config.id);
-					db_exec(stmt);
+					if (!db_exec(stmt))
+						net_error();
 					config_id = config.id;
 				}
 
@@ -2596,6 +2946,223 @@ namespace Master
 		return true;
 	}
 
+	// hashed timing wheel. each timer sits in the slot for the tick it's due on;
+	// timers more than one revolution out stay put until their tick comes around
+	struct TimerWheel
+	{
+		typedef void (*Callback)();
+
+		struct Timer
+		{
+			Callback callback;
+			s64 due; // tick
+			s64 interval; // ticks
+		};
+
+		static const s32 slot_count = 64;
+
+		Array<s32> slots[slot_count]; // indices into timers
+		Array<Timer> timers;
+		r64 start;
+		r64 resolution; // seconds per tick
+		s64 tick; // last tick we processed
+
+		void init(r64 time, r64 r)
+		{
+			start = time;
+			resolution = r;
+			tick = 0;
+		}
+
+		// first fires on the next tick
+		void add(Callback callback, r64 interval)
+		{
+			Timer* timer = timers.add();
+			timer->callback = callback;
+			timer->interval = vi_max(s64(1), s64(interval / resolution + 0.5));
+			timer->due = tick + 1;
+			slots[timer->due % slot_count].add(timers.length - 1);
+		}
+
+		// every timer that came due since the last call fires once, even if we stalled through several of its intervals.
+		// it's rescheduled relative to now rather than catching up on the ticks it missed
+		void advance(r64 time)
+		{
+			s64 now = s64((time - start) / resolution);
+			if (now <= tick)
+				return;
+
+			StaticArray<s32, 16> fired;
+			s64 end = vi_min(now, tick + slot_count); // after a full revolution we've seen every slot
+			for (s64 t = tick + 1; t <= end; t++)
+			{
+				Array<s32>* slot = &slots[t % slot_count];
+				for (s32 i = 0; i < slot->length; i++)
+				{
+					if (timers[(*slot)[i]].due <= now)
+					{
+						fired.add((*slot)[i]);
+						slot->remove(i);
+						i--;
+					}
+				}
+			}
+			tick = now;
+
+			for (s32 i = 0; i < fired.length; i++)
+			{
+				Timer* timer = &timers[fired[i]];
+				timer->callback();
+				timer->due = now + timer->interval;
+				slots[timer->due % slot_count].add(fired[i]);
+			}
+		}
+
+		// seconds until the next timer is due
+		r64 next(r64 time) const
+		{
+			s64 due = tick + slot_count;
+			for (s32 i = 0; i < timers.length; i++)
+				due = vi_min(due, timers[i].due);
+			return vi_max(0.0, start + r64(due) * resolution - time);
+		}
+	};
+
+	// external services and message resends
+	void services_update()
+	{
+		DiscordBot::update();
+
+		Http::update();
+
+		CrashReport::update();
+
+		global.messenger.update(global_timestamp, &global.sock);
+	}
+
+	// remove timed out client connection attempts
+	void connections_expire()
+	{
+		r64 threshold = global_timestamp - MASTER_CLIENT_CONNECTION_TIMEOUT;
+		for (s32 i = 0; i < global.clients_connecting.length; i++)
+		{
+			const ClientConnection& c = global.clients_connecting[i];
+			if (c.timestamp < threshold)
+			{
+				Node* client = node_for_address(c.client);
+				if (client && client->state == Node::State::ClientConnecting)
+				{
+					client->transition(Node::State::ClientWaiting); // give up connecting, go back to matchmaking
+					global.clients_waiting.add(client->addr.hash());
+				}
+
+				Node* server = node_for_address(c.server);
+				if (server)
+				{
+					// since there are clients connecting to this server, we've been ignoring its updates telling us how many open slots it has
+					// we need to manually update the open slot count until the server gives us a fresh count
+					// don't try to fill these slots until the server tells us for sure they're available
+					server->server_state.player_slots -= c.slots;
+				}
+
+				global.clients_connecting.remove(i);
+				i--;
+			}
+		}
+	}
+
+	// remove inactive nodes
+	void audit()
+	{
+		r64 threshold = global_timestamp - MASTER_INACTIVE_THRESHOLD;
+		Array<Sock::Address> removals;
+		for (auto i = global.nodes.begin(); i != global.nodes.end(); i++)
+		{
+			if (i->second.last_message_timestamp < threshold)
+				removals.add(i->second.addr);
+		}
+		for (s32 i = 0; i < removals.length; i++)
+			disconnected(removals[i]);
+	}
+
+	void matchmake()
+	{
+		for (s32 i = 0; i < global.clients_waiting.length; i++)
+		{
+			Node* client = node_for_hash(global.clients_waiting[i]);
+			Node* server = client_requested_server(client);
+			if (server)
+			{
+				// server is already running
+				if (server_open_slots(server) >= client->server_state.player_slots)
+				{
+					client_connect_to_existing_server(client, server);
+					i--; // client has been removed from clients_waiting
+				}
+				else
+				{
+					// not enough room for client; let the client know
+					s8 wait_position = client_wait_position(client);
+					send_client_connection_step(client, ClientConnectionStep::WaitingForSlot, wait_position);
+				}
+			}
+			else
+			{
+				// allocate an idle server for this client
+				Node* idle_server = nullptr;
+				for (s32 i = 0; i < global.servers.length; i++)
+				{
+					Node* server = node_for_hash(global.servers[i]);
+					if (server->state == Node::State::ServerIdle && server->server_state.region == client->server_state.region)
+					{
+						idle_server = server;
+						break;
+					}
+				}
+
+				if (idle_server)
+				{
+					send_server_load(idle_server, client);
+					send_server_expect_client(idle_server, &client->client.user_key);
+					client_queue_join(idle_server, client);
+					i--; // client has been removed from clients_waiting
+				}
+			}
+		}
+	}
+
+	Sock::ReceiveBatch incoming;
+	Sock::SendBatch outgoing; // everything we send goes out together at the end of each loop iteration
+
+	// handle everything waiting on the socket, a batch at a time
+	// stops after a few batches so timers still get a chance to run under heavy load
+	void receive()
+	{
+		for (s32 batch = 0; batch < MASTER_RECEIVE_BATCHES; batch++)
+		{
+			if (Sock::udp_receive_batch(&global.sock, &incoming) == 0)
+				break;
+
+			for (s32 i = 0; i < incoming.count; i++)
+			{
+				s32 bytes_read = incoming.sizes[i];
+				if (bytes_read <= 0)
+					continue;
+
+				StreamRead packet;
+				memcpy(packet.data.data, incoming.data[i], bytes_read);
+				packet.resize_bytes(bytes_read);
+				if (!packet.read_checksum())
+					vi_debug("%s", "Discarding packet due to invalid checksum.");
+				else if (packet_decompress(&packet, bytes_read))
+				{
+					packet_handle(&packet, incoming.senders[i]);
+					db_statements_release();
+				}
+			}
+		}
+	}
+
 	s32 proc()
 	{
 		mersenne::srand(u32(platform::timestamp()));
@@ -2609,6 +3176,7 @@ namespace Master
 			fprintf(stderr, "%s\n", Sock::get_error());
 			return 1;
 		}
+		global.sock.batch = &outgoing;
 
 		Http::init();
 
@@ -2622,6 +3190,11 @@ namespace Master
 				return 1;
 			}
 
+			db_exec("pragma journal_mode=wal;");
+			db_exec("pragma synchronous=normal;");
+			sqlite3_wal_autocheckpoint(global.db, 0); // the writer thread does this
+			sqlite3_busy_timeout(global.db, MASTER_DB_BUSY_TIMEOUT);
+
 			if (init_db)
 			{
 				db_exec("create table User (id integer primary key autoincrement, token integer not null, token_timestamp integer not null, itch_id integer, steam_id integer, gamejolt_id integer, username varchar(256) not null, banned boolean not null, vip boolean not null, unique(itch_id), unique(steam_id));");
@@ -2633,6 +3206,9 @@ namespace Master
 				db_exec("create table Email (email text, key text);");
 			}
 			db_exec("update ServerConfig set online=0;");
+
+			if (!db_writer_init("lasercrabs.db"))
+				return 1;
 		}
 
 		// load settings
@@ -2756,148 +3332,163 @@ namespace Master
 
 		DiscordBot::init();
 
-		r64 last_audit = 0.0;
-		r64 last_match = 0.0;
-		r64 last_key_distribution = 0.0;
+		TimerWheel timers;
+		timers.init(platform::time(), MASTER_TIMER_RESOLUTION);
+		timers.add(&Signup::distribute_keys, MASTER_KEY_DISTRIBUTION_INTERVAL);
+		timers.add(&services_update, MASTER_TIMER_RESOLUTION);
+		timers.add(&connections_expire, MASTER_MATCH_INTERVAL);
+		timers.add(&audit, MASTER_AUDIT_INTERVAL);
+		timers.add(&matchmake, MASTER_MATCH_INTERVAL);
+
+#if __linux__
+		// wake up as soon as a packet arrives, or when the next timer is due
+		s32 epoll = epoll_create1(0);
+		{
+			u64 handles[] = { global.sock.ipv4, global.sock.ipv6 };
+			for (s32 i = 0; i < 2; i++)
+			{
+				if (handles[i])
+				{
+					struct epoll_event event = {};
+					event.events = EPOLLIN;
+					event.data.fd = s32(handles[i]);
+					if (epoll_ctl(epoll, EPOLL_CTL_ADD, s32(handles[i]), &event))
+					{
+						fprintf(stderr, "%s\n", "Failed to register socket with epoll.");
+						return 1;
+					}
+				}
+			}
+		}
+#endif
 
 		while (true)
 		{
 			global_timestamp = platform::time();
 			real_timestamp = platform::timestamp();
 
-			if (global_timestamp - last_key_distribution > MASTER_KEY_DISTRIBUTION_INTERVAL)
-			{
-				last_key_distribution = global_timestamp;
-				Signup::distribute_keys();
-			}
+			timers.advance(global_timestamp);
+			db_statements_release();
 
-			DiscordBot::update();
+			receive();
 
-			Http::update();
+			Sock::udp_flush(&global.sock);
 
-			CrashReport::update();
+			r64 wait = timers.next(platform::time());
+#if __linux__
+			struct epoll_event events[2];
+			epoll_wait(epoll, events, 2, s32(ceil(wait * 1000.0)));
+#else
+			platform::vi_sleep(r32(vi_min(wait, 1.0 / 60.0)));
+#endif
+		}
 
-			global.messenger.update(global_timestamp, &global.sock);
+		db_writer_term();
+		db_statements_clear(&global.statements);
+		sqlite3_close(global.db);
 
-			// remove timed out client connection attempts
-			{
-				r64 threshold = global_timestamp - MASTER_CLIENT_CONNECTION_TIMEOUT;
-				for (s32 i = 0; i < global.clients_connecting.length; i++)
-				{
-					const ClientConnection& c = global.clients_connecting[i];
-					if (c.timestamp < threshold)
-					{
-						Node* client = node_for_address(c.client);
-						if (client && client->state == Node::State::ClientConnecting)
-						{
-							client->transition(Node::State::ClientWaiting); // give up connecting, go back to matchmaking
-							global.clients_waiting.add(client->addr.hash());
-						}
+		Http::term();
 
-						Node* server = node_for_address(c.server);
-						if (server)
-						{
-							// since there are clients connecting to this server, we've been ignoring its updates telling us how many open slots it has
-							// we need to manually update the open slot count until the server gives us a fresh count
-							// don't try to fill these slots until the server tells us for sure they're available
-							server->server_state.player_slots -= c.slots;
-						}
+		CrashReport::term();
 
-						global.clients_connecting.remove(i);
-						i--;
-					}
-				}
-			}
+		return 0;
+	}
+
+#if !RELEASE_BUILD
+	// hammers a running master server with synthetic Auth and ClientRequestServer messages
+	// from a bunch of fake clients, and reports how many packets per second go each way
+	s32 loadgen(const char* host, s32 client_count, r64 duration)
+	{
+		Sock::init();
+
+		Sock::Address master_addr;
+		if (Sock::Address::get(&master_addr, host, NET_MASTER_PORT))
+		{
+			fprintf(stderr, "Can't resolve master server address '%s'\n", host);
+			return 1;
+		}
 
-			// remove inactive nodes
-			if (global_timestamp - last_audit > MASTER_AUDIT_INTERVAL)
+		client_count = vi_max(1, vi_min(client_count, 1024));
+		Array<Sock::Handle> clients;
+		Array<SequenceID> sequences;
+		for (s32 i = 0; i < client_count; i++)
+		{
+			Sock::Handle* sock = clients.add();
+			if (Sock::udp_open(sock, 0))
 			{
-				r64 threshold = global_timestamp - MASTER_INACTIVE_THRESHOLD;
-				Array<Sock::Address> removals;
-				for (auto i = global.nodes.begin(); i != global.nodes.end(); i++)
-				{
-					if (i->second.last_message_timestamp < threshold)
-						removals.add(i->second.addr);
-				}
-				for (s32 i = 0; i < removals.length; i++)
-					disconnected(removals[i]);
-				last_audit = global_timestamp;
+				fprintf(stderr, "%s\n", Sock::get_error());
+				return 1;
 			}
+			sequences.add(0);
+		}
 
-			if (global_timestamp - last_match > MASTER_MATCH_INTERVAL)
-			{
-				last_match = global_timestamp;
+		s64 sent = 0;
+		s64 received = 0;
+		r64 start_time = platform::time();
+		r64 report_time = start_time;
+		s64 report_sent = 0;
+		s64 report_received = 0;
+		while (true)
+		{
+			r64 time = platform::time();
+			if (time - start_time > duration)
+				break;
 
-				for (s32 i = 0; i < global.clients_waiting.length; i++)
+			for (s32 i = 0; i < clients.length; i++)
+			{
+				using Stream = StreamWrite;
+				StreamWrite p;
+				packet_init(&p);
 				{
-					Node* client = node_for_hash(global.clients_waiting[i]);
-					Node* server = client_requested_server(client);
-					if (server)
-					{
-						// server is already running
-						if (server_open_slots(server) >= client->server_state.player_slots)
-						{
-							client_connect_to_existing_server(client, server);
-							i--; // client has been removed from clients_waiting
-						}
-						else
-						{
-							// not enough room for client; let the client know
-							s8 wait_position = client_wait_position(client);
-							send_client_connection_step(client, ClientConnectionStep::WaitingForSlot, wait_position);
-						}
-					}
-					else
-					{
-						// allocate an idle server for this client
-						Node* idle_server = nullptr;
-						for (s32 i = 0; i < global.servers.length; i++)
-						{
-							Node* server = node_for_hash(global.servers[i]);
-							if (server->state == Node::State::ServerIdle && server->server_state.region == client->server_state.region)
-							{
-								idle_server = server;
-								break;
-							}
-						}
-
-						if (idle_server)
-						{
-							send_server_load(idle_server, client);
-							send_server_expect_client(idle_server, &client->client.user_key);
-							client_queue_join(idle_server, client);
-							i--; // client has been removed from clients_waiting
-						}
-					}
+					s16 version = GAME_VERSION;
+					serialize_s16(&p, version);
 				}
-			}
-
-			Sock::Address addr;
-			StreamRead packet;
-			s32 bytes_read = Sock::udp_receive(&global.sock, &addr, packet.data.data, NET_MAX_PACKET_SIZE);
-			packet.resize_bytes(bytes_read);
-			if (bytes_read > 0)
-			{
-				if (packet.read_checksum())
+				serialize_int(&p, SequenceID, sequences[i], 0, NET_SEQUENCE_COUNT - 1);
+				sequences[i] = sequence_advance(sequences[i], 1);
+				Message type = (sent / clients.length) % 2 == 0 ? Message::Auth : Message::ClientRequestServer;
+				serialize_enum(&p, Message, type);
+				if (type == Message::Auth)
 				{
-					packet_decompress(&packet, bytes_read);
-					packet_handle(&packet, addr);
+					AuthType auth_type = AuthType::None;
+					serialize_enum(&p, AuthType, auth_type);
+					s32 auth_key_length = 0;
+					serialize_int(&p, s32, auth_key_length, 0, MAX_AUTH_KEY);
 				}
 				else
-					vi_debug("%s", "Discarding packet due to invalid checksum.");
+				{
+					// not authenticated, so the master will tell us to start over
+					UserKey key = {};
+					serialize_u32(&p, key.id);
+					serialize_u32(&p, key.token);
+				}
+				packet_finalize(&p);
+				if (Sock::udp_send(&clients[i], master_addr, p.data.data, p.bytes_written()) == 0)
+					sent++;
+
+				while (Sock::udp_receive_batch(&clients[i], &incoming) > 0)
+					received += incoming.count;
+			}
+
+			if (time - report_time > 1.0)
+			{
+				r64 elapsed = time - report_time;
+				printf("%.0f packets/s sent, %.0f packets/s received\n", r64(sent - report_sent) / elapsed, r64(received - report_received) / elapsed);
+				report_time = time;
+				report_sent = sent;
+				report_received = received;
 			}
-			else
-				platform::vi_sleep(1.0f / 60.0f);
 		}
 
-		sqlite3_close(global.db);
+		r64 elapsed = platform::time() - start_time;
+		printf("%d clients, %.1fs: %lld sent (%.0f/s), %lld received (%.0f/s)\n", client_count, elapsed, (long long)sent, r64(sent) / elapsed, (long long)received, r64(received) / elapsed);
 
-		Http::term();
-
-		CrashReport::term();
+		for (s32 i = 0; i < clients.length; i++)
+			Sock::close(&clients[i]);
+		Sock::netshutdown();
 
 		return 0;
 	}
+#endif
 
 namespace DiscordBot
 {
@@ -3096,18 +3687,18 @@ namespace DiscordBot
 			if (strcmp(cmd, "!play") == 0 || strcmp(cmd, "!p") == 0)
 			{
 				ensure_user_exists(author_id);
-				sqlite3_stmt* stmt = db_query("update DiscordUser set playtime=? where id=?;");
-				db_bind_int(stmt, 0, s64(real_timestamp));
-				db_bind_text(stmt, 1, author_id);
-				db_exec(stmt);
+				DbWrite write = db_write("update DiscordUser set playtime=? where id=?;");
+				db_write_bind_int(&write, 0, s64(real_timestamp));
+				db_write_bind_text(&write, 1, author_id);
+				db_write_queue(write);
 				cmd_acknowledge(msg);
 			}
 			else if (strcmp(cmd, "!leave") == 0 || strcmp(cmd, "!l") == 0)
 			{
 				ensure_user_exists(author_id);
-				sqlite3_stmt* stmt = db_query("update DiscordUser set playtime=null where id=?;");
-				db_bind_text(stmt, 0, author_id);
-				db_exec(stmt);
+				DbWrite write = db_write("update DiscordUser set playtime=null where id=?;");
+				db_write_bind_text(&write, 0, author_id);
+				db_write_queue(write);
 				cmd_acknowledge(msg);
 			}
 			else if (strcmp(cmd, "!stats") == 0 || strcmp(cmd, "!s") == 0)
@@ -3706,5 +4297,10 @@ void handle_api(mg_connection* conn, s32 ev, void* ev_data)
 
 int main(int argc, char** argv)
 {
+#if !RELEASE_BUILD
+	// lasercrabmaster loadgen [host] [clients] [seconds]
+	if (argc > 1 && strcmp(argv[1], "loadgen") == 0)
+		return VI::Net::Master::loadgen(argc > 2 ? argv[2] : "127.0.0.1", argc > 3 ? atoi(argv[3]) : 64, argc > 4 ? atof(argv[4]) : 10.0);
+#endif
 	return VI::Net::Master::proc();
 }
@@ -822,6 +822,8 @@ namespace VI
 
 		refresh_controllers();
 
+		vi_profile_thread("render");
+
 		while (true)
 		{
 			{
@@ -1106,10 +1108,10 @@ namespace VI
 				break;
 		}
 
-		AI::quit();
-
 		thread_update.join();
 		thread_physics.join();
+
+		AI::quit(); // the update thread must be done sending AI requests first
 		thread_ai.join();
 
 		SDL_GL_DeleteContext(context);
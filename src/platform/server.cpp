@@ -7,12 +7,16 @@
 #include "physics.h"
 #include "loop.h"
 #include "settings.h"
+#include "game/benchmark.h"
 #if _WIN32
 #include <Windows.h>
 #endif
 #include <time.h>
 #include <chrono>
 #include <signal.h>
+#if !_WIN32
+#include <errno.h>
+#endif
 
 namespace VI
 {
@@ -27,9 +31,10 @@ namespace VI
 			return (u64)t;
 		}
 
+		// monotonic, so the tick scheduler can use it for absolute deadlines
 		r64 time()
 		{
-			return r64(std::chrono::high_resolution_clock::now().time_since_epoch().count()) / 1000000000.0;
+			return r64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) / 1000000000.0;
 		}
 
 		void sleep(r32 time)
@@ -37,6 +42,21 @@ namespace VI
 			std::this_thread::sleep_for(std::chrono::milliseconds((s64)(time * 1000.0f)));
 		}
 
+		void sleep_until(r64 t)
+		{
+#if _WIN32
+			std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<r64>(t))));
+#else
+			// steady_clock is CLOCK_MONOTONIC
+			timespec deadline;
+			deadline.tv_sec = time_t(t);
+			deadline.tv_nsec = long((t - r64(deadline.tv_sec)) * 1000000000.0);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR)
+			{
+			}
+#endif
+		}
+
 		void display_mode(s32 width, s32 height, b8 fullscreen, b8 vsync)
 		{
 		}
@@ -103,10 +123,10 @@ namespace VI
 				break;
 		}
 
-		AI::quit();
-
 		update_thread.join();
 		physics_thread.join();
+
+		AI::quit(); // sync_in only has one producer, so wait until the update thread is done with it
 		ai_thread.join();
 
 		return 0;
@@ -116,12 +136,31 @@ namespace VI
 
 int main(int argc, char** argv)
 {
-	int port;
+	int port = 21365;
 
-	if (argc >= 2)
+	if (argc >= 2 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		// lasercrabsrv --benchmark <level> [bots] [ticks] [seed] [output.json]
+		if (argc < 3)
+		{
+			fprintf(stderr, "%s\n", "Usage: --benchmark <level> [bots] [ticks] [seed] [output.json]");
+			return -1;
+		}
+		VI::Benchmark::Config* config = &VI::Benchmark::config;
+		config->level = argv[2];
+		config->bots = argc >= 4 ? atoi(argv[3]) : 8;
+		config->ticks = argc >= 5 ? atoi(argv[4]) : 3600;
+		config->seed = argc >= 6 ? u32(strtoul(argv[5], nullptr, 10)) : 1;
+		config->output = argc >= 7 ? argv[6] : nullptr;
+		if (config->bots < 0 || config->bots > MAX_PLAYERS || config->ticks <= 0)
+		{
+			fprintf(stderr, "%s\n", "Invalid benchmark parameters.");
+			return -1;
+		}
+		VI::Benchmark::active = true;
+	}
+	else if (argc >= 2)
 		port = atoi(argv[1]);
-	else
-		port = 21365;
 
 	if (port <= 0 || port > 65535)
 	{
@@ -14,6 +14,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <fcntl.h>
+#include <errno.h>
 #endif
 #include <functional>
 
@@ -24,6 +25,7 @@ namespace VI
 namespace Sock
 {
 
+#define SOCK_FLUSH_RETRIES 4 // transient sendmmsg failures to retry before dropping a message
 
 static const char* g_error;
 
@@ -307,39 +309,60 @@ void close(Handle* socket)
 	}
 }
 
-s32 udp_send(Handle* socket, const Address& destination, const void* data, s32 size)
+// returns the socket handle to send from, or 0 if we don't have one open for the desired protocol
+static u64 address_to_sockaddr(const Handle* socket, const Address& destination, struct sockaddr_storage* address, size_t* addr_length)
 {
-	struct sockaddr_storage address;
-	memset(&address, 0, sizeof(address));
+	memset(address, 0, sizeof(*address));
 	u64 handle = 0;
-	size_t addr_length = 0;
+	*addr_length = 0;
 	switch (destination.host.type)
 	{
 		case Host::Type::IPv4:
 		{
-			struct sockaddr_in* ipv4 = (struct sockaddr_in*)(&address);
+			struct sockaddr_in* ipv4 = (struct sockaddr_in*)(address);
 			ipv4->sin_family = AF_INET;
 			ipv4->sin_port = destination.port;
 			ipv4->sin_addr.s_addr = destination.host.ipv4;
 			handle = socket->ipv4;
-			addr_length = sizeof(struct sockaddr_in);
+			*addr_length = sizeof(struct sockaddr_in);
 			break;
 		}
 		case Host::Type::IPv6:
 		{
-			struct sockaddr_in6* ipv6 = (struct sockaddr_in6*)(&address);
+			struct sockaddr_in6* ipv6 = (struct sockaddr_in6*)(address);
 			ipv6->sin6_family = AF_INET6;
 			ipv6->sin6_port = destination.port;
 			ipv6->sin6_scope_id = destination.host.scope_id;
 			memcpy(&ipv6->sin6_addr, &destination.host.ipv6, sizeof(ipv6->sin6_addr));
 			handle = socket->ipv6;
-			addr_length = sizeof(struct sockaddr_in6);
+			*addr_length = sizeof(struct sockaddr_in6);
 			break;
 		}
 		default:
 			vi_assert(false);
 			break;
 	}
+	return handle;
+}
+
+s32 udp_send(Handle* socket, const Address& destination, const void* data, s32 size)
+{
+	if (socket->batch)
+	{
+		SendBatch* batch = socket->batch;
+		if (batch->count == SOCK_BATCH_SIZE && udp_flush(socket))
+			return -1;
+		vi_assert(size <= NET_MAX_PACKET_SIZE);
+		batch->destinations[batch->count] = destination;
+		batch->sizes[batch->count] = size;
+		memcpy(batch->data[batch->count], data, size);
+		batch->count++;
+		return 0;
+	}
+
+	struct sockaddr_storage address;
+	size_t addr_length;
+	u64 handle = address_to_sockaddr(socket, destination, &address, &addr_length);
 
 	if (handle) // do we actually have a socket open for the desired protocol?
 	{
@@ -351,6 +374,101 @@ s32 udp_send(Handle* socket, const Address& destination, const void* data, s32 s
 	return 0;
 }
 
+s32 udp_flush(Handle* socket)
+{
+	SendBatch* batch = socket->batch;
+	if (!batch || batch->count == 0)
+		return 0;
+
+	s32 result = 0;
+#if defined(__linux__)
+	// one sendmmsg per protocol
+	struct mmsghdr messages[2][SOCK_BATCH_SIZE];
+	struct iovec buffers[SOCK_BATCH_SIZE];
+	struct sockaddr_storage addresses[SOCK_BATCH_SIZE];
+	s32 counts[2] = {};
+	u64 handles[2] = { socket->ipv4, socket->ipv6 };
+	for (s32 i = 0; i < batch->count; i++)
+	{
+		size_t addr_length;
+		u64 handle = address_to_sockaddr(socket, batch->destinations[i], &addresses[i], &addr_length);
+		if (!handle)
+			continue;
+		s32 family = handle == socket->ipv4 ? 0 : 1;
+		buffers[i].iov_base = batch->data[i];
+		buffers[i].iov_len = size_t(batch->sizes[i]);
+		struct mmsghdr* message = &messages[family][counts[family]];
+		memset(message, 0, sizeof(*message));
+		message->msg_hdr.msg_name = &addresses[i];
+		message->msg_hdr.msg_namelen = socklen_t(addr_length);
+		message->msg_hdr.msg_iov = &buffers[i];
+		message->msg_hdr.msg_iovlen = 1;
+		counts[family]++;
+	}
+
+	// sendmmsg stops at the first message that fails.
+	// retry transient errors a few times, otherwise drop just that message and keep going
+	for (s32 family = 0; family < 2; family++)
+	{
+		s32 sent = 0;
+		s32 retries = 0;
+		while (sent < counts[family])
+		{
+			s32 count = sendmmsg(s32(handles[family]), &messages[family][sent], u32(counts[family] - sent), 0);
+			if (count > 0)
+			{
+				sent += count;
+				retries = 0;
+			}
+			else if ((errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) && retries < SOCK_FLUSH_RETRIES)
+				retries++;
+			else
+			{
+				result = error("Failed to send data");
+				sent++;
+				retries = 0;
+			}
+		}
+	}
+#else
+	for (s32 i = 0; i < batch->count; i++)
+	{
+		struct sockaddr_storage address;
+		size_t addr_length;
+		u64 handle = address_to_sockaddr(socket, batch->destinations[i], &address, &addr_length);
+		if (handle)
+		{
+			s32 sent_bytes = sendto(handle, (const char*)(batch->data[i]), batch->sizes[i], 0, (const struct sockaddr*)&address, s32(addr_length));
+			if (sent_bytes != batch->sizes[i])
+				result = error("Failed to send data");
+		}
+	}
+#endif
+
+	batch->count = 0;
+	return result;
+}
+
+static void address_from_sockaddr(Address* sender, const struct sockaddr_storage& from)
+{
+	if (from.ss_family == AF_INET6)
+	{
+		sender->host.type = Host::Type::IPv6;
+		const struct sockaddr_in6* ipv6 = (const struct sockaddr_in6*)(&from);
+		memcpy(sender->host.ipv6, &ipv6->sin6_addr, sizeof(ipv6->sin6_addr));
+		sender->host.scope_id = ipv6->sin6_scope_id;
+		sender->port = ipv6->sin6_port;
+	}
+	else
+	{
+		sender->host.type = Host::Type::IPv4;
+		const struct sockaddr_in* ipv4 = (const struct sockaddr_in*)(&from);
+		sender->host.ipv4 = ipv4->sin_addr.s_addr;
+		sender->host.scope_id = 0;
+		sender->port = ipv4->sin_port;
+	}
+}
+
 s32 udp_receive(Handle* socket, Address* sender, void* data, s32 size)
 {
 #ifdef _WIN32
@@ -376,24 +494,67 @@ s32 udp_receive(Handle* socket, Address* sender, void* data, s32 size)
 			return 0;
 	}
 
-	if (from.ss_family == AF_INET6)
+	address_from_sockaddr(sender, from);
+
+	return received_bytes;
+}
+
+// fill the rest of the batch from one socket
+static void receive_batch(u64 handle, ReceiveBatch* batch)
+{
+	s32 space = SOCK_BATCH_SIZE - batch->count;
+	if (!handle || space == 0)
+		return;
+
+#if defined(__linux__)
+	struct mmsghdr messages[SOCK_BATCH_SIZE];
+	struct iovec buffers[SOCK_BATCH_SIZE];
+	struct sockaddr_storage from[SOCK_BATCH_SIZE];
+	memset(messages, 0, sizeof(struct mmsghdr) * space);
+	for (s32 i = 0; i < space; i++)
 	{
-		sender->host.type = Host::Type::IPv6;
-		const struct sockaddr_in6* ipv6 = (const struct sockaddr_in6*)(&from);
-		memcpy(sender->host.ipv6, &ipv6->sin6_addr, sizeof(ipv6->sin6_addr));
-		sender->host.scope_id = ipv6->sin6_scope_id;
-		sender->port = ipv6->sin6_port;
+		buffers[i].iov_base = batch->data[batch->count + i];
+		buffers[i].iov_len = NET_MAX_PACKET_SIZE;
+		messages[i].msg_hdr.msg_name = &from[i];
+		messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+		messages[i].msg_hdr.msg_iov = &buffers[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
 	}
-	else
+
+	s32 received = recvmmsg(s32(handle), messages, u32(space), MSG_DONTWAIT, nullptr);
+	for (s32 i = 0; i < received; i++)
 	{
-		sender->host.type = Host::Type::IPv4;
-		const struct sockaddr_in* ipv4 = (const struct sockaddr_in*)(&from);
-		sender->host.ipv4 = ipv4->sin_addr.s_addr;
-		sender->host.scope_id = 0;
-		sender->port = ipv4->sin_port;
+		s32 index = batch->count + i;
+		batch->sizes[index] = s32(messages[i].msg_len);
+		address_from_sockaddr(&batch->senders[index], from[i]);
 	}
+	if (received > 0)
+		batch->count += received;
+#else
+	// no recvmmsg; one recvfrom per datagram
+#ifdef _WIN32
+	typedef s32 socklen_t;
+#endif
+	while (batch->count < SOCK_BATCH_SIZE)
+	{
+		struct sockaddr_storage from;
+		socklen_t from_length = sizeof(struct sockaddr_storage);
+		s32 received_bytes = recvfrom(handle, (char*)(batch->data[batch->count]), NET_MAX_PACKET_SIZE, 0, (sockaddr*)&from, &from_length);
+		if (received_bytes <= 0)
+			break;
+		batch->sizes[batch->count] = received_bytes;
+		address_from_sockaddr(&batch->senders[batch->count], from);
+		batch->count++;
+	}
+#endif
+}
 
-	return received_bytes;
+s32 udp_receive_batch(Handle* socket, ReceiveBatch* batch)
+{
+	batch->count = 0;
+	receive_batch(socket->ipv4, batch);
+	receive_batch(socket->ipv6, batch);
+	return batch->count;
 }
 
 }
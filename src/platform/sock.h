@@ -78,10 +78,31 @@ struct Address
 	u64 hash() const;
 };
 
+#define SOCK_BATCH_SIZE 32
+
+// datagrams queued up to go out together
+struct SendBatch
+{
+	Address destinations[SOCK_BATCH_SIZE];
+	s32 sizes[SOCK_BATCH_SIZE];
+	s32 count;
+	u8 data[SOCK_BATCH_SIZE][NET_MAX_PACKET_SIZE];
+};
+
 struct Handle
 {
 	u64 ipv4;
 	u64 ipv6;
+	SendBatch* batch; // if set, udp_send() queues datagrams here until udp_flush(), or until the batch fills up
+};
+
+// datagrams pulled off a socket in one go
+struct ReceiveBatch
+{
+	Address senders[SOCK_BATCH_SIZE];
+	s32 sizes[SOCK_BATCH_SIZE];
+	s32 count;
+	u8 data[SOCK_BATCH_SIZE][NET_MAX_PACKET_SIZE];
 };
 
 const char* get_error(void);
@@ -92,7 +113,9 @@ void close(Handle*);
 
 s32 udp_open(Handle*, u32 = 0);
 s32 udp_send(Handle*, const Address&, const void*, s32);
+s32 udp_flush(Handle*);
 s32 udp_receive(Handle*, Address*, void*, s32);
+s32 udp_receive_batch(Handle*, ReceiveBatch*); // returns the number of datagrams received, up to SOCK_BATCH_SIZE
 
 
 }
@@ -10,6 +10,9 @@ namespace platform
 u64 timestamp();
 r64 time();
 void sleep(r32);
+#if SERVER
+void sleep_until(r64); // absolute, in terms of time()
+#endif
 
 }
 
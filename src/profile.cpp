@@ -0,0 +1,273 @@
+#include "profile.h"
+
+#if VI_PROFILE
+
+#include "vi_assert.h"
+#include "data/array.h"
+#include "lmath.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace VI
+{
+
+namespace Profile
+{
+
+#define PROFILE_THREADS_MAX 32
+#define PROFILE_EVENTS 32768 // per thread; older events get overwritten
+#define PROFILE_DEPTH_MAX 32
+#define PROFILE_ZONES_MAX 256
+
+struct Event
+{
+	r64 start; // seconds
+	r32 duration; // seconds
+	const char* name;
+};
+
+// one ring entry. sequence is the event's position in the ring plus one, or zero while it's being written.
+// the fields are relaxed atomics so readers on other threads never race the writer;
+// a reader keeps a copy only if sequence matched before and after
+struct Slot
+{
+	std::atomic<u32> sequence;
+	std::atomic<r64> start;
+	std::atomic<r32> duration;
+	std::atomic<const char*> name;
+};
+
+// only the owning thread writes. anyone can read the slots behind write_pos
+struct ThreadBuffer
+{
+	Slot events[PROFILE_EVENTS];
+	std::atomic<u32> write_pos; // total events ever written
+	r64 stack_start[PROFILE_DEPTH_MAX];
+	const char* stack_name[PROFILE_DEPTH_MAX];
+	s32 depth;
+	s32 id;
+	char name[32];
+};
+
+// platform::time() is SDL_GetTicks() on the client, which only has millisecond resolution.
+// zones need something much finer, so the profiler keeps its own clock
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+// seconds since startup
+inline r64 now()
+{
+	return std::chrono::duration<r64>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+std::atomic<ThreadBuffer*> threads[PROFILE_THREADS_MAX];
+std::atomic<s32> thread_count;
+
+thread_local ThreadBuffer* thread_buffer;
+thread_local b8 thread_full; // we ran out of thread slots; don't bother
+
+ThreadBuffer* buffer_get()
+{
+	if (!thread_buffer && !thread_full)
+	{
+		s32 id = thread_count.fetch_add(1);
+		if (id >= PROFILE_THREADS_MAX)
+		{
+			thread_full = true;
+			return nullptr;
+		}
+		ThreadBuffer* buffer = new ThreadBuffer(); // never freed; other threads might still be reading it
+		buffer->id = id;
+		snprintf(buffer->name, sizeof(buffer->name), "thread %d", id);
+		threads[id].store(buffer, std::memory_order_release);
+		thread_buffer = buffer;
+	}
+	return thread_buffer;
+}
+
+void thread_name(const char* name)
+{
+	ThreadBuffer* buffer = buffer_get();
+	if (buffer)
+		strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+}
+
+void begin(const char* name)
+{
+	ThreadBuffer* buffer = buffer_get();
+	if (!buffer)
+		return;
+	if (buffer->depth < PROFILE_DEPTH_MAX)
+	{
+		buffer->stack_name[buffer->depth] = name;
+		buffer->stack_start[buffer->depth] = now();
+	}
+	buffer->depth++;
+}
+
+void end()
+{
+	ThreadBuffer* buffer = thread_buffer;
+	if (!buffer)
+		return;
+	vi_assert(buffer->depth > 0);
+	buffer->depth--;
+	if (buffer->depth < PROFILE_DEPTH_MAX)
+	{
+		u32 pos = buffer->write_pos.load(std::memory_order_relaxed);
+		Slot* slot = &buffer->events[pos % PROFILE_EVENTS];
+		r64 start = buffer->stack_start[buffer->depth];
+		slot->sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot->start.store(start, std::memory_order_relaxed);
+		slot->duration.store(r32(now() - start), std::memory_order_relaxed);
+		slot->name.store(buffer->stack_name[buffer->depth], std::memory_order_relaxed);
+		slot->sequence.store(pos + 1, std::memory_order_release);
+		buffer->write_pos.store(pos + 1, std::memory_order_release);
+	}
+}
+
+// copy out the events in the thread's ring that are still intact.
+// anything the writer lapped or is halfway through gets skipped
+void snapshot(const ThreadBuffer* buffer, Array<Event>* out)
+{
+	out->length = 0;
+	u32 end = buffer->write_pos.load(std::memory_order_acquire);
+	u32 start = end > PROFILE_EVENTS ? end - PROFILE_EVENTS : 0;
+	out->reserve(s32(end - start));
+	for (u32 i = start; i < end; i++)
+	{
+		const Slot& slot = buffer->events[i % PROFILE_EVENTS];
+		if (slot.sequence.load(std::memory_order_acquire) != i + 1)
+			continue;
+		Event e;
+		e.start = slot.start.load(std::memory_order_relaxed);
+		e.duration = slot.duration.load(std::memory_order_relaxed);
+		e.name = slot.name.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == i + 1)
+			out->add(e);
+	}
+}
+
+// thread and zone names can be anything; keep the trace valid json
+void json_string(FILE* f, const char* s)
+{
+	fputc('"', f);
+	for (const char* c = s; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			fprintf(f, "\\%c", *c);
+		else if (u8(*c) < 0x20)
+			fprintf(f, "\\u%04x", u32(u8(*c)));
+		else
+			fputc(*c, f);
+	}
+	fputc('"', f);
+}
+
+b8 trace_export(const char* path)
+{
+	FILE* f = fopen(path, "w");
+	if (!f)
+	{
+		vi_debug("Can't open file '%s'", path);
+		return false;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	b8 first = true;
+	Array<Event> events;
+	s32 count = vi_min(thread_count.load(), PROFILE_THREADS_MAX);
+	for (s32 i = 0; i < count; i++)
+	{
+		const ThreadBuffer* buffer = threads[i].load(std::memory_order_acquire);
+		if (!buffer)
+			continue;
+
+		fprintf(f, "%s{\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", buffer->id);
+		json_string(f, buffer->name);
+		fprintf(f, "}}");
+		first = false;
+
+		snapshot(buffer, &events);
+		for (s32 j = 0; j < events.length; j++)
+		{
+			const Event& e = events[j];
+			fprintf(f, ",\n{\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"name\":", buffer->id);
+			json_string(f, e.name);
+			fprintf(f, ",\"ts\":%.3f,\"dur\":%.3f}", e.start * 1000000.0, r64(e.duration) * 1000000.0);
+		}
+	}
+	fprintf(f, "\n]}\n");
+	fclose(f);
+	return true;
+}
+
+struct ZoneStats
+{
+	const char* name;
+	Array<r32> durations;
+};
+
+s32 compare_r32(const void* a, const void* b)
+{
+	r32 x = *(const r32*)a;
+	r32 y = *(const r32*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// percentiles over whatever is still in the ring buffers, so roughly the last few seconds
+void stats()
+{
+	StaticArray<ZoneStats*, PROFILE_ZONES_MAX> zones;
+	Array<Event> events;
+	s32 count = vi_min(thread_count.load(), PROFILE_THREADS_MAX);
+	for (s32 i = 0; i < count; i++)
+	{
+		const ThreadBuffer* buffer = threads[i].load(std::memory_order_acquire);
+		if (!buffer)
+			continue;
+
+		snapshot(buffer, &events);
+		for (s32 j = 0; j < events.length; j++)
+		{
+			const Event& e = events[j];
+			ZoneStats* zone = nullptr;
+			for (s32 k = 0; k < zones.length; k++)
+			{
+				if (zones[k]->name == e.name || strcmp(zones[k]->name, e.name) == 0)
+				{
+					zone = zones[k];
+					break;
+				}
+			}
+			if (!zone)
+			{
+				if (zones.length == zones.capacity())
+					continue;
+				zone = new ZoneStats();
+				zone->name = e.name;
+				zones.add(zone);
+			}
+			zone->durations.add(e.duration * 1000000.0f);
+		}
+	}
+
+	for (s32 i = 0; i < zones.length; i++)
+	{
+		ZoneStats* zone = zones[i];
+		Array<r32>& d = zone->durations;
+		qsort(d.data, d.length, sizeof(r32), compare_r32);
+		vi_debug("%s: %d samples, p50 %.1fus, p95 %.1fus, p99 %.1fus, max %.1fus", zone->name, d.length, d[(d.length * 50) / 100], d[(d.length * 95) / 100], d[(d.length * 99) / 100], d[d.length - 1]);
+		delete zone;
+	}
+}
+
+}
+
+}
+
+#endif
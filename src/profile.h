@@ -0,0 +1,60 @@
+#pragma once
+#include "types.h"
+
+// scoped timing zones, recorded into a lock-free ring buffer per thread
+// export with "profile trace <file>" (chrome://tracing json) or "profile stats" (recent percentiles per zone)
+// compiled out of optimized builds unless VI_PROFILE is defined
+
+#ifndef VI_PROFILE
+#if AK_OPTIMIZED
+#define VI_PROFILE 0
+#else
+#define VI_PROFILE 1
+#endif
+#endif
+
+#if VI_PROFILE
+
+namespace VI
+{
+
+namespace Profile
+{
+	// zone names must be string literals or otherwise live forever
+	void begin(const char*);
+	void end();
+	void thread_name(const char*);
+	b8 trace_export(const char*);
+	void stats();
+
+	struct Zone
+	{
+		Zone(const char* name)
+		{
+			begin(name);
+		}
+
+		~Zone()
+		{
+			end();
+		}
+	};
+}
+
+}
+
+#define vi_profile_concat2(a, b) a##b
+#define vi_profile_concat(a, b) vi_profile_concat2(a, b)
+#define vi_profile(name) VI::Profile::Zone vi_profile_concat(vi_profile_zone_, __LINE__)(name)
+#define vi_profile_begin(name) VI::Profile::begin(name)
+#define vi_profile_end() VI::Profile::end()
+#define vi_profile_thread(name) VI::Profile::thread_name(name)
+
+#else
+
+#define vi_profile(name) do {} while (0)
+#define vi_profile_begin(name) do {} while (0)
+#define vi_profile_end() do {} while (0)
+#define vi_profile_thread(name) do {} while (0)
+
+#endif
@@ -382,6 +382,7 @@ const r32 rain_interval_multiplier = 0.00075f;
 const r32 rain_raycast_grid_cell_size = (rain_radius * 2.0f) / Rain::raycast_grid_size;
 r32 Rain::audio_kernel[raycast_grid_size * raycast_grid_size];
 r32 Rain::particle_accumulator;
+RaycastBatch rain_rays;
 Ref<AudioEntry> Rain::audio_entries[MAX_GAMEPADS];
 
 Vec3 rain_cell_offset(s32 x, s32 z)
@@ -489,18 +490,31 @@ void Rain::spawn(const Update& u, r32 strength)
 					every_other = false;
 				}
 
-				r32 last_result = rain_radius - height;
+				rain_rays.clear();
+				s32 index = rain->raycast_grid_index;
 				for (s32 i = 0; i < local_raycasts_per_frame; i++)
 				{
 					if (!every_other || (i % 2) == 0) // this only works when the grid size is a power of 2; otherwise a raycast from row N might carry over row N+1
 					{
-						Vec3 ray_start = camera.pos + rain_cell_offset(rain->raycast_grid_index);
+						Vec3 ray_start = camera.pos + rain_cell_offset(index);
 						ray_start.y += 150.0f;
 						Vec3 ray_end = ray_start;
 						ray_end.y = camera.pos.y + rain_radius - height;
-						btCollisionWorld::ClosestRayResultCallback ray_callback(ray_start, ray_end);
-						Physics::raycast(&ray_callback, CollisionStatic);
-						last_result = ray_callback.hasHit() ? ray_callback.m_hitPointWorld.getY() : ray_end.y;
+						rain_rays.add(ray_start, ray_end, CollisionStatic);
+					}
+					index = (index + 1) % (raycast_grid_size * raycast_grid_size);
+				}
+
+				Physics::raycast(&rain_rays);
+
+				r32 last_result = rain_radius - height;
+				s32 ray = 0;
+				for (s32 i = 0; i < local_raycasts_per_frame; i++)
+				{
+					if (!every_other || (i % 2) == 0)
+					{
+						last_result = rain_rays.point[ray].y; // the end of the ray if it didn't hit anything
+						ray++;
 					}
 					rain->raycast_grid[rain->raycast_grid_index] = last_result;
 					rain->raycast_grid_index = (rain->raycast_grid_index + 1) % (raycast_grid_size * raycast_grid_size);
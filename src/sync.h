@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <condition_variable>
 #include "data/array.h"
@@ -9,63 +10,98 @@
 namespace VI
 {
 
+// single producer, single consumer
+// the producer brackets its writes with begin_write() / end_write(), and the consumer brackets its reads
+// with begin_read() or wait_read(), then end_read(). nothing is visible to the other side until the bracket closes.
+// neither side ever blocks the other; the consumer only sleeps in wait_read() while the buffer is empty.
+// wakeups: the producer publishes write_pos then checks waiting, the consumer sets waiting then re-checks write_pos,
+// with a full fence in between on both sides. so either the producer sees the flag and notifies,
+// or the consumer sees the new data and never sleeps.
 template<s32 size> struct SyncRingBuffer
 {
-	s32 read_pos;
-	s32 write_pos;
-	mutable std::mutex mutex;
-	Array<u8> data;
+	std::atomic<s32> read_pos; // published by the consumer
+	std::atomic<s32> write_pos; // published by the producer
+	std::atomic<b8> waiting; // consumer is asleep in wait_read()
+	s32 read_cursor; // consumer only
+	s32 read_limit; // consumer only; write_pos as of begin_read()
+	s32 write_cursor; // producer only
+	std::mutex mutex; // only used to sleep and wake up
 	std::condition_variable condition;
+	Array<u8> data;
 
 	SyncRingBuffer() :
-		read_pos(),
-		write_pos(),
+		read_pos(0),
+		write_pos(0),
+		waiting(false),
+		read_cursor(),
+		read_limit(),
+		write_cursor(),
 		mutex(),
-		data(size, size),
-		condition()
+		condition(),
+		data(size, size)
 	{
 	}
 
-	void lock_wait_read()
+	// returns true if there's anything to read
+	b8 begin_read()
 	{
-		while (true)
+		read_limit = write_pos.load(std::memory_order_acquire);
+		return read_cursor != read_limit;
+	}
+
+	// block until there's something to read
+	void wait_read()
+	{
+		while (!begin_read())
 		{
-			mutex.lock();
-			b8 can_read = read_pos != write_pos;
-			if (can_read)
-				break;
-			else
+			std::unique_lock<std::mutex> lock(mutex);
+			waiting.store(true, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in end_write()
+			if (begin_read()) // the producer might have published before it saw our flag
 			{
-				mutex.unlock();
-				platform::sleep(1.0f / 60.0f);
+				waiting.store(false, std::memory_order_relaxed);
+				break;
 			}
+			condition.wait(lock);
+			waiting.store(false, std::memory_order_relaxed);
 		}
 	}
 
 	inline b8 can_read() const
 	{
-		return read_pos != write_pos;
+		return read_cursor != read_limit;
+	}
+
+	inline void end_read()
+	{
+		read_pos.store(read_cursor, std::memory_order_release);
 	}
 
-	inline void lock()
+	inline void begin_write()
 	{
-		mutex.lock();
 	}
 
-	inline void unlock()
+	void end_write()
 	{
-		mutex.unlock();
+		write_pos.store(write_cursor, std::memory_order_release); // publish the data before anyone gets woken up
+		std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in wait_read()
+		if (waiting.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			condition.notify_one();
+		}
 	}
 
 	template<typename T> void write(const T* t, s32 count)
 	{
 		s32 write_size = sizeof(T) * count;
-		s32 write_end = write_pos + write_size;
+		s32 write_end = write_cursor + write_size;
 
-		if (read_pos < write_pos)
-			vi_assert(write_end - data.length < read_pos);
-		else if (read_pos > write_pos)
-			vi_assert(write_end < read_pos);
+		s32 read = read_pos.load(std::memory_order_acquire);
+		if (read < write_cursor)
+			vi_assert(write_end - data.length < read);
+		else if (read > write_cursor)
+			vi_assert(write_end < read);
 
 #if defined(__clang__)
 		// get ready to do gross things
@@ -74,15 +110,15 @@ template<s32 size> struct SyncRingBuffer
 #endif
 		if (write_end < data.length)
 		{
-			memcpy(&data[write_pos], t, write_size);
-			write_pos = write_end;
+			memcpy(&data[write_cursor], t, write_size);
+			write_cursor = write_end;
 		}
 		else
 		{
-			s32 partition = data.length - write_pos;
-			memcpy(&data[write_pos], t, partition);
-			write_pos = write_end - data.length;
-			memcpy(&data[0], ((u8*)t) + partition, write_pos);
+			s32 partition = data.length - write_cursor;
+			memcpy(&data[write_cursor], t, partition);
+			write_cursor = write_end - data.length;
+			memcpy(&data[0], ((u8*)t) + partition, write_cursor);
 		}
 #if defined(__clang__)
 #pragma clang diagnostic pop
@@ -99,7 +135,7 @@ template<s32 size> struct SyncRingBuffer
 		s32 read_len = sizeof(T) * count;
 		if (read_len == 0)
 			return;
-		s32 read_end = read_pos + read_len;
+		s32 read_end = read_cursor + read_len;
 
 #if defined(__clang__)
 		// get ready to do gross things
@@ -108,34 +144,36 @@ template<s32 size> struct SyncRingBuffer
 #endif
 		if (read_end >= data.length)
 		{
-			vi_assert(write_pos < read_pos);
-			s32 read_partition = data.length - read_pos;
-			vi_assert(read_len - read_partition <= write_pos);
+			vi_assert(read_limit < read_cursor);
+			s32 read_partition = data.length - read_cursor;
+			vi_assert(read_len - read_partition <= read_limit);
 
-			memcpy(t, &data[read_pos], read_partition);
-			read_pos = read_len - read_partition;
-			memcpy(((u8*)t) + read_partition, &data[0], read_pos);
+			memcpy(t, &data[read_cursor], read_partition);
+			read_cursor = read_len - read_partition;
+			memcpy(((u8*)t) + read_partition, &data[0], read_cursor);
 		}
 		else
 		{
-			vi_assert(read_end <= write_pos == read_pos < write_pos);
-			memcpy(t, &data[read_pos], read_len);
-			read_pos = read_end;
+			vi_assert(read_end <= read_limit == read_cursor < read_limit);
+			memcpy(t, &data[read_cursor], read_len);
+			read_cursor = read_end;
 		}
 #if defined(__clang__)
 #pragma clang diagnostic pop
 #endif
 	}
 
-	s32 length()
+	s32 length() const
 	{
-		if (read_pos <= write_pos)
-			return write_pos - read_pos;
+		s32 r = read_pos.load(std::memory_order_relaxed);
+		s32 w = write_pos.load(std::memory_order_relaxed);
+		if (r <= w)
+			return w - r;
 		else
-			return write_pos + data.length - read_pos;
+			return w + data.length - r;
 	}
 
-	s32 capacity()
+	s32 capacity() const
 	{
 		return data.length;
 	}